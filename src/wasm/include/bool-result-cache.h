@@ -0,0 +1,177 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../deps/glm/glm/glm.hpp"
+
+#include "util.h"
+
+namespace webifc
+{
+	// operands repeated across instances only agree up to the rounding of their placements
+	const double BOOL_CACHE_GRID = EPS_SMALL;
+
+	//! Operands of a boolean in the frame of the first one, snapped to BOOL_CACHE_GRID, with the settings that change the result
+	//! The cache is indexed by hash and a hit is confirmed by comparing all values
+	struct BoolResultKey
+	{
+		uint64_t hash = 0;
+		std::vector<int64_t> values;
+
+		bool operator==(const BoolResultKey& other) const
+		{
+			return hash == other.hash && values == other.values;
+		}
+
+		bool operator!=(const BoolResultKey& other) const
+		{
+			return !(*this == other);
+		}
+
+		void Add(int64_t value)
+		{
+			hash = HashCombine(hash, static_cast<uint64_t>(value));
+			values.push_back(value);
+		}
+	};
+
+	//! Adds a geometry moved into another frame to a key
+	BoolResultKey HashGeometryInFrame(BoolResultKey key, const IfcGeometry& geom, const glm::dmat4& frame)
+	{
+		key.values.reserve(key.values.size() + 2 + geom.numPoints * 3 + geom.indexData.size());
+		key.Add(geom.numPoints);
+		key.Add(geom.numFaces);
+
+		for (uint32_t i = 0; i < geom.numPoints; i++)
+		{
+			glm::dvec3 pt = frame * glm::dvec4(geom.GetPoint(i), 1);
+			key.Add(std::llround(pt.x / BOOL_CACHE_GRID));
+			key.Add(std::llround(pt.y / BOOL_CACHE_GRID));
+			key.Add(std::llround(pt.z / BOOL_CACHE_GRID));
+		}
+
+		for (auto i : geom.indexData)
+		{
+			key.Add(i);
+		}
+
+		return key;
+	}
+
+	//! Moves a geometry to another frame, vertices shared between faces stay shared
+	IfcGeometry TransformGeometry(const IfcGeometry& geom, const glm::dmat4& mat)
+	{
+		IfcGeometry result;
+		glm::dmat3 normalMat = glm::transpose(glm::inverse(glm::dmat3(mat)));
+
+		for (uint32_t i = 0; i < geom.numPoints; i++)
+		{
+			glm::dvec3 pt = mat * glm::dvec4(geom.GetPoint(i), 1);
+			glm::dvec3 n = glm::normalize(normalMat * geom.GetNormal(i));
+			result.AddPoint(pt, n);
+		}
+
+		bool flip = MatrixFlipsTriangles(mat);
+		for (uint32_t i = 0; i < geom.numFaces; i++)
+		{
+			Face f = geom.GetFace(i);
+			if (flip)
+			{
+				result.AddFace(f.i1, f.i0, f.i2);
+			}
+			else
+			{
+				result.AddFace(f.i0, f.i1, f.i2);
+			}
+		}
+
+		return result;
+	}
+
+	//! Boolean results by operands, least recently used results are dropped once the cache holds more than its capacity
+	//! Owned by the geometry loader of a model and shared with the loaders of its other levels of detail
+	class BoolResultCache
+	{
+	public:
+		BoolResultCache(size_t capacity) :
+			_capacity(capacity)
+		{
+
+		}
+
+		std::shared_ptr<const IfcGeometry> Find(const BoolResultKey& key)
+		{
+			auto it = _index.find(key.hash);
+			if (it == _index.end() || it->second->key != key)
+			{
+				return nullptr;
+			}
+
+			_entries.splice(_entries.begin(), _entries, it->second);
+			return it->second->geometry;
+		}
+
+		//! A result whose hash collides with a cached one isn't added, the key counts towards the capacity as well
+		void Add(BoolResultKey&& key, IfcGeometry&& geometry)
+		{
+			size_t bytes = key.values.size() * sizeof(int64_t) + geometry.vertexData.size() * sizeof(double) +
+				geometry.fvertexData.size() * sizeof(float) + geometry.indexData.size() * sizeof(uint32_t);
+
+			if (bytes > _capacity || _index.find(key.hash) != _index.end())
+			{
+				return;
+			}
+
+			uint64_t hash = key.hash;
+			_entries.push_front({ std::move(key), std::make_shared<const IfcGeometry>(std::move(geometry)), bytes });
+			_index[hash] = _entries.begin();
+			_size += bytes;
+			Trim();
+		}
+
+		void Clear()
+		{
+			_entries.clear();
+			_index.clear();
+			_size = 0;
+		}
+
+		size_t GetSize()
+		{
+			return _size;
+		}
+
+	private:
+		struct Entry
+		{
+			BoolResultKey key;
+			std::shared_ptr<const IfcGeometry> geometry;
+			size_t bytes;
+		};
+
+		void Trim()
+		{
+			while (_size > _capacity)
+			{
+				auto& last = _entries.back();
+				_size -= last.bytes;
+				_index.erase(last.key.hash);
+				_entries.pop_back();
+			}
+		}
+
+		std::list<Entry> _entries;
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> _index;
+		size_t _size = 0;
+		size_t _capacity;
+	};
+}
@@ -6,6 +6,8 @@
 
 #include <unordered_map>
 
+#include "memory-region.h"
+
 namespace webifc
 {
 	struct IfcLine 
@@ -17,18 +19,32 @@ namespace webifc
 		uint32_t tapeEnd;
 	};
 
+    //! All containers live in the memory region of the model
     struct IfcMetaData
     {
+		IfcMetaData(MemoryRegion& region) :
+			lines(region),
+			expressIDToLine(region),
+			ifcTypeToLineID(region),
+			_relVoids(region),
+			_relAggregates(region),
+			_styledItems(region),
+			_relMaterials(region),
+			_materialDefinitions(region)
+		{
+
+		}
+
 		double linearScalingFactor = 1;
 
-		std::vector<IfcLine> lines;
-		std::vector<uint32_t> expressIDToLine;
-		std::unordered_map<uint32_t, std::vector<uint32_t>> ifcTypeToLineID;
+		RegionVector<IfcLine> lines;
+		RegionVector<uint32_t> expressIDToLine;
+		RegionMap<uint32_t, RegionVector<uint32_t>> ifcTypeToLineID;
 
-		std::unordered_map<uint32_t, std::vector<uint32_t>> _relVoids;
-		std::unordered_map<uint32_t, std::vector<uint32_t>> _relAggregates;
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> _styledItems;
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> _relMaterials;
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> _materialDefinitions;
+		RegionMap<uint32_t, RegionVector<uint32_t>> _relVoids;
+		RegionMap<uint32_t, RegionVector<uint32_t>> _relAggregates;
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>> _styledItems;
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>> _relMaterials;
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>> _materialDefinitions;
     };
 }
\ No newline at end of file
@@ -8,14 +8,17 @@
 
 #include "../util.h"
 #include "./is-inside-mesh.h"
+#include "./intersect-mesh-mesh.h"
 #define CSGJSCPP_REAL double
 #define CSGJSCPP_IMPLEMENTATION
 #include "../../deps/csgjs-cpp/csgjs.h"
 
 namespace webifc
 {
-    void clipMesh(IfcGeometry& source, IfcGeometry& target, IfcGeometry& result, bool invert, bool flip, bool keepBoundary)
+    void clipMesh(IfcGeometry& source, IfcGeometry& target, const BVH& targetBVH, IfcGeometry& result, bool invert, bool flip, bool keepBoundary)
     {
+        std::vector<uint32_t> candidates;
+
         for (uint32_t i = 0; i < source.numFaces; i++)
         {
             Face tri = source.GetFace(i);
@@ -27,7 +30,7 @@ namespace webifc
 
             glm::dvec3 triCenter = (a + b + c) * 1.0 / 3.0;
 
-            auto isInsideTarget = isInsideMesh(triCenter, n, target);
+            auto isInsideTarget = isInsideMesh(triCenter, n, target, targetBVH, candidates);
 
             if ((isInsideTarget == MeshLocation::INSIDE && !invert) || (isInsideTarget == MeshLocation::OUTSIDE && invert) || (isInsideTarget == MeshLocation::BOUNDARY && keepBoundary))
             {
@@ -44,12 +47,20 @@ namespace webifc
         }
     }
 
+    void clipMesh(IfcGeometry& source, IfcGeometry& target, IfcGeometry& result, bool invert, bool flip, bool keepBoundary)
+    {
+        BVH targetBVH(target);
+        clipMesh(source, target, targetBVH, result, invert, flip, keepBoundary);
+    }
+
     IfcGeometry boolIntersect(IfcGeometry& mesh1, IfcGeometry& mesh2)
     {
         IfcGeometry resultingMesh;
+        BVH bvh1(mesh1);
+        BVH bvh2(mesh2);
 
-        clipMesh(mesh1, mesh2, resultingMesh, false, false, true);
-        clipMesh(mesh2, mesh1, resultingMesh, false, false, false);
+        clipMesh(mesh1, mesh2, bvh2, resultingMesh, false, false, true);
+        clipMesh(mesh2, mesh1, bvh1, resultingMesh, false, false, false);
 
         return resultingMesh;
     }
@@ -57,9 +68,11 @@ namespace webifc
     IfcGeometry boolJoin(IfcGeometry& mesh1, IfcGeometry& mesh2)
     {
         IfcGeometry resultingMesh;
+        BVH bvh1(mesh1);
+        BVH bvh2(mesh2);
 
-        clipMesh(mesh1, mesh2, resultingMesh, true, false, true);
-        clipMesh(mesh2, mesh1, resultingMesh, true, false, false);
+        clipMesh(mesh1, mesh2, bvh2, resultingMesh, true, false, true);
+        clipMesh(mesh2, mesh1, bvh1, resultingMesh, true, false, false);
 
         return resultingMesh;
     }
@@ -68,9 +81,11 @@ namespace webifc
     {
 
         IfcGeometry resultingMesh;
+        BVH bvh1(mesh1);
+        BVH bvh2(mesh2);
 
-        clipMesh(mesh1, mesh2, resultingMesh, true, false, false);
-        clipMesh(mesh2, mesh1, resultingMesh, false, true, false);
+        clipMesh(mesh1, mesh2, bvh2, resultingMesh, true, false, false);
+        clipMesh(mesh2, mesh1, bvh1, resultingMesh, false, true, false);
 
         return resultingMesh;
     }
@@ -79,13 +94,78 @@ namespace webifc
     IfcGeometry boolXOR(IfcGeometry& mesh1, IfcGeometry& mesh2)
     {
         IfcGeometry resultingMesh;
+        BVH bvh1(mesh1);
+        BVH bvh2(mesh2);
 
-        clipMesh(mesh1, mesh2, resultingMesh, true, false, false);
-        clipMesh(mesh2, mesh1, resultingMesh, true, false, false);
+        clipMesh(mesh1, mesh2, bvh2, resultingMesh, true, false, false);
+        clipMesh(mesh2, mesh1, bvh1, resultingMesh, true, false, false);
 
         return resultingMesh;
     }
 
+    // voids that don't touch the element are dropped, the others are merged into as few cutters as possible
+    // voids in one cutter never touch each other, so the cutter still classifies like its separate voids
+    std::vector<IfcGeometry> makeCutters(const IfcGeometry& element, const std::vector<IfcGeometry>& voids, uint32_t maxVoidsPerCutter, uint32_t& culled)
+    {
+        glm::dvec3 pad(EPS_SMALL);
+
+        AABB elementBox = GetAABB(element);
+        elementBox.min -= pad;
+        elementBox.max += pad;
+
+        std::vector<IfcGeometry> cutters;
+        std::vector<std::vector<AABB>> cutterBoxes;
+
+        for (auto& v : voids)
+        {
+            if (v.numFaces == 0)
+            {
+                culled++;
+                continue;
+            }
+
+            AABB box = GetAABB(v);
+            box.min -= pad;
+            box.max += pad;
+
+            if (!BoxesOverlap(box.min, box.max, elementBox.min, elementBox.max))
+            {
+                culled++;
+                continue;
+            }
+
+            size_t cutter = 0;
+            for (; cutter < cutters.size(); cutter++)
+            {
+                bool touches = false;
+                for (auto& other : cutterBoxes[cutter])
+                {
+                    if (BoxesOverlap(box.min, box.max, other.min, other.max))
+                    {
+                        touches = true;
+                        break;
+                    }
+                }
+
+                if (!touches && cutterBoxes[cutter].size() < maxVoidsPerCutter)
+                {
+                    break;
+                }
+            }
+
+            if (cutter == cutters.size())
+            {
+                cutters.emplace_back();
+                cutterBoxes.emplace_back();
+            }
+
+            cutters[cutter].AddGeometry(v);
+            cutterBoxes[cutter].push_back(box);
+        }
+
+        return cutters;
+    }
+
     csgjscpp::Model IfcGeometryToCSGModel(IfcGeometry& mesh1)
     {
         std::vector<csgjscpp::Polygon> polygons1;
@@ -0,0 +1,367 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "../../deps/glm/glm/glm.hpp"
+
+#include "../util.h"
+
+namespace webifc
+{
+    const uint32_t BVH_BINS = 12;
+    const uint32_t BVH_MAX_LEAF_SIZE = 4;
+    const uint32_t BVH_MAX_DEPTH = 48;
+    // depth first traversal keeps at most one pending sibling per level
+    const uint32_t BVH_STACK_SIZE = BVH_MAX_DEPTH + 2;
+
+    struct BVHNode
+    {
+        glm::dvec3 min = glm::dvec3(DBL_MAX);
+        glm::dvec3 max = glm::dvec3(-DBL_MAX);
+        // leafs have a count, inner nodes store their left child right after themselves
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    inline double BoxArea(const glm::dvec3& min, const glm::dvec3& max)
+    {
+        glm::dvec3 e = max - min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    inline bool BoxesOverlap(const glm::dvec3& minA, const glm::dvec3& maxA, const glm::dvec3& minB, const glm::dvec3& maxB)
+    {
+        return minA.x <= maxB.x && maxA.x >= minB.x &&
+               minA.y <= maxB.y && maxA.y >= minB.y &&
+               minA.z <= maxB.z && maxA.z >= minB.z;
+    }
+
+    // triangle bounds padded with the tolerance of intersect_ray_triangle
+    inline void GetTriangleBounds(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, glm::dvec3& min, glm::dvec3& max)
+    {
+        min = glm::min(a, glm::min(b, c));
+        max = glm::max(a, glm::max(b, c));
+
+        // barycentric tolerance scales with the triangle, the absolute part covers rounding
+        double extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+        glm::dvec3 pad = glm::dvec3(extent * 4 * EPS_SMALL + EPS_SMALL);
+
+        min -= pad;
+        max += pad;
+    }
+
+    // binned SAH tree over the triangles of a geometry, with padded triangle boxes traversal
+    // never skips a triangle the exact test would accept
+    class BVH
+    {
+    public:
+        BVH(const IfcGeometry& geom)
+        {
+            if (geom.numFaces == 0)
+            {
+                return;
+            }
+
+            _faces.resize(geom.numFaces);
+            _faceMin.resize(geom.numFaces);
+            _faceMax.resize(geom.numFaces);
+            _centers.resize(geom.numFaces);
+
+            for (uint32_t i = 0; i < geom.numFaces; i++)
+            {
+                Face f = geom.GetFace(i);
+                glm::dvec3 a = geom.GetPoint(f.i0);
+                glm::dvec3 b = geom.GetPoint(f.i1);
+                glm::dvec3 c = geom.GetPoint(f.i2);
+
+                _faces[i] = i;
+                GetTriangleBounds(a, b, c, _faceMin[i], _faceMax[i]);
+                _centers[i] = (_faceMin[i] + _faceMax[i]) * 0.5;
+            }
+
+            _nodes.reserve(geom.numFaces * 2);
+            _nodes.emplace_back();
+            Build(0, 0, geom.numFaces, 0);
+
+            _centers.clear();
+            _centers.shrink_to_fit();
+        }
+
+        bool IsEmpty() const
+        {
+            return _nodes.empty();
+        }
+
+        const glm::dvec3& GetMin() const
+        {
+            return _nodes[0].min;
+        }
+
+        const glm::dvec3& GetMax() const
+        {
+            return _nodes[0].max;
+        }
+
+        const glm::dvec3& GetFaceMin(uint32_t face) const
+        {
+            return _faceMin[face];
+        }
+
+        const glm::dvec3& GetFaceMax(uint32_t face) const
+        {
+            return _faceMax[face];
+        }
+
+        // calls visit(faceIndex) for every triangle whose box is hit by the ray origin + dir * t, t >= tMin
+        template <typename Visit>
+        void IntersectRay(const glm::dvec3& origin, const glm::dvec3& dir, double tMin, Visit visit) const
+        {
+            if (_nodes.empty())
+            {
+                return;
+            }
+
+            uint32_t stack[BVH_STACK_SIZE];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize)
+            {
+                const BVHNode& node = _nodes[stack[--stackSize]];
+
+                if (!RayHitsBox(origin, dir, tMin, node.min, node.max))
+                {
+                    continue;
+                }
+
+                if (node.count)
+                {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++)
+                    {
+                        uint32_t face = _faces[i];
+                        if (RayHitsBox(origin, dir, tMin, _faceMin[face], _faceMax[face]))
+                        {
+                            visit(face);
+                        }
+                    }
+                }
+                else
+                {
+                    stack[stackSize++] = node.first;
+                    stack[stackSize++] = static_cast<uint32_t>(&node - &_nodes[0]) + 1;
+                }
+            }
+        }
+
+        // calls visit(faceIndex) for every triangle whose box overlaps the given box
+        template <typename Visit>
+        void IntersectBox(const glm::dvec3& min, const glm::dvec3& max, Visit visit) const
+        {
+            if (_nodes.empty())
+            {
+                return;
+            }
+
+            uint32_t stack[BVH_STACK_SIZE];
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize)
+            {
+                const BVHNode& node = _nodes[stack[--stackSize]];
+
+                if (!BoxesOverlap(min, max, node.min, node.max))
+                {
+                    continue;
+                }
+
+                if (node.count)
+                {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++)
+                    {
+                        uint32_t face = _faces[i];
+                        if (BoxesOverlap(min, max, _faceMin[face], _faceMax[face]))
+                        {
+                            visit(face);
+                        }
+                    }
+                }
+                else
+                {
+                    stack[stackSize++] = node.first;
+                    stack[stackSize++] = static_cast<uint32_t>(&node - &_nodes[0]) + 1;
+                }
+            }
+        }
+
+    private:
+        static bool RayHitsBox(const glm::dvec3& origin, const glm::dvec3& dir, double tMin, const glm::dvec3& min, const glm::dvec3& max)
+        {
+            double t0 = tMin;
+            double t1 = DBL_MAX;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (dir[axis] == 0)
+                {
+                    if (origin[axis] < min[axis] || origin[axis] > max[axis])
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+
+                double inv = 1.0 / dir[axis];
+                double tNear = (min[axis] - origin[axis]) * inv;
+                double tFar = (max[axis] - origin[axis]) * inv;
+                if (tNear > tFar)
+                {
+                    std::swap(tNear, tFar);
+                }
+
+                t0 = std::max(t0, tNear);
+                t1 = std::min(t1, tFar);
+                if (t0 > t1)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void Build(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+        {
+            glm::dvec3 min(DBL_MAX);
+            glm::dvec3 max(-DBL_MAX);
+            glm::dvec3 centerMin(DBL_MAX);
+            glm::dvec3 centerMax(-DBL_MAX);
+
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t face = _faces[i];
+                min = glm::min(min, _faceMin[face]);
+                max = glm::max(max, _faceMax[face]);
+                centerMin = glm::min(centerMin, _centers[face]);
+                centerMax = glm::max(centerMax, _centers[face]);
+            }
+
+            _nodes[nodeIndex].min = min;
+            _nodes[nodeIndex].max = max;
+            _nodes[nodeIndex].first = first;
+            _nodes[nodeIndex].count = count;
+
+            if (count <= BVH_MAX_LEAF_SIZE || depth == BVH_MAX_DEPTH)
+            {
+                return;
+            }
+
+            int bestAxis = -1;
+            uint32_t bestSplit = 0;
+            double bestCost = BoxArea(min, max) * count;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                double extent = centerMax[axis] - centerMin[axis];
+                if (extent <= 0)
+                {
+                    continue;
+                }
+
+                uint32_t binCount[BVH_BINS] = {};
+                glm::dvec3 binMin[BVH_BINS];
+                glm::dvec3 binMax[BVH_BINS];
+                for (uint32_t b = 0; b < BVH_BINS; b++)
+                {
+                    binMin[b] = glm::dvec3(DBL_MAX);
+                    binMax[b] = glm::dvec3(-DBL_MAX);
+                }
+
+                for (uint32_t i = first; i < first + count; i++)
+                {
+                    uint32_t face = _faces[i];
+                    uint32_t b = GetBin(_centers[face][axis], centerMin[axis], extent);
+                    binCount[b]++;
+                    binMin[b] = glm::min(binMin[b], _faceMin[face]);
+                    binMax[b] = glm::max(binMax[b], _faceMax[face]);
+                }
+
+                // sweep from the right to get the cost of every right side
+                double rightCost[BVH_BINS] = {};
+                glm::dvec3 accMin(DBL_MAX);
+                glm::dvec3 accMax(-DBL_MAX);
+                uint32_t accCount = 0;
+                for (uint32_t b = BVH_BINS - 1; b > 0; b--)
+                {
+                    accMin = glm::min(accMin, binMin[b]);
+                    accMax = glm::max(accMax, binMax[b]);
+                    accCount += binCount[b];
+                    rightCost[b] = accCount ? BoxArea(accMin, accMax) * accCount : 0;
+                }
+
+                accMin = glm::dvec3(DBL_MAX);
+                accMax = glm::dvec3(-DBL_MAX);
+                accCount = 0;
+                for (uint32_t b = 0; b < BVH_BINS - 1; b++)
+                {
+                    accMin = glm::min(accMin, binMin[b]);
+                    accMax = glm::max(accMax, binMax[b]);
+                    accCount += binCount[b];
+
+                    if (accCount == 0 || accCount == count)
+                    {
+                        continue;
+                    }
+
+                    double cost = BoxArea(accMin, accMax) * accCount + rightCost[b + 1];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b + 1;
+                    }
+                }
+            }
+
+            if (bestAxis == -1)
+            {
+                return;
+            }
+
+            double extent = centerMax[bestAxis] - centerMin[bestAxis];
+            auto mid = std::partition(_faces.begin() + first, _faces.begin() + first + count, [&](uint32_t face) {
+                return GetBin(_centers[face][bestAxis], centerMin[bestAxis], extent) < bestSplit;
+            });
+            uint32_t leftCount = static_cast<uint32_t>(mid - (_faces.begin() + first));
+
+            uint32_t left = static_cast<uint32_t>(_nodes.size());
+            _nodes.emplace_back();
+            Build(left, first, leftCount, depth + 1);
+
+            uint32_t right = static_cast<uint32_t>(_nodes.size());
+            _nodes.emplace_back();
+            Build(right, first + leftCount, count - leftCount, depth + 1);
+
+            // left child always follows its parent
+            _nodes[nodeIndex].first = right;
+            _nodes[nodeIndex].count = 0;
+        }
+
+        static uint32_t GetBin(double center, double min, double extent)
+        {
+            uint32_t b = static_cast<uint32_t>((center - min) / extent * BVH_BINS);
+            return std::min(b, BVH_BINS - 1);
+        }
+
+        std::vector<BVHNode> _nodes;
+        std::vector<uint32_t> _faces;
+        std::vector<glm::dvec3> _faceMin;
+        std::vector<glm::dvec3> _faceMax;
+        std::vector<glm::dvec3> _centers;
+    };
+}
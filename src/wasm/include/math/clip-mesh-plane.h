@@ -0,0 +1,383 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+#include "../../deps/glm/glm/glm.hpp"
+#include "../../deps/earcut/include/mapbox/earcut.hpp"
+
+#include "../util.h"
+#include "profile-holes.h"
+
+namespace webifc
+{
+    struct PointHash
+    {
+        size_t operator()(const glm::dvec3& pt) const
+        {
+            return HashDouble(HashDouble(HashDouble(0, pt.x), pt.y), pt.z);
+        }
+    };
+
+    // signed distance to the plane, points within EPS_SMALL count as on the plane
+    inline double planeSide(const glm::dvec3& pt, const glm::dvec3& planePos, const glm::dvec3& planeNormal)
+    {
+        double d = glm::dot(pt - planePos, planeNormal);
+        return std::fabs(d) <= EPS_SMALL ? 0 : d;
+    }
+
+    // edges shared by two triangles are crossed from the same end, so both get the same point
+    inline glm::dvec3 planeCrossing(glm::dvec3 p0, glm::dvec3 p1, double s0, double s1)
+    {
+        if (p1.x < p0.x || (p1.x == p0.x && (p1.y < p0.y || (p1.y == p0.y && p1.z < p0.z))))
+        {
+            std::swap(p0, p1);
+            std::swap(s0, s1);
+        }
+
+        return p0 + (p1 - p0) * (s0 / (s0 - s1));
+    }
+
+    // closer than EPS_SMALL to an edge of the curve
+    bool isOnCurve(const glm::dvec2& pt, const IfcCurve<2>& curve)
+    {
+        size_t n = curve.points.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            const glm::dvec2& a = curve.points[i];
+            const glm::dvec2& b = curve.points[(i + 1) % n];
+            glm::dvec2 edge = b - a;
+            double length2 = glm::dot(edge, edge);
+            double t = length2 == 0 ? 0 : glm::clamp(glm::dot(pt - a, edge) / length2, 0.0, 1.0);
+            if (glm::distance(pt, a + edge * t) <= EPS_SMALL)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // the sides of a and b seen from the line through p and q, with points within EPS_SMALL on it
+    inline bool isCrossingLine(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& p, const glm::dvec2& q)
+    {
+        glm::dvec2 dir = q - p;
+        double length = glm::length(dir);
+        if (length == 0)
+        {
+            return false;
+        }
+
+        double sa = cross2d(dir, a - p) / length;
+        double sb = cross2d(dir, b - p) / length;
+        return (sa > EPS_SMALL && sb < -EPS_SMALL) || (sa < -EPS_SMALL && sb > EPS_SMALL);
+    }
+
+    // inside or on a simple curve of either winding, touching its outline is fine but crossing it isn't
+    bool isTriangleInsideCurve(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const IfcCurve<2>& curve)
+    {
+        glm::dvec2 pts[4] = { a, b, c, (a + b + c) / 3.0 };
+        for (auto& pt : pts)
+        {
+            if (!isOnCurve(pt, curve) && !isInsideCurve(pt, curve))
+            {
+                return false;
+            }
+        }
+
+        double winding = cross2d(b - a, c - a) < 0 ? -1 : 1;
+        size_t n = curve.points.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            const glm::dvec2& p = curve.points[i];
+            const glm::dvec2& q = curve.points[(i + 1) % n];
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::dvec2& e0 = pts[k];
+                const glm::dvec2& e1 = pts[(k + 1) % 3];
+                if (isCrossingLine(e0, e1, p, q) && isCrossingLine(p, q, e0, e1))
+                {
+                    return false;
+                }
+            }
+
+            // a reflex corner of the curve reaching into the triangle
+            bool inside = true;
+            for (int k = 0; k < 3 && inside; k++)
+            {
+                glm::dvec2 edge = pts[(k + 1) % 3] - pts[k];
+                double length = glm::length(edge);
+                inside = length > 0 && winding * cross2d(edge, p - pts[k]) / length > EPS_SMALL;
+            }
+
+            if (inside)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    //! Keeps the part of a closed mesh behind the plane, the side planeNormal points away from, and closes it with a cap
+    //! Returns false if the cut doesn't form closed loops, the caller should fall back to a mesh boolean then
+    //! removedFaces receives the parts of the faces in front of the plane, to check what was taken away
+    bool clipMeshByPlane(const IfcGeometry& mesh, const glm::dvec3& planePos, const glm::dvec3& planeNormal, IfcGeometry& result,
+        mapbox::detail::Earcut<uint32_t>& earcut, IfcGeometry* removedFaces = nullptr)
+    {
+        std::unordered_map<glm::dvec3, uint32_t, PointHash> pointIndices;
+        std::vector<glm::dvec3> capPoints;
+        // directed cut edges of the cap, an edge meeting its reverse cancels out
+        std::unordered_map<uint64_t, uint32_t> capEdges;
+
+        auto getPointIndex = [&](const glm::dvec3& pt) {
+            auto it = pointIndices.find(pt);
+            if (it != pointIndices.end())
+            {
+                return it->second;
+            }
+
+            uint32_t index = static_cast<uint32_t>(capPoints.size());
+            pointIndices.emplace(pt, index);
+            capPoints.push_back(pt);
+            return index;
+        };
+
+        auto addCapEdge = [&](const glm::dvec3& from, const glm::dvec3& to) {
+            uint64_t a = getPointIndex(from);
+            uint64_t b = getPointIndex(to);
+            auto reverse = capEdges.find((b << 32) | a);
+            if (reverse != capEdges.end())
+            {
+                if (--reverse->second == 0)
+                {
+                    capEdges.erase(reverse);
+                }
+                return;
+            }
+
+            capEdges[(a << 32) | b]++;
+        };
+
+        glm::dvec3 pts[4];
+        double sides[4];
+
+        for (uint32_t i = 0; i < mesh.numFaces; i++)
+        {
+            Face f = mesh.GetFace(i);
+            glm::dvec3 tri[3] = { mesh.GetPoint(f.i0), mesh.GetPoint(f.i1), mesh.GetPoint(f.i2) };
+            double s[3] = { planeSide(tri[0], planePos, planeNormal), planeSide(tri[1], planePos, planeNormal), planeSide(tri[2], planePos, planeNormal) };
+
+            if (removedFaces && (s[0] > 0 || s[1] > 0 || s[2] > 0))
+            {
+                // the removed part, with the same crossings as the kept part
+                uint32_t removedCount = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    int next = (k + 1) % 3;
+                    if (s[k] >= 0)
+                    {
+                        pts[removedCount++] = tri[k];
+                    }
+
+                    if ((s[k] < 0 && s[next] > 0) || (s[k] > 0 && s[next] < 0))
+                    {
+                        pts[removedCount++] = planeCrossing(tri[k], tri[next], s[k], s[next]);
+                    }
+                }
+
+                for (uint32_t k = 1; k + 1 < removedCount; k++)
+                {
+                    removedFaces->AddFace(pts[0], pts[k], pts[k + 1]);
+                }
+            }
+
+            if (s[0] >= 0 && s[1] >= 0 && s[2] >= 0)
+            {
+                // faces lying on the plane stay if they face the removed side, as they still bound the kept part
+                if (s[0] != 0 || s[1] != 0 || s[2] != 0 || glm::dot(computeNormal(tri[0], tri[1], tri[2]), planeNormal) <= 0)
+                {
+                    continue;
+                }
+            }
+
+            // the kept part of a triangle has at most four corners
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                int next = (k + 1) % 3;
+                if (s[k] <= 0)
+                {
+                    pts[count] = tri[k];
+                    sides[count++] = s[k];
+                }
+
+                if ((s[k] < 0 && s[next] > 0) || (s[k] > 0 && s[next] < 0))
+                {
+                    pts[count] = planeCrossing(tri[k], tri[next], s[k], s[next]);
+                    sides[count++] = 0;
+                }
+            }
+
+            for (uint32_t k = 1; k + 1 < count; k++)
+            {
+                result.AddFace(pts[0], pts[k], pts[k + 1]);
+            }
+
+            for (uint32_t k = 0; k < count; k++)
+            {
+                uint32_t next = (k + 1) % count;
+                if (sides[k] == 0 && sides[next] == 0)
+                {
+                    addCapEdge(pts[next], pts[k]);
+                }
+            }
+        }
+
+        if (capEdges.empty())
+        {
+            return true;
+        }
+
+        std::vector<std::vector<uint32_t>> outgoing(capPoints.size());
+        for (auto& edge : capEdges)
+        {
+            for (uint32_t k = 0; k < edge.second; k++)
+            {
+                outgoing[edge.first >> 32].push_back(static_cast<uint32_t>(edge.first & 0xFFFFFFFF));
+            }
+        }
+
+        glm::dvec3 u = std::fabs(planeNormal.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0);
+        u = glm::normalize(u - planeNormal * glm::dot(u, planeNormal));
+        glm::dvec3 v = glm::cross(planeNormal, u);
+
+        auto project = [&](uint32_t index) {
+            glm::dvec3 d = capPoints[index] - planePos;
+            return glm::dvec2(glm::dot(d, u), glm::dot(d, v));
+        };
+
+        std::vector<std::vector<uint32_t>> loops;
+        for (uint32_t start = 0; start < outgoing.size(); start++)
+        {
+            while (!outgoing[start].empty())
+            {
+                std::vector<uint32_t> loop;
+                uint32_t current = start;
+                do
+                {
+                    if (outgoing[current].empty())
+                    {
+                        // open outline, the mesh isn't closed
+                        return false;
+                    }
+
+                    loop.push_back(current);
+                    uint32_t next = outgoing[current].back();
+                    outgoing[current].pop_back();
+                    current = next;
+                } while (current != start);
+
+                if (loop.size() >= 3)
+                {
+                    loops.push_back(std::move(loop));
+                }
+            }
+        }
+
+        // cap outlines run counter clockwise seen from the removed side, holes clockwise
+        std::vector<IfcCurve<2>> curves(loops.size());
+        std::vector<double> areas(loops.size());
+        for (size_t i = 0; i < loops.size(); i++)
+        {
+            double area = 0;
+            for (size_t k = 0; k < loops[i].size(); k++)
+            {
+                glm::dvec2 a = project(loops[i][k]);
+                glm::dvec2 b = project(loops[i][(k + 1) % loops[i].size()]);
+                area += a.x * b.y - b.x * a.y;
+                curves[i].points.push_back(a);
+            }
+            areas[i] = area / 2;
+        }
+
+        std::vector<std::vector<size_t>> holes(loops.size());
+        for (size_t i = 0; i < loops.size(); i++)
+        {
+            if (areas[i] >= 0)
+            {
+                continue;
+            }
+
+            // the smallest outline around a hole owns it
+            size_t owner = SIZE_MAX;
+            for (size_t j = 0; j < loops.size(); j++)
+            {
+                if (areas[j] > 0 && isInsideCurve(curves[i].points[0], curves[j]) && (owner == SIZE_MAX || areas[j] < areas[owner]))
+                {
+                    owner = j;
+                }
+            }
+
+            if (owner == SIZE_MAX)
+            {
+                return false;
+            }
+
+            holes[owner].push_back(i);
+        }
+
+        using Point = std::array<double, 2>;
+        for (size_t i = 0; i < loops.size(); i++)
+        {
+            if (areas[i] <= 0)
+            {
+                continue;
+            }
+
+            std::vector<std::vector<Point>> polygon;
+            std::vector<uint32_t> indices;
+            polygon.emplace_back();
+            for (size_t k = 0; k < loops[i].size(); k++)
+            {
+                polygon.back().push_back({ curves[i].points[k].x, curves[i].points[k].y });
+                indices.push_back(loops[i][k]);
+            }
+
+            for (size_t hole : holes[i])
+            {
+                polygon.emplace_back();
+                for (size_t k = 0; k < loops[hole].size(); k++)
+                {
+                    polygon.back().push_back({ curves[hole].points[k].x, curves[hole].points[k].y });
+                    indices.push_back(loops[hole][k]);
+                }
+            }
+
+            earcut(polygon);
+            for (size_t k = 0; k + 2 < earcut.indices.size(); k += 3)
+            {
+                const glm::dvec3& a = capPoints[indices[earcut.indices[k + 0]]];
+                const glm::dvec3& b = capPoints[indices[earcut.indices[k + 1]]];
+                const glm::dvec3& c = capPoints[indices[earcut.indices[k + 2]]];
+
+                // the cap faces the removed side
+                if (glm::dot(glm::cross(b - a, c - a), planeNormal) < 0)
+                {
+                    result.AddFace(a, c, b);
+                }
+                else
+                {
+                    result.AddFace(a, b, c);
+                }
+            }
+        }
+
+        return true;
+    }
+}
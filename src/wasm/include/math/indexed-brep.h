@@ -0,0 +1,308 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#include "../../deps/glm/glm/glm.hpp"
+#include "../../deps/earcut/include/mapbox/earcut.hpp"
+
+#include "../util.h"
+
+namespace webifc
+{
+    // shells with fewer faces are triangulated on the calling thread
+    const size_t BREP_PARALLEL_FACES = 4096;
+
+    //! Shell whose faces refer to shared points, triangulated into one geometry with one vertex per point,
+    //! split only where the faces around a point meet at a crease
+    class IndexedBrep
+    {
+    public:
+        //! Index of the point with this ID, or -1 if it hasn't been added yet
+        int32_t FindPoint(uint32_t expressID) const
+        {
+            auto it = _pointIndices.find(expressID);
+            return it == _pointIndices.end() ? -1 : static_cast<int32_t>(it->second);
+        }
+
+        uint32_t AddPoint(uint32_t expressID, const glm::dvec3& pos)
+        {
+            uint32_t index = static_cast<uint32_t>(_points.size());
+            _pointIndices.emplace(expressID, index);
+            _points.push_back(pos);
+            return index;
+        }
+
+        //! Point of a list that faces refer to by position
+        uint32_t AddPoint(const glm::dvec3& pos)
+        {
+            _points.push_back(pos);
+            return static_cast<uint32_t>(_points.size() - 1);
+        }
+
+        //! The loops of a face follow, the outer one first
+        void StartFace()
+        {
+            _faceStarts.push_back(static_cast<uint32_t>(_loopStarts.size()));
+        }
+
+        void StartLoop()
+        {
+            _loopStarts.push_back(static_cast<uint32_t>(_corners.size()));
+        }
+
+        void AddCorner(uint32_t point)
+        {
+            _corners.push_back(point);
+        }
+
+        size_t GetFaceCount() const
+        {
+            return _faceStarts.size();
+        }
+
+        //! Bounds of the points read so far, false without points
+        bool GetBounds(glm::dvec3& min, glm::dvec3& max) const
+        {
+            if (_points.empty())
+            {
+                return false;
+            }
+
+            min = max = _points[0];
+            for (auto& pt : _points)
+            {
+                min = glm::min(min, pt);
+                max = glm::max(max, pt);
+            }
+
+            return true;
+        }
+
+        //! Faces around a point share its vertex while the dot product of their normals is at least minNormalDot
+        IfcGeometry Build(double minNormalDot)
+        {
+            size_t numFaces = _faceStarts.size();
+            std::vector<glm::dvec3> faceNormals(numFaces);
+            std::vector<std::vector<uint32_t>> chunkTriangles;
+
+#ifndef __EMSCRIPTEN__
+            size_t numThreads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), numFaces / BREP_PARALLEL_FACES + 1);
+#else
+            size_t numThreads = 1;
+#endif
+            chunkTriangles.resize(numThreads);
+            size_t chunkSize = (numFaces + numThreads - 1) / numThreads;
+
+            auto triangulateChunk = [&](size_t chunk) {
+                size_t end = std::min(numFaces, (chunk + 1) * chunkSize);
+                FaceTriangulator triangulator;
+                for (size_t face = chunk * chunkSize; face < end; face++)
+                {
+                    triangulator.Triangulate(*this, face, faceNormals[face], chunkTriangles[chunk]);
+                }
+            };
+
+#ifndef __EMSCRIPTEN__
+            if (numThreads > 1)
+            {
+                std::vector<std::thread> threads;
+                for (size_t chunk = 1; chunk < numThreads; chunk++)
+                {
+                    threads.emplace_back(triangulateChunk, chunk);
+                }
+                triangulateChunk(0);
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+            }
+            else
+#endif
+            {
+                triangulateChunk(0);
+            }
+
+            // the vertices of a point are chained through nextVertex, in face order so the result doesn't depend on the threads
+            const uint32_t NONE = UINT32_MAX;
+            std::vector<uint32_t> pointVertex(_points.size(), NONE);
+            std::vector<uint32_t> nextVertex;
+            std::vector<uint32_t> vertexPoint;
+            std::vector<glm::dvec3> firstNormals;
+            std::vector<glm::dvec3> summedNormals;
+            std::vector<uint32_t> cornerVertex(_corners.size(), NONE);
+
+            for (size_t face = 0; face < numFaces; face++)
+            {
+                const glm::dvec3& n = faceNormals[face];
+                if (n == glm::dvec3(0))
+                {
+                    continue;
+                }
+
+                for (uint32_t corner = GetLoopStart(_faceStarts[face]); corner < GetLoopStart(GetFaceEnd(face)); corner++)
+                {
+                    uint32_t point = _corners[corner];
+                    uint32_t vertex = pointVertex[point];
+                    while (vertex != NONE && glm::dot(firstNormals[vertex], n) < minNormalDot)
+                    {
+                        vertex = nextVertex[vertex];
+                    }
+
+                    if (vertex == NONE)
+                    {
+                        vertex = static_cast<uint32_t>(vertexPoint.size());
+                        vertexPoint.push_back(point);
+                        firstNormals.push_back(n);
+                        summedNormals.push_back(glm::dvec3(0));
+                        nextVertex.push_back(pointVertex[point]);
+                        pointVertex[point] = vertex;
+                    }
+
+                    summedNormals[vertex] += n;
+                    cornerVertex[corner] = vertex;
+                }
+            }
+
+            IfcGeometry geom;
+            for (uint32_t vertex = 0; vertex < vertexPoint.size(); vertex++)
+            {
+                glm::dvec3 n = glm::normalize(summedNormals[vertex]);
+                geom.AddPoint(_points[vertexPoint[vertex]], n);
+            }
+
+            for (auto& triangles : chunkTriangles)
+            {
+                for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+                {
+                    uint32_t a = cornerVertex[triangles[i + 0]];
+                    uint32_t b = cornerVertex[triangles[i + 1]];
+                    uint32_t c = cornerVertex[triangles[i + 2]];
+
+                    // loops that visit a point twice
+                    if (a != b && b != c && c != a)
+                    {
+                        geom.AddFace(a, b, c);
+                    }
+                }
+            }
+
+            return geom;
+        }
+
+    private:
+        // scratch buffers of one thread
+        struct FaceTriangulator
+        {
+            using Point = std::array<double, 2>;
+
+            mapbox::detail::Earcut<uint32_t> earcut;
+            std::vector<std::vector<Point>> polygon;
+            std::vector<glm::dvec3> outer;
+            std::vector<uint32_t> indices;
+
+            // appends the triangles of a face as corner indices, the normal stays zero for faces without area
+            void Triangulate(const IndexedBrep& brep, size_t face, glm::dvec3& normal, std::vector<uint32_t>& triangles)
+            {
+                uint32_t firstLoop = brep._faceStarts[face];
+                uint32_t endLoop = brep.GetFaceEnd(face);
+                if (firstLoop == endLoop)
+                {
+                    return;
+                }
+
+                uint32_t begin = brep._loopStarts[firstLoop];
+                outer.clear();
+                for (uint32_t corner = begin; corner < brep.GetLoopStart(firstLoop + 1); corner++)
+                {
+                    outer.push_back(brep._points[brep._corners[corner]]);
+                }
+
+                if (endLoop - firstLoop == 1 && outer.size() == 3)
+                {
+                    if (computeSafeNormal(outer[0], outer[1], outer[2], normal))
+                    {
+                        triangles.push_back(begin);
+                        triangles.push_back(begin + 1);
+                        triangles.push_back(begin + 2);
+                    }
+                    return;
+                }
+
+                glm::dvec3 v1, v2, v3;
+                if (outer.size() < 3 || !GetBasisFromCoplanarPoints(outer, v1, v2, v3))
+                {
+                    return;
+                }
+
+                // the same frame as TriangulateBounds, so faces keep the winding they had there
+                glm::dvec3 v12(glm::normalize(v2 - v1));
+                glm::dvec3 v13(glm::normalize(v3 - v1));
+                glm::dvec3 n = glm::normalize(glm::cross(v12, v13));
+                v12 = glm::cross(v13, n);
+                normal = n;
+
+                polygon.resize(endLoop - firstLoop);
+                for (uint32_t loop = firstLoop; loop < endLoop; loop++)
+                {
+                    auto& points = polygon[loop - firstLoop];
+                    points.clear();
+                    for (uint32_t corner = brep._loopStarts[loop]; corner < brep.GetLoopStart(loop + 1); corner++)
+                    {
+                        glm::dvec3 pt = brep._points[brep._corners[corner]] - v1;
+                        points.push_back({ glm::dot(pt, v12), glm::dot(pt, v13) });
+                    }
+                }
+
+                bool simple = false;
+                if (polygon.size() == 1 && GetLoopCornerCount(polygon[0]) == 4)
+                {
+                    TriangulateQuad(polygon[0], indices);
+                    simple = true;
+                }
+                else if (polygon.size() == 1 && IsConvexLoop(polygon[0]))
+                {
+                    FanTriangulate(polygon[0], indices);
+                    simple = true;
+                }
+                else
+                {
+                    earcut(polygon);
+                }
+
+                // earcut numbers the corners of all loops in order, like the corners are stored
+                for (uint32_t index : simple ? indices : earcut.indices)
+                {
+                    triangles.push_back(begin + index);
+                }
+            }
+        };
+
+        // first corner of a loop, or the end of the corners past the last loop
+        uint32_t GetLoopStart(uint32_t loop) const
+        {
+            return loop < _loopStarts.size() ? _loopStarts[loop] : static_cast<uint32_t>(_corners.size());
+        }
+
+        // loop past the last loop of a face
+        uint32_t GetFaceEnd(size_t face) const
+        {
+            return face + 1 < _faceStarts.size() ? _faceStarts[face + 1] : static_cast<uint32_t>(_loopStarts.size());
+        }
+
+        std::unordered_map<uint32_t, uint32_t> _pointIndices;
+        std::vector<glm::dvec3> _points;
+        std::vector<uint32_t> _corners;
+        std::vector<uint32_t> _loopStarts;
+        std::vector<uint32_t> _faceStarts;
+    };
+}
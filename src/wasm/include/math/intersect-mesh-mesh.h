@@ -10,6 +10,7 @@
 #include "../../deps/glm/glm/glm.hpp"
 #include "../util.h"
 #include "intersect-ray-tri.h"
+#include "bvh.h"
 #include "triangulate-with-boundaries.h"
 
 namespace webifc
@@ -134,9 +135,10 @@ namespace webifc
             const glm::dvec3& c = mesh.GetPoint(f.i2);
 
             // warning: ints may have line segments where end === start
-            std::vector<MeshIntersection> ints = intersections[i];
-            if (!ints.empty())
+            auto intsIt = intersections.find(i);
+            if (intsIt != intersections.end() && !intsIt->second.empty())
             {
+                auto& ints = intsIt->second;
                 glm::dvec2 pa = glm::dvec2(0, 0);//  projectOnTriangle(a, a, b, c);
                 glm::dvec2 pb = glm::dvec2(1, 0);//projectOnTriangle(b, a, b, c);
                 glm::dvec2 pc = glm::dvec2(0, 1);//projectOnTriangle(c, a, b, c);
@@ -236,72 +238,69 @@ namespace webifc
         return aabb;
     }
 
-    struct Partition
+    //! Intersection lines of every pair of crossing triangles, by triangle of either mesh in the order of testing all pairs
+    void findMeshIntersections(const IfcGeometry& mesh1, const IfcGeometry& mesh2, MeshIntersections& meshIntersections1, MeshIntersections& meshIntersections2)
     {
-        glm::dvec3 cellsize;
-    };
-
-    const uint32_t GRID_CELLS_AXIS = 100;
-
-    Partition MakePartition(const IfcGeometry& m, const AABB& aabb)
-    {
-        Partition p;
+        // broad phase, only pairs with overlapping boxes go to the exact test
+        // the boxes are padded like the exact test, so no intersection is missed
+        BVH bvh2(mesh2);
 
-        // compute cellsize of partition
-        glm::dvec3 size = aabb.max - aabb.min;
-        p.cellsize = size / static_cast<double>(GRID_CELLS_AXIS);
-
-        std::vector<int> parts(m.numFaces);
-
-        // add all faces to partition
-        for (uint32_t i = 0; i < m.numFaces; i++)
+        if (!bvh2.IsEmpty())
         {
-            Face t1 = m.GetFace(i);
-
-            // add face index for all cells
-        }
-
-        return p;
-    }
-
-    void intersectMeshMesh(const IfcGeometry& mesh1, const IfcGeometry& mesh2, IfcGeometry& result1, IfcGeometry& result2)
-    {
-        MeshIntersections meshIntersections1;
-        MeshIntersections meshIntersections2;
+            std::vector<uint32_t> candidates;
 
-        for (uint32_t i = 0; i < mesh1.numFaces; i++)
-        {
-            for (uint32_t j = 0; j < mesh2.numFaces; j++)
+            for (uint32_t i = 0; i < mesh1.numFaces; i++)
             {
                 Face t1 = mesh1.GetFace(i);
-                Face t2 = mesh2.GetFace(j);
 
                 const glm::dvec3& a = mesh1.GetPoint(t1.i0);
                 const glm::dvec3& b = mesh1.GetPoint(t1.i1);
                 const glm::dvec3& c = mesh1.GetPoint(t1.i2);
 
-                const glm::dvec3& d = mesh2.GetPoint(t2.i0);
-                const glm::dvec3& e = mesh2.GetPoint(t2.i1);
-                const glm::dvec3& f = mesh2.GetPoint(t2.i2);
+                glm::dvec3 min;
+                glm::dvec3 max;
+                GetTriangleBounds(a, b, c, min, max);
 
-                glm::dvec3 n = computeNormal(a, b, c);
+                candidates.clear();
+                bvh2.IntersectBox(min, max, [&](uint32_t j) {
+                    candidates.push_back(j);
+                });
 
-                TriTriResult intersectionLine = intersect_triangle_triangle(a, b, c, d, e, f);
+                // same order as testing all pairs, the retriangulation depends on it
+                std::sort(candidates.begin(), candidates.end());
 
-                if (intersectionLine.hasIntersection)
+                for (uint32_t j : candidates)
                 {
-                    meshIntersections1[i].push_back(MeshIntersection{
-                        intersectionLine,
-                        j
-                    });
+                    Face t2 = mesh2.GetFace(j);
 
-                    meshIntersections2[j].push_back(MeshIntersection{
-                        intersectionLine,
-                        i
-                    });
+                    const glm::dvec3& d = mesh2.GetPoint(t2.i0);
+                    const glm::dvec3& e = mesh2.GetPoint(t2.i1);
+                    const glm::dvec3& f = mesh2.GetPoint(t2.i2);
+
+                    TriTriResult intersectionLine = intersect_triangle_triangle(a, b, c, d, e, f);
+
+                    if (intersectionLine.hasIntersection)
+                    {
+                        meshIntersections1[i].push_back(MeshIntersection{
+                            intersectionLine,
+                            j
+                        });
+
+                        meshIntersections2[j].push_back(MeshIntersection{
+                            intersectionLine,
+                            i
+                        });
+                    }
                 }
             }
         }
+    }
+
+    void intersectMeshMesh(const IfcGeometry& mesh1, const IfcGeometry& mesh2, IfcGeometry& result1, IfcGeometry& result2)
+    {
+        MeshIntersections meshIntersections1;
+        MeshIntersections meshIntersections2;
+        findMeshIntersections(mesh1, mesh2, meshIntersections1, meshIntersections2);
 
         /*
         IfcGeometry m1;
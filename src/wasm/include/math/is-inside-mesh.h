@@ -8,6 +8,7 @@
 #include <iostream>
 
 #include "intersect-ray-tri.h"
+#include "bvh.h"
 #include "../util.h"
 
 namespace webifc
@@ -19,50 +20,88 @@ namespace webifc
         BOUNDARY
     };
 
-    MeshLocation isInsideMesh(const glm::dvec3& pt, glm::dvec3 normal, IfcGeometry& g)
+    const glm::dvec3 INSIDE_MESH_RAY_DIR(1, 1.1, 1.4);
+
+    // tests the ray from pt against one triangle, returns true if that triangle decides the location
+    bool rayDecidesLocation(const glm::dvec3& pt, const glm::dvec3& normal, const IfcGeometry& g, uint32_t face, int& winding, MeshLocation& location)
     {
-        glm::dvec3 dir(1, 1.1, 1.4);
+        const glm::dvec3& dir = INSIDE_MESH_RAY_DIR;
 
-        int winding = 0;
-        for (uint32_t i = 0; i < g.numFaces; i++)
-        {
-            Face f = g.GetFace(i);
-            const glm::dvec3 a = g.GetPoint(f.i0);
-            const glm::dvec3 b = g.GetPoint(f.i1);
-            const glm::dvec3 c = g.GetPoint(f.i2);
+        Face f = g.GetFace(face);
+        const glm::dvec3 a = g.GetPoint(f.i0);
+        const glm::dvec3 b = g.GetPoint(f.i1);
+        const glm::dvec3 c = g.GetPoint(f.i2);
 
-            glm::dvec3 intersection;
-            double distance;
-            bool hasIntersection = intersect_ray_triangle(pt, pt + dir, a, b, c, intersection, distance, true);
-            if (hasIntersection)
+        glm::dvec3 intersection;
+        double distance;
+        bool hasIntersection = intersect_ray_triangle(pt, pt + dir, a, b, c, intersection, distance, true);
+        if (hasIntersection)
+        {
+            glm::dvec3 otherNormal = computeNormal(a, b, c);
+            double d = glm::dot(otherNormal, dir);
+            double dn = glm::dot(otherNormal, normal);
+            if (std::fabs(distance) < EPS_SMALL)
             {
-                glm::dvec3 otherNormal = computeNormal(a, b, c);
-                double d = glm::dot(otherNormal, dir);
-                double dn = glm::dot(otherNormal, normal);
-                if (std::fabs(distance) < EPS_SMALL)
-                {
-                    if (dn >= 1 - EPS_SMALL)
-                    {
-                        // normals facing same direction, means an inside boundary
-                        return MeshLocation::BOUNDARY;
-                    }
-                    else
-                    {
-                        // normals facing away, means that these touch
-                        return MeshLocation::OUTSIDE;
-                    }
-                }
-                if (d >= 0)
+                if (dn >= 1 - EPS_SMALL)
                 {
-                    winding++;
+                    // normals facing same direction, means an inside boundary
+                    location = MeshLocation::BOUNDARY;
                 }
                 else
                 {
-                    winding--;
+                    // normals facing away, means that these touch
+                    location = MeshLocation::OUTSIDE;
                 }
+                return true;
+            }
+            if (d >= 0)
+            {
+                winding++;
+            }
+            else
+            {
+                winding--;
+            }
+        }
+
+        return false;
+    }
+
+    MeshLocation isInsideMesh(const glm::dvec3& pt, glm::dvec3 normal, IfcGeometry& g)
+    {
+        int winding = 0;
+        MeshLocation location;
+        for (uint32_t i = 0; i < g.numFaces; i++)
+        {
+            if (rayDecidesLocation(pt, normal, g, i, winding, location))
+            {
+                return location;
+            }
+        }
+
+        return winding > 0 ? MeshLocation::INSIDE : MeshLocation::OUTSIDE;
+    }
+
+    // same result as the brute force version, the tree only skips triangles the ray cannot hit
+    // candidates are visited in face order, so the first touching triangle still decides
+    MeshLocation isInsideMesh(const glm::dvec3& pt, glm::dvec3 normal, const IfcGeometry& g, const BVH& bvh, std::vector<uint32_t>& candidates)
+    {
+        candidates.clear();
+        bvh.IntersectRay(pt, INSIDE_MESH_RAY_DIR, -EPS_BIG, [&](uint32_t face) {
+            candidates.push_back(face);
+        });
+        std::sort(candidates.begin(), candidates.end());
+
+        int winding = 0;
+        MeshLocation location;
+        for (uint32_t face : candidates)
+        {
+            if (rayDecidesLocation(pt, normal, g, face, winding, location))
+            {
+                return location;
             }
         }
 
         return winding > 0 ? MeshLocation::INSIDE : MeshLocation::OUTSIDE;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,698 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "../../deps/glm/glm/glm.hpp"
+
+#include "../util.h"
+#include "bvh.h"
+#include "is-inside-mesh.h"
+
+namespace webifc
+{
+    enum class BoolOperation
+    {
+        DIFFERENCE,
+        UNION,
+        INTERSECTION
+    };
+
+    // a + b == x + y exactly
+    inline void twoSum(double a, double b, double& x, double& y)
+    {
+        double s = a + b;
+        double bv = s - a;
+        double av = s - bv;
+        y = (a - av) + (b - bv);
+        x = s;
+    }
+
+    // a * b == x + y exactly
+    inline void twoProduct(double a, double b, double& x, double& y)
+    {
+        double p = a * b;
+        y = std::fma(a, b, -p);
+        x = p;
+    }
+
+    // the determinant of orient3d needs at most 192 components
+    const uint32_t EXPANSION_CAPACITY = 192;
+
+    // sum of non overlapping doubles ordered by increasing magnitude, without zeros
+    struct Expansion
+    {
+        double values[EXPANSION_CAPACITY];
+        uint32_t size = 0;
+    };
+
+    inline void growExpansion(Expansion& e, double b)
+    {
+        double q = b;
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < e.size; i++)
+        {
+            double h;
+            twoSum(q, e.values[i], q, h);
+            if (h != 0)
+            {
+                e.values[n++] = h;
+            }
+        }
+
+        if (q != 0)
+        {
+            e.values[n++] = q;
+        }
+        e.size = n;
+    }
+
+    inline void addExpansion(Expansion& e, const Expansion& f)
+    {
+        for (uint32_t i = 0; i < f.size; i++)
+        {
+            growExpansion(e, f.values[i]);
+        }
+    }
+
+    inline Expansion multiplyExpansion(const Expansion& e, const Expansion& f)
+    {
+        Expansion result;
+        for (uint32_t i = 0; i < e.size; i++)
+        {
+            for (uint32_t j = 0; j < f.size; j++)
+            {
+                double x;
+                double y;
+                twoProduct(e.values[i], f.values[j], x, y);
+                growExpansion(result, y);
+                growExpansion(result, x);
+            }
+        }
+
+        return result;
+    }
+
+    inline Expansion differenceExpansion(double a, double b)
+    {
+        Expansion e;
+        growExpansion(e, a);
+        growExpansion(e, -b);
+        return e;
+    }
+
+    // a * b - c * d
+    inline Expansion crossExpansion(const Expansion& a, const Expansion& b, const Expansion& c, const Expansion& d)
+    {
+        Expansion result = multiplyExpansion(a, b);
+        Expansion other = multiplyExpansion(c, d);
+        for (uint32_t i = 0; i < other.size; i++)
+        {
+            other.values[i] = -other.values[i];
+        }
+
+        addExpansion(result, other);
+        return result;
+    }
+
+    double orient3dExact(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, const glm::dvec3& d)
+    {
+        Expansion adx = differenceExpansion(a.x, d.x);
+        Expansion ady = differenceExpansion(a.y, d.y);
+        Expansion adz = differenceExpansion(a.z, d.z);
+        Expansion bdx = differenceExpansion(b.x, d.x);
+        Expansion bdy = differenceExpansion(b.y, d.y);
+        Expansion bdz = differenceExpansion(b.z, d.z);
+        Expansion cdx = differenceExpansion(c.x, d.x);
+        Expansion cdy = differenceExpansion(c.y, d.y);
+        Expansion cdz = differenceExpansion(c.z, d.z);
+
+        Expansion det = multiplyExpansion(adz, crossExpansion(bdx, cdy, cdx, bdy));
+        addExpansion(det, multiplyExpansion(bdz, crossExpansion(cdx, ady, adx, cdy)));
+        addExpansion(det, multiplyExpansion(cdz, crossExpansion(adx, bdy, bdx, ady)));
+
+        // the largest component decides the sign, summing from the smallest keeps it
+        double sum = 0;
+        for (uint32_t i = 0; i < det.size; i++)
+        {
+            sum += det.values[i];
+        }
+
+        return sum;
+    }
+
+    // error bound of the floating point determinant from Shewchuk's adaptive predicates
+    const double ORIENT3D_ERROR_BOUND = (7.0 + 56.0 * DBL_EPSILON * 0.5) * DBL_EPSILON * 0.5;
+
+    // positive if d lies on the side of the plane through a, b, c that cross(b - a, c - a) points to
+    // the sign is exact, the value is only an estimate, zero means d is exactly on the plane
+    inline double orient3d(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, const glm::dvec3& d)
+    {
+        double adx = a.x - d.x;
+        double ady = a.y - d.y;
+        double adz = a.z - d.z;
+        double bdx = b.x - d.x;
+        double bdy = b.y - d.y;
+        double bdz = b.z - d.z;
+        double cdx = c.x - d.x;
+        double cdy = c.y - d.y;
+        double cdz = c.z - d.z;
+
+        double bdxcdy = bdx * cdy;
+        double cdxbdy = cdx * bdy;
+        double cdxady = cdx * ady;
+        double adxcdy = adx * cdy;
+        double adxbdy = adx * bdy;
+        double bdxady = bdx * ady;
+
+        double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+
+        double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * std::fabs(adz)
+                         + (std::fabs(cdxady) + std::fabs(adxcdy)) * std::fabs(bdz)
+                         + (std::fabs(adxbdy) + std::fabs(bdxady)) * std::fabs(cdz);
+
+        double errorBound = ORIENT3D_ERROR_BOUND * permanent;
+        if (det > errorBound || -det > errorBound)
+        {
+            return -det;
+        }
+
+        // shared vertices are common and would always need the exact path
+        if (d == a || d == b || d == c)
+        {
+            return 0;
+        }
+
+        return -orient3dExact(a, b, c, d);
+    }
+
+    // open addressing table that shares bit identical vertices of the output
+    class BoolVertexTable
+    {
+    public:
+        uint32_t Add(IfcGeometry& geom, glm::dvec3 pt, glm::dvec3 n)
+        {
+            if (geom.numPoints * 2 >= _slots.size())
+            {
+                Grow(geom);
+            }
+
+            uint64_t mask = _slots.size() - 1;
+            uint64_t slot = Hash(pt, n) & mask;
+            while (_slots[slot])
+            {
+                uint32_t index = _slots[slot] - 1;
+                if (geom.GetPoint(index) == pt && geom.GetNormal(index) == n)
+                {
+                    return index;
+                }
+
+                slot = (slot + 1) & mask;
+            }
+
+            _slots[slot] = geom.numPoints + 1;
+            geom.AddPoint(pt, n);
+            return geom.numPoints - 1;
+        }
+
+    private:
+        static uint64_t Hash(const glm::dvec3& pt, const glm::dvec3& n)
+        {
+            uint64_t seed = HashDouble(HashDouble(HashDouble(0, pt.x), pt.y), pt.z);
+            return HashDouble(HashDouble(HashDouble(seed, n.x), n.y), n.z);
+        }
+
+        void Grow(const IfcGeometry& geom)
+        {
+            size_t size = std::max<size_t>(1024, _slots.size() * 2);
+            _slots.assign(size, 0);
+
+            uint64_t mask = size - 1;
+            for (uint32_t i = 0; i < geom.numPoints; i++)
+            {
+                uint64_t slot = Hash(geom.GetPoint(i), geom.GetNormal(i)) & mask;
+                while (_slots[slot])
+                {
+                    slot = (slot + 1) & mask;
+                }
+                _slots[slot] = i + 1;
+            }
+        }
+
+        std::vector<uint32_t> _slots;
+    };
+
+    // plane through three points, splits only fragments overlapping the box of the triangle it came from
+    // planes of triangles crossing the source plane also know where along the crossing line the triangle is
+    struct BoolCutPlane
+    {
+        glm::dvec3 a;
+        glm::dvec3 b;
+        glm::dvec3 c;
+        glm::dvec3 min;
+        glm::dvec3 max;
+        bool hasSegment = false;
+        glm::dvec3 dir;
+        double segmentMin;
+        double segmentMax;
+    };
+
+    struct BoolFragment
+    {
+        uint32_t first;
+        uint32_t count;
+        glm::dvec3 min;
+        glm::dvec3 max;
+    };
+
+    struct BoolSplitTask
+    {
+        BoolFragment fragment;
+        uint32_t firstPlane;
+        uint32_t numPlanes;
+    };
+
+    //! Splits the triangles of source along the surface of target and keeps the pieces on the requested side
+    //! Triangles are cut by the planes of the target triangles they touch, so every piece is convex and lies entirely
+    //! inside, outside or on the boundary of target
+    class BoolMeshSplitter
+    {
+    public:
+        void Clip(const IfcGeometry& source, const IfcGeometry& target, const BVH& targetBVH, MeshLocation keep, bool keepBoundary, bool flip, IfcGeometry& result, BoolVertexTable& vertices)
+        {
+            for (uint32_t i = 0; i < source.numFaces; i++)
+            {
+                Face f = source.GetFace(i);
+                glm::dvec3 a = source.GetPoint(f.i0);
+                glm::dvec3 b = source.GetPoint(f.i1);
+                glm::dvec3 c = source.GetPoint(f.i2);
+
+                glm::dvec3 normal;
+                if (!computeSafeNormal(a, b, c, normal))
+                {
+                    continue;
+                }
+
+                glm::dvec3 min;
+                glm::dvec3 max;
+                GetTriangleBounds(a, b, c, min, max);
+
+                _points.clear();
+                _fragments.clear();
+                _points.push_back(a);
+                _points.push_back(b);
+                _points.push_back(c);
+                _fragments.push_back({ 0, 3, glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) });
+
+                if (targetBVH.IsEmpty() || !BoxesOverlap(min, max, targetBVH.GetMin(), targetBVH.GetMax()))
+                {
+                    // nothing of target is near, the triangle is outside
+                    if (keep == MeshLocation::OUTSIDE)
+                    {
+                        Emit(_fragments[0], normal, flip, result, vertices);
+                    }
+                    continue;
+                }
+
+                CollectPlanes(a, b, c, normal, min, max, target, targetBVH);
+                SplitByPlanes();
+
+                for (auto& fragment : _fragments)
+                {
+                    if (fragment.count < 3)
+                    {
+                        continue;
+                    }
+
+                    glm::dvec3 center(0);
+                    for (uint32_t k = fragment.first; k < fragment.first + fragment.count; k++)
+                    {
+                        center += _points[k];
+                    }
+                    center /= static_cast<double>(fragment.count);
+
+                    MeshLocation location = isInsideMesh(center, normal, target, targetBVH, _candidates);
+                    if (location == keep || (location == MeshLocation::BOUNDARY && keepBoundary))
+                    {
+                        Emit(fragment, normal, flip, result, vertices);
+                    }
+                }
+            }
+        }
+
+    private:
+        void CollectPlanes(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, const glm::dvec3& normal, const glm::dvec3& min, const glm::dvec3& max, const IfcGeometry& target, const BVH& targetBVH)
+        {
+            _planes.clear();
+            _candidates.clear();
+            targetBVH.IntersectBox(min, max, [&](uint32_t face) {
+                _candidates.push_back(face);
+            });
+
+            // same cuts in the same order, whatever the tree looks like
+            std::sort(_candidates.begin(), _candidates.end());
+
+            for (uint32_t face : _candidates)
+            {
+                Face f = target.GetFace(face);
+                glm::dvec3 p = target.GetPoint(f.i0);
+                glm::dvec3 q = target.GetPoint(f.i1);
+                glm::dvec3 r = target.GetPoint(f.i2);
+
+                glm::dvec3 targetNormal;
+                if (!computeSafeNormal(p, q, r, targetNormal))
+                {
+                    continue;
+                }
+
+                double sa = orient3d(p, q, r, a);
+                double sb = orient3d(p, q, r, b);
+                double sc = orient3d(p, q, r, c);
+
+                if ((sa > 0 && sb > 0 && sc > 0) || (sa < 0 && sb < 0 && sc < 0))
+                {
+                    continue;
+                }
+
+                BoolCutPlane plane;
+                GetTriangleBounds(p, q, r, plane.min, plane.max);
+
+                if (sa == 0 && sb == 0 && sc == 0)
+                {
+                    // coplanar, the edges of the other triangle separate boundary from the rest
+                    glm::dvec3 pts[3] = { p, q, r };
+                    for (int k = 0; k < 3; k++)
+                    {
+                        plane.a = pts[k];
+                        plane.b = pts[(k + 1) % 3];
+                        plane.c = pts[k] + targetNormal;
+                        _planes.push_back(plane);
+                    }
+                    continue;
+                }
+
+                double sp = orient3d(a, b, c, p);
+                double sq = orient3d(a, b, c, q);
+                double sr = orient3d(a, b, c, r);
+
+                int numZero = (sp == 0) + (sq == 0) + (sr == 0);
+                bool hasFront = sp > 0 || sq > 0 || sr > 0;
+                bool hasBack = sp < 0 || sq < 0 || sr < 0;
+                if (!(hasFront && hasBack) && numZero < 2)
+                {
+                    // misses the source plane or only touches it in a vertex
+                    continue;
+                }
+
+                // the part of the triangle on the source plane, as an interval along the line both planes share
+                glm::dvec3 pts[3] = { p, q, r };
+                double sides[3] = { sp, sq, sr };
+                glm::dvec3 dir = glm::normalize(glm::cross(normal, targetNormal));
+
+                // the other triangle of a quad usually follows, its plane is the same
+                bool merge = false;
+                if (!_planes.empty() && _planes.back().hasSegment && glm::dot(_planes.back().dir, dir) > 0)
+                {
+                    BoolCutPlane& last = _planes.back();
+                    merge = orient3d(last.a, last.b, last.c, p) == 0 && orient3d(last.a, last.b, last.c, q) == 0 && orient3d(last.a, last.b, last.c, r) == 0;
+                    if (merge)
+                    {
+                        // measured along the same line as the interval it extends
+                        dir = last.dir;
+                    }
+                }
+
+                double segmentMin = DBL_MAX;
+                double segmentMax = -DBL_MAX;
+                for (int k = 0; k < 3; k++)
+                {
+                    int next = (k + 1) % 3;
+                    if (sides[k] == 0)
+                    {
+                        double d = glm::dot(dir, pts[k]);
+                        segmentMin = std::min(segmentMin, d);
+                        segmentMax = std::max(segmentMax, d);
+                    }
+                    else if ((sides[k] > 0 && sides[next] < 0) || (sides[k] < 0 && sides[next] > 0))
+                    {
+                        glm::dvec3 crossing = pts[k] + (pts[next] - pts[k]) * (sides[k] / (sides[k] - sides[next]));
+                        double d = glm::dot(dir, crossing);
+                        segmentMin = std::min(segmentMin, d);
+                        segmentMax = std::max(segmentMax, d);
+                    }
+                }
+
+                if (merge)
+                {
+                    BoolCutPlane& last = _planes.back();
+                    last.min = glm::min(last.min, plane.min);
+                    last.max = glm::max(last.max, plane.max);
+                    last.segmentMin = std::min(last.segmentMin, segmentMin);
+                    last.segmentMax = std::max(last.segmentMax, segmentMax);
+                    continue;
+                }
+
+                plane.a = p;
+                plane.b = q;
+                plane.c = r;
+                plane.hasSegment = true;
+                plane.dir = dir;
+                plane.segmentMin = segmentMin;
+                plane.segmentMax = segmentMax;
+                _planes.push_back(plane);
+            }
+        }
+
+        // each piece only looks at the planes after the one that made it and near its own box
+        void SplitByPlanes()
+        {
+            BoolFragment triangle = _fragments[0];
+            _fragments.clear();
+            _tasks.clear();
+            _planeIndices.clear();
+
+            for (uint32_t i = 0; i < _planes.size(); i++)
+            {
+                _planeIndices.push_back(i);
+            }
+            _tasks.push_back({ triangle, 0, static_cast<uint32_t>(_planes.size()) });
+
+            while (!_tasks.empty())
+            {
+                BoolSplitTask task = _tasks.back();
+                _tasks.pop_back();
+
+                bool split = false;
+                uint32_t end = task.firstPlane + task.numPlanes;
+                for (uint32_t k = task.firstPlane; k < end; k++)
+                {
+                    const BoolCutPlane& plane = _planes[_planeIndices[k]];
+                    if (!BoxesOverlap(task.fragment.min, task.fragment.max, plane.min, plane.max))
+                    {
+                        continue;
+                    }
+
+                    BoolFragment front;
+                    BoolFragment back;
+                    if (Split(task.fragment, plane, front, back))
+                    {
+                        PushTask(front, k + 1, end);
+                        PushTask(back, k + 1, end);
+                        split = true;
+                        break;
+                    }
+                }
+
+                if (!split)
+                {
+                    _fragments.push_back(task.fragment);
+                }
+            }
+        }
+
+        void PushTask(const BoolFragment& fragment, uint32_t firstPlane, uint32_t endPlane)
+        {
+            uint32_t first = static_cast<uint32_t>(_planeIndices.size());
+            for (uint32_t k = firstPlane; k < endPlane; k++)
+            {
+                uint32_t plane = _planeIndices[k];
+                if (BoxesOverlap(fragment.min, fragment.max, _planes[plane].min, _planes[plane].max))
+                {
+                    _planeIndices.push_back(plane);
+                }
+            }
+
+            _tasks.push_back({ fragment, first, static_cast<uint32_t>(_planeIndices.size()) - first });
+        }
+
+        bool Split(const BoolFragment& fragment, const BoolCutPlane& plane, BoolFragment& front, BoolFragment& back)
+        {
+            _sides.clear();
+            bool hasFront = false;
+            bool hasBack = false;
+            for (uint32_t k = fragment.first; k < fragment.first + fragment.count; k++)
+            {
+                double side = orient3d(plane.a, plane.b, plane.c, _points[k]);
+                hasFront |= side > 0;
+                hasBack |= side < 0;
+                _sides.push_back(side);
+            }
+
+            if (!hasFront || !hasBack)
+            {
+                return false;
+            }
+
+            if (plane.hasSegment)
+            {
+                // the fragment crosses the plane, but maybe not where the triangle is
+                double fragmentMin = DBL_MAX;
+                double fragmentMax = -DBL_MAX;
+                for (uint32_t k = 0; k < fragment.count; k++)
+                {
+                    uint32_t next = (k + 1) % fragment.count;
+                    if ((_sides[k] > 0 && _sides[next] < 0) || (_sides[k] < 0 && _sides[next] > 0))
+                    {
+                        double d = glm::dot(plane.dir, GetCrossing(fragment.first + k, fragment.first + next, _sides[k], _sides[next]));
+                        fragmentMin = std::min(fragmentMin, d);
+                        fragmentMax = std::max(fragmentMax, d);
+                    }
+                    else if (_sides[k] == 0)
+                    {
+                        double d = glm::dot(plane.dir, _points[fragment.first + k]);
+                        fragmentMin = std::min(fragmentMin, d);
+                        fragmentMax = std::max(fragmentMax, d);
+                    }
+                }
+
+                if (fragmentMax < plane.segmentMin - EPS_SMALL || fragmentMin > plane.segmentMax + EPS_SMALL)
+                {
+                    return false;
+                }
+            }
+
+            front = { static_cast<uint32_t>(_points.size()), 0, glm::dvec3(DBL_MAX), glm::dvec3(-DBL_MAX) };
+            AddSide(fragment, true, front);
+            back = { static_cast<uint32_t>(_points.size()), 0, glm::dvec3(DBL_MAX), glm::dvec3(-DBL_MAX) };
+            AddSide(fragment, false, back);
+
+            return true;
+        }
+
+        void AddSide(const BoolFragment& fragment, bool front, BoolFragment& piece)
+        {
+            for (uint32_t k = 0; k < fragment.count; k++)
+            {
+                uint32_t next = (k + 1) % fragment.count;
+                double s0 = front ? _sides[k] : -_sides[k];
+                double s1 = front ? _sides[next] : -_sides[next];
+
+                if (s0 >= 0)
+                {
+                    AddPoint(_points[fragment.first + k], piece);
+                }
+
+                if ((s0 > 0 && s1 < 0) || (s0 < 0 && s1 > 0))
+                {
+                    AddPoint(GetCrossing(fragment.first + k, fragment.first + next, _sides[k], _sides[next]), piece);
+                }
+            }
+        }
+
+        // both neighbours of an edge compute its crossing from the same end, so they get the same point
+        glm::dvec3 GetCrossing(uint32_t i0, uint32_t i1, double s0, double s1)
+        {
+            glm::dvec3 p0 = _points[i0];
+            glm::dvec3 p1 = _points[i1];
+            if (p1.x < p0.x || (p1.x == p0.x && (p1.y < p0.y || (p1.y == p0.y && p1.z < p0.z))))
+            {
+                std::swap(p0, p1);
+                std::swap(s0, s1);
+            }
+
+            return p0 + (p1 - p0) * (s0 / (s0 - s1));
+        }
+
+        void AddPoint(glm::dvec3 pt, BoolFragment& piece)
+        {
+            _points.push_back(pt);
+            piece.count++;
+            piece.min = glm::min(piece.min, pt);
+            piece.max = glm::max(piece.max, pt);
+        }
+
+        void Emit(const BoolFragment& fragment, const glm::dvec3& normal, bool flip, IfcGeometry& result, BoolVertexTable& vertices)
+        {
+            glm::dvec3 n = flip ? -normal : normal;
+
+            // fragments are convex, a fan covers them
+            uint32_t first = fragment.first;
+            for (uint32_t k = 1; k + 1 < fragment.count; k++)
+            {
+                const glm::dvec3& a = _points[first];
+                const glm::dvec3& b = _points[first + k];
+                const glm::dvec3& c = _points[first + k + 1];
+
+                if (glm::length(glm::cross(b - a, c - a)) < EPS_MINISCULE)
+                {
+                    continue;
+                }
+
+                uint32_t ia = vertices.Add(result, a, n);
+                uint32_t ib = vertices.Add(result, b, n);
+                uint32_t ic = vertices.Add(result, c, n);
+
+                if (flip)
+                {
+                    result.AddFace(ia, ic, ib);
+                }
+                else
+                {
+                    result.AddFace(ia, ib, ic);
+                }
+            }
+        }
+
+        std::vector<glm::dvec3> _points;
+        std::vector<double> _sides;
+        std::vector<BoolFragment> _fragments;
+        std::vector<BoolCutPlane> _planes;
+        std::vector<uint32_t> _planeIndices;
+        std::vector<BoolSplitTask> _tasks;
+        std::vector<uint32_t> _candidates;
+    };
+
+    IfcGeometry meshBoolean(const IfcGeometry& mesh1, const IfcGeometry& mesh2, BoolOperation op)
+    {
+        IfcGeometry result;
+        BoolVertexTable vertices;
+        BoolMeshSplitter splitter;
+
+        BVH bvh1(mesh1);
+        BVH bvh2(mesh2);
+
+        switch (op)
+        {
+        case BoolOperation::DIFFERENCE:
+            splitter.Clip(mesh1, mesh2, bvh2, MeshLocation::OUTSIDE, false, false, result, vertices);
+            splitter.Clip(mesh2, mesh1, bvh1, MeshLocation::INSIDE, false, true, result, vertices);
+            break;
+        case BoolOperation::UNION:
+            splitter.Clip(mesh1, mesh2, bvh2, MeshLocation::OUTSIDE, true, false, result, vertices);
+            splitter.Clip(mesh2, mesh1, bvh1, MeshLocation::OUTSIDE, false, false, result, vertices);
+            break;
+        case BoolOperation::INTERSECTION:
+            splitter.Clip(mesh1, mesh2, bvh2, MeshLocation::INSIDE, true, false, result, vertices);
+            splitter.Clip(mesh2, mesh1, bvh1, MeshLocation::INSIDE, false, false, result, vertices);
+            break;
+        }
+
+        return result;
+    }
+}
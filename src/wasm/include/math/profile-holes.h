@@ -0,0 +1,127 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include "../../deps/glm/glm/glm.hpp"
+
+#include "../util.h"
+#include "line-segment-intersect.h"
+
+namespace webifc
+{
+    void getCurveBounds(const IfcCurve<2>& curve, glm::dvec2& min, glm::dvec2& max)
+    {
+        min = glm::dvec2(DBL_MAX);
+        max = glm::dvec2(-DBL_MAX);
+
+        for (auto& pt : curve.points)
+        {
+            min = glm::min(min, pt);
+            max = glm::max(max, pt);
+        }
+    }
+
+    // even-odd rule, points on the boundary can go either way
+    bool isInsideCurve(const glm::dvec2& pt, const IfcCurve<2>& curve)
+    {
+        bool inside = false;
+        size_t n = curve.points.size();
+
+        for (size_t i = 0, j = n - 1; i < n; j = i++)
+        {
+            const glm::dvec2& a = curve.points[i];
+            const glm::dvec2& b = curve.points[j];
+
+            if ((a.y > pt.y) != (b.y > pt.y) && pt.x < (b.x - a.x) * (pt.y - a.y) / (b.y - a.y) + a.x)
+            {
+                inside = !inside;
+            }
+        }
+
+        return inside;
+    }
+
+    // also tests the closing segment of curves that don't repeat their first point
+    bool doCurvesIntersect(const IfcCurve<2>& c1, const IfcCurve<2>& c2)
+    {
+        size_t n1 = c1.points.size();
+        size_t n2 = c2.points.size();
+
+        for (size_t i = 0; i < n1; i++)
+        {
+            const glm::dvec2& a = c1.points[i];
+            const glm::dvec2& b = c1.points[(i + 1) % n1];
+            if (equals2d(a, b))
+            {
+                continue;
+            }
+
+            for (size_t j = 0; j < n2; j++)
+            {
+                const glm::dvec2& c = c2.points[j];
+                const glm::dvec2& d = c2.points[(j + 1) % n2];
+                if (equals2d(c, d))
+                {
+                    continue;
+                }
+
+                if (doLineSegmentsIntersect(a, b, c, d))
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // adds the hole only if it lies strictly inside the outer curve and apart from the other holes
+    // anything touching is left for the 3D booleans
+    bool addProfileHole(IfcProfile& profile, IfcCurve<2> hole)
+    {
+        if (hole.points.size() < 3 || profile.curve.points.size() < 3)
+        {
+            return false;
+        }
+
+        glm::dvec2 min;
+        glm::dvec2 max;
+        getCurveBounds(hole, min, max);
+
+        for (auto& other : profile.holes)
+        {
+            glm::dvec2 otherMin;
+            glm::dvec2 otherMax;
+            getCurveBounds(other, otherMin, otherMax);
+
+            if (min.x <= otherMax.x && max.x >= otherMin.x && min.y <= otherMax.y && max.y >= otherMin.y)
+            {
+                return false;
+            }
+        }
+
+        for (auto& pt : hole.points)
+        {
+            if (!isInsideCurve(pt, profile.curve))
+            {
+                return false;
+            }
+        }
+
+        if (doCurvesIntersect(hole, profile.curve))
+        {
+            return false;
+        }
+
+        // holes run clockwise, like OrientProfile leaves them
+        if (hole.IsCCW())
+        {
+            hole.Invert();
+        }
+
+        profile.holes.push_back(std::move(hole));
+        return true;
+    }
+}
@@ -1,10 +1,14 @@
 /* This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
- 
+
  #pragma once
 
 #include <map>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include "../../deps/glm/glm/glm.hpp"
 #include "../../deps/earcut/include/mapbox/earcut.hpp"
 
@@ -15,766 +19,520 @@ namespace webifc
 {
     bool DUMP_SVG_TRIANGLES = false;
 
-    uint32_t pointID = 0;
-    uint32_t triangleID = 0;
+    // points closer than this to a vertex or an edge, relative to the start triangle, are snapped onto it
+    const double TRIANGULATION_EPS = EPS_SMALL;
 
-    double sign(const Point& p1, const Point& p2, const Point& p3)
+    // positive if c is left of a -> b
+    inline double orient2d(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c)
     {
-        return (p1.x - p3.x) * (p2.y - p3.y) - (p2.x - p3.x) * (p1.y - p3.y);
+        return cross2d(b - a, c - a);
     }
 
-    bool onEdge(const Point& p, const Point& a, const Point& b)
+    // positive if d is inside the circumcircle of the counter clockwise triangle a, b, c
+    inline double inCircle(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& d)
     {
-        double dist = std::fabs(sign(p, a, b));
-        return dist <= EPS_SMALL;
-    }
+        glm::dvec2 ad = a - d;
+        glm::dvec2 bd = b - d;
+        glm::dvec2 cd = c - d;
 
-    bool onEdge2(const Point& p, const Point& a, const Point& b)
-    {
-        double dist = std::fabs(sign(p, a, b));
-        return dist < EPS_BIG;
-    }
+        double ad2 = glm::dot(ad, ad);
+        double bd2 = glm::dot(bd, bd);
+        double cd2 = glm::dot(cd, cd);
 
-    double dot2d(const Point& p1, const Point& p2)
-    {
-        return p1.x * p2.x + p1.y * p2.y;
+        return ad.x * (bd.y * cd2 - bd2 * cd.y) - ad.y * (bd.x * cd2 - bd2 * cd.x) + ad2 * (bd.x * cd.y - bd.y * cd.x);
     }
 
-    bool isAboveLine(const Point& lineStart, const Point& lineDir, const Point& p)
+    //! Constrained Delaunay triangulation of points and segments inside a counter clockwise start triangle
+    //! Triangles find their neighbours through a map of directed edges, so a point or segment only visits the triangles it changes
+    class ConstrainedTriangulation
     {
-        Point ps = {
-            p.x - lineStart.x,
-            p.y - lineStart.y
-        };
-
-        Point perp = {
-            -lineDir.y,
-            lineDir.x
-        };
-
-        double psperp = dot2d(ps, perp);
-
-        return psperp >= 0;
-    }
-
-    bool isConvex(const Point& a, const Point& b, const Point& c)
-    {
-        double sign = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
-        return sign < -EPS_MINISCULE;
-    }
-
-    Point makePoint(double x, double y)
-    {
-        Point p;
-        p.id = pointID++;
-        p.x = x;
-        p.y = y;
-
-        return p;
-    }
-
-    // ccw
-    bool makeTriangle(std::vector<Triangle>& triangles, const Point& a, const Point& b, const Point& c)
-    {
-        Triangle t;
-        t.a = a;
-        t.b = b;
-        t.c = c;
-        t.id = triangleID++;
-
-        double area = areaOfTriangle(t.a(), t.b(), t.c());
-
-        if (area == 0)
+    public:
+        ConstrainedTriangulation(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c)
         {
-            // Should we be making this triangle at all?
-            //triangles.resize(t.id + 1);
-            //triangles[t.id].id = -1;
-            printf("0 triangle\n");
+            _points = { a, b, c };
+            _vertexTriangle = { 0, 0, 0 };
+            AddTriangle(0, 1, 2);
         }
 
-        triangles.resize(t.id + 1);
-        triangles[t.id] = t;
-
-        return true;
-    }
-
-    bool PointInTriangle(const Triangle& t, const Point& p)
-    {
-        double d1, d2, d3;
-        bool has_neg, has_pos;
-
-        d1 = sign(p, t.a, t.b);
-        d2 = sign(p, t.b, t.c);
-        d3 = sign(p, t.c, t.a);
-
-        has_neg = (d1 < -EPS_TINY) || (d2 < -EPS_TINY) || (d3 < -EPS_TINY);
-        has_pos = (d1 > EPS_TINY) || (d2 > EPS_TINY) || (d3 > EPS_TINY);
-
-        return !(has_neg && has_pos);
-    }
-
-    // TODO: slow
-    int32_t FindTriangleWithEdge(int32_t a, int32_t b, std::vector<Triangle>& triangles)
-    {
-        for (int i = 0; i < triangles.size(); i++)
+        //! Returns the vertex of the point, an existing one if it's that close, or -1 if it's outside the start triangle
+        int32_t AddPoint(const glm::dvec2& pt)
         {
-            Triangle& t = triangles[i];
-
-            if (t.id == -1) continue;
-
-            if (t.a.id == a && t.b.id == b)
+            int32_t t = Locate(pt);
+            if (t == -1)
             {
-                return i;
+                return -1;
             }
-            else if (t.b.id == a && t.c.id == b)
-            {
-                return i;
-            }
-            else if (t.c.id == a && t.a.id == b)
-            {
-                return i;
-            }
-        }
 
-        return -1;
-    }
-
-    // TODO: slow
-    std::vector<int32_t> FindTrianglesWithEdge(int32_t a, int32_t b, std::vector<Triangle>& triangles)
-    {
-        std::vector<int32_t> result;
-        std::vector<int32_t> deleted;
-        glm::dvec2 apt;
-        glm::dvec2 bpt;
-
-        for (int i = 0; i < triangles.size(); i++)
-        {
-            Triangle& t = triangles[i];
-
-            bool found = false;
-            if (t.a.id == a && t.b.id == b)
-            {
-                found = true;
-                apt = t.a();
-                bpt = t.b();
-            }
-            else if (t.b.id == a && t.c.id == b)
-            {
-                found = true;
-                apt = t.b();
-                bpt = t.c();
-            }
-            else if (t.c.id == a && t.a.id == b)
-            {
-                found = true;
-                apt = t.c();
-                bpt = t.a();
-            }
-            else if (t.a.id == b && t.b.id == a)
-            {
-                found = true;
-                apt = t.b();
-                bpt = t.a();
-            }
-            else if (t.b.id == b && t.c.id == a)
+            std::array<uint32_t, 3> tri = _triangles[t];
+            for (uint32_t v : tri)
             {
-                found = true;
-                apt = t.c();
-                bpt = t.b();
-            }
-            else if (t.c.id == b && t.a.id == a)
-            {
-                found = true;
-                apt = t.a();
-                bpt = t.c();
+                if (glm::distance(_points[v], pt) <= TRIANGULATION_EPS)
+                {
+                    return v;
+                }
             }
 
-            if (found)
+            uint32_t p = static_cast<uint32_t>(_points.size());
+            _points.push_back(pt);
+            _vertexTriangle.push_back(t);
+
+            for (int k = 0; k < 3; k++)
             {
-                if (t.id == -1)
-                {
-                    deleted.push_back(i);
-                }
-                else
+                uint32_t a = tri[k];
+                uint32_t b = tri[(k + 1) % 3];
+                if (DistanceToLine(a, b, pt) <= TRIANGULATION_EPS)
                 {
-                    result.push_back(i);
+                    SplitEdge(a, b, p);
+                    return p;
                 }
             }
-        }
-
-        Triangle& t = triangles[0];
-        Point pta;
-        pta.x = apt.x;
-        pta.y = apt.y;
-        Point ptb;
-        ptb.x = bpt.x;
-        ptb.y = bpt.y;
 
-        bool bothOnEdge = (onEdge2(pta, t.a, t.b) && onEdge2(ptb, t.a, t.b)) || (onEdge2(pta, t.b, t.c) && onEdge2(ptb, t.b, t.c)) || (onEdge2(pta, t.c, t.a) && onEdge2(ptb, t.c, t.a));
+            uint32_t a = tri[0];
+            uint32_t b = tri[1];
+            uint32_t c = tri[2];
+            RemoveTriangle(t);
+            AddTriangle(a, b, p);
+            AddTriangle(b, c, p);
+            AddTriangle(c, a, p);
 
-        // every edge must be replaced by a new edge, whether it has 1 or 2 adjacent triangles
-        // a mismatch here means we made a mistake
-        if (result.size() > 2)
-        {
-            printf("Triangle with this edge already deleted!");
+            std::vector<std::pair<uint32_t, uint32_t>> flips = { { a, b }, { b, c }, { c, a } };
+            Legalize(flips);
+            return p;
         }
 
-        return result;
-    }
-
-    void CheckTriangleEdges(Triangle& t, std::vector<Triangle>& triangles)
-    {
-        FindTrianglesWithEdge(t.a.id, t.b.id, triangles);
-        FindTrianglesWithEdge(t.b.id, t.c.id, triangles);
-        FindTrianglesWithEdge(t.c.id, t.a.id, triangles);
-    }
-
-    void triangulateBoundary(std::vector<Point>& boundary, std::vector<Triangle>& triangles)
-    {
-        // special case triangle
-        if (boundary.size() == 3)
-        {
-            // can just create a triangle for the boundary, no triangulation needed
-            makeTriangle(triangles, boundary[2], boundary[1], boundary[0]);
-        }
-        else
+        //! Makes sure the segment between two vertices is an edge, segments crossing an earlier one are skipped
+        void AddSegment(uint32_t u, uint32_t v)
         {
-            // here we actually do a monotone mountain triangulation!
-            // see: http://www.ams.sunysb.edu/~jsbm/courses/345/13/triangulating-monotone-mountains.pdf
-            // for an incomplete description
-            int iteration = 0;
-            for (int i = 1; i < boundary.size() - 1;)
+            while (u != v)
             {
-                iteration++;
-                if (iteration > 1000)
+                if (FindTriangle(u, v) != -1 || FindTriangle(v, u) != -1)
                 {
-                    printf("asdfasdf");
+                    _constraints.insert(UndirectedKey(u, v));
+                    return;
                 }
 
-                bool notConvex = false;
-                if (isConvex(boundary[i - 1], boundary[i], boundary[i + 1]))
-                {
-                    makeTriangle(triangles, boundary[i + 1], boundary[i], boundary[i - 1]);
-                    boundary.erase(boundary.begin() + i);
-                }
-                else
+                // triangles crossed by u -> v, with the vertices left and right of it
+                std::vector<uint32_t> crossed;
+                std::vector<uint32_t> left;
+                std::vector<uint32_t> right;
+                uint32_t end = v;
+
+                int32_t t = FindFirstCrossing(u, v);
+                if (t < 0)
                 {
-                    notConvex = true;
+                    // u -> v runs through a vertex next to u
+                    if (t == -1)
+                    {
+                        return;
+                    }
+
+                    uint32_t w = static_cast<uint32_t>(-t - 2);
+                    _constraints.insert(UndirectedKey(u, w));
+                    u = w;
+                    continue;
                 }
 
-                if (i != 1 && isConvex(boundary[i - 2], boundary[i - 1], boundary[i]))
+                uint32_t r = Next(t, u);
+                uint32_t l = Next(t, r);
+                crossed.push_back(t);
+                right.push_back(r);
+                left.push_back(l);
+
+                while (true)
                 {
-                    i = i - 1;
+                    if (_constraints.count(UndirectedKey(r, l)))
+                    {
+                        return;
+                    }
+
+                    int32_t next = FindTriangle(l, r);
+                    if (next == -1)
+                    {
+                        return;
+                    }
+
+                    crossed.push_back(next);
+                    uint32_t w = Next(next, r);
+                    if (w == v || DistanceToLine(u, v, _points[w]) <= TRIANGULATION_EPS)
+                    {
+                        end = w;
+                        break;
+                    }
+
+                    if (orient2d(_points[u], _points[v], _points[w]) < 0)
+                    {
+                        right.push_back(w);
+                        r = w;
+                    }
+                    else
+                    {
+                        left.push_back(w);
+                        l = w;
+                    }
                 }
-                else if (notConvex)
+
+                for (uint32_t c : crossed)
                 {
-                    // prevent infinite loop
-                    i = i + 1;
+                    RemoveTriangle(c);
                 }
-            }
-        }
-    }
 
-    std::vector<Point> deduplicateConcecutivePoints(std::vector<Point>& pts)
-    {
-        std::vector<Point> result;
+                std::reverse(right.begin(), right.end());
+                TriangulatePseudoPolygon(u, end, left, 0, left.size());
+                TriangulatePseudoPolygon(end, u, right, 0, right.size());
+                _constraints.insert(UndirectedKey(u, end));
 
-        if (!pts.empty())
-        {
-            result.push_back(pts[0]);
+                u = end;
+            }
         }
-        for (int i = 1; i < pts.size(); i++)
+
+        std::vector<Triangle> GetTriangles() const
         {
-            Point& p = pts[i];
-            Point& prev = pts[i - 1];
-            if (p.id != prev.id)
+            std::vector<Triangle> triangles;
+
+            for (size_t i = 0; i < _triangles.size(); i++)
             {
-                result.push_back(p);
-            }
-        }
+                if (!_alive[i])
+                {
+                    continue;
+                }
 
-        return result;
-    }
+                Triangle t;
+                t.a = MakePoint(_triangles[i][0]);
+                t.b = MakePoint(_triangles[i][1]);
+                t.c = MakePoint(_triangles[i][2]);
+                t.id = static_cast<int32_t>(triangles.size());
+                triangles.push_back(t);
+            }
 
-    Point GetOtherPoint(Triangle& t, int32_t id1, int32_t id2)
-    {
-        if (t.a.id != id1 && t.a.id != id2)
-        {
-            return t.a;
+            return triangles;
         }
-        if (t.b.id != id1 && t.b.id != id2)
+
+    private:
+        static uint64_t DirectedKey(uint32_t a, uint32_t b)
         {
-            return t.b;
+            return (static_cast<uint64_t>(a) << 32) | b;
         }
-        if (t.c.id != id1 && t.c.id != id2)
+
+        static uint64_t UndirectedKey(uint32_t a, uint32_t b)
         {
-            return t.c;
+            return a < b ? DirectedKey(a, b) : DirectedKey(b, a);
         }
 
-        return Point();
-    }
-
-    bool HasPoint(Triangle& t, int32_t id)
-    {
-        if (t.a.id == id || t.b.id == id || t.c.id == id)
+        Point MakePoint(uint32_t v) const
         {
-            return true;
+            Point p(_points[v]);
+            p.id = static_cast<int32_t>(v);
+            return p;
         }
-        return false;
-    }
-
-    bool EdgeEqual(Edge& e, Point& a, Point& b)
-    {
-        return (e.a == a.id && e.b == b.id) || (e.b == a.id && e.a == b.id);
-    }
 
-    void DumpPrevTriangles(size_t num, Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        std::vector<Triangle> temp;
-        for (size_t i = 0; i < num; i++)
+        double DistanceToLine(uint32_t a, uint32_t b, const glm::dvec2& pt) const
         {
-            Triangle t = triangles[triangles.size() - 1 - i];
-            CheckTriangleEdges(t, triangles);
+            double length = glm::distance(_points[a], _points[b]);
+            if (length == 0)
+            {
+                return glm::distance(_points[a], pt);
+            }
 
-            t.id = 0;
-            temp.push_back(t);
+            return std::fabs(orient2d(_points[a], _points[b], pt)) / length;
         }
-        DumpSVGTriangles(temp, p, prev, L"triangles.svg");
-    }
 
-    void DumpTriangleID(int num, Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        std::vector<Triangle> temp;
-        Triangle t = triangles[num];
-        t.id = 0;
-        temp.push_back(t);
-        DumpSVGTriangles(temp, p, prev, L"triangle.svg");
-    }
-
-    void DeleteTriangle(int id, std::vector<Triangle>& triangles)
-    {
-        auto t = triangles[id];
-     
-        /*
-        int a = 17;
-        int b = 18;
-        if ((t.a.id == a && t.b.id == b) || (t.b.id == a && t.c.id == b) || (t.c.id == a && t.a.id == b))
+        void AddTriangle(uint32_t a, uint32_t b, uint32_t c)
         {
-            printf("asdf");
-        }
-        
-        int check = 18;
-        if (t.a.id == 18 || t.b.id == 18 || t.c.id == 18)
-        {
-            printf("asdf");
-        }
-        if (t.id == 43)
-        {
-            printf("asdf");
-        }
-        */
+            uint32_t t = static_cast<uint32_t>(_triangles.size());
+            _triangles.push_back({ a, b, c });
+            _alive.push_back(true);
 
-        triangles[id].id = -1;
-    }
+            _edges[DirectedKey(a, b)] = t;
+            _edges[DirectedKey(b, c)] = t;
+            _edges[DirectedKey(c, a)] = t;
 
-    bool addPointToTriangle(Triangle t, Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        bool isInTriangle = PointInTriangle(t, p);
-        if (!isInTriangle)
-        {
-            return false;
+            _vertexTriangle[a] = t;
+            _vertexTriangle[b] = t;
+            _vertexTriangle[c] = t;
+            _lastTriangle = t;
         }
-        if (DUMP_SVG_TRIANGLES) DumpTriangleID(t.id, p, prev, triangles);
-
-        bool isOnEdge = false;
-        Edge edge;
 
-        Point pA;
-        Point pB;
-        if (onEdge(p, t.a, t.b))
+        void RemoveTriangle(uint32_t t)
         {
-            isOnEdge = true;
-            pA = t.a;
-            pB = t.b;
+            _alive[t] = false;
+
+            for (int k = 0; k < 3; k++)
+            {
+                auto it = _edges.find(DirectedKey(_triangles[t][k], _triangles[t][(k + 1) % 3]));
+                if (it != _edges.end() && it->second == t)
+                {
+                    _edges.erase(it);
+                }
+            }
         }
-        else if (onEdge(p, t.b, t.c))
+
+        int32_t FindTriangle(uint32_t a, uint32_t b) const
         {
-            isOnEdge = true;
-            pA = t.b;
-            pB = t.c;
+            auto it = _edges.find(DirectedKey(a, b));
+            return it == _edges.end() ? -1 : static_cast<int32_t>(it->second);
         }
-        else if (onEdge(p, t.c, t.a))
+
+        // vertex after v in triangle t, counter clockwise
+        uint32_t Next(uint32_t t, uint32_t v) const
         {
-            isOnEdge = true;
-            pA = t.c;
-            pB = t.a;
+            const auto& tri = _triangles[t];
+            return tri[0] == v ? tri[1] : (tri[1] == v ? tri[2] : tri[0]);
         }
 
-        if (isOnEdge)
+        // walks towards the point from the last triangle, every step crosses an edge the point lies beyond
+        int32_t Locate(const glm::dvec2& pt) const
         {
-            edge.a = pA.id;
-            edge.b = pB.id;
-
-            // yep, its on an edge
-            int32_t tri1 = FindTriangleWithEdge(pA.id, pB.id, triangles);
-            int32_t tri2 = FindTriangleWithEdge(pB.id, pA.id, triangles);
-
-            if (tri1 != -1)
+            uint32_t t = _lastTriangle;
+            for (size_t step = 0; step < _triangles.size(); step++)
             {
-                DeleteTriangle(tri1, triangles);
-
-                Point tri1p = GetOtherPoint(triangles[tri1], pA.id, pB.id);
-                makeTriangle(triangles, pA, p, tri1p);
-                makeTriangle(triangles, p, pB, tri1p);
-
-            }
+                bool moved = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t a = _triangles[t][k];
+                    uint32_t b = _triangles[t][(k + 1) % 3];
+                    if (orient2d(_points[a], _points[b], pt) < 0 && DistanceToLine(a, b, pt) > TRIANGULATION_EPS)
+                    {
+                        int32_t next = FindTriangle(b, a);
+                        if (next == -1)
+                        {
+                            // beyond the outline of the start triangle
+                            return -1;
+                        }
+
+                        t = next;
+                        moved = true;
+                        break;
+                    }
+                }
 
-            if (tri1 != -1 && tri2 == -1)
-            {
-                if (DUMP_SVG_TRIANGLES) DumpPrevTriangles(2, p, prev, triangles);
+                if (!moved)
+                {
+                    return t;
+                }
             }
 
-
-            if (tri2 != -1)
+            // the walk can circle in triangulations that aren't Delaunay, fall back to checking every triangle
+            for (size_t i = 0; i < _triangles.size(); i++)
             {
-                DeleteTriangle(tri2, triangles);
-
-                Point tri2p = GetOtherPoint(triangles[tri2], pA.id, pB.id);
-                makeTriangle(triangles, pA, tri2p, p);
-                makeTriangle(triangles, p, tri2p, pB);
+                if (!_alive[i])
+                {
+                    continue;
+                }
 
-                if (DUMP_SVG_TRIANGLES) DumpPrevTriangles(2, p, prev, triangles);
-            }
+                bool inside = true;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t a = _triangles[i][k];
+                    uint32_t b = _triangles[i][(k + 1) % 3];
+                    if (orient2d(_points[a], _points[b], pt) < 0 && DistanceToLine(a, b, pt) > TRIANGULATION_EPS)
+                    {
+                        inside = false;
+                        break;
+                    }
+                }
 
-            // also check tri1
-            if (tri1 != -1 && tri2 != -1)
-            {
-                if (DUMP_SVG_TRIANGLES) DumpPrevTriangles(4, p, prev, triangles);
+                if (inside)
+                {
+                    return static_cast<int32_t>(i);
+                }
             }
-         
-            return true;
-        }
-        else // not on an edge, but is inside triangle
-        {
-            // nope, its in the interior, lets split the triangle in 3 subtriangles.
-            makeTriangle(triangles, t.a, t.b, p);
-            makeTriangle(triangles, t.a, p, t.c);
-            makeTriangle(triangles, p, t.b, t.c);
-
-
-            DeleteTriangle(t.id, triangles);
-
-            if (DUMP_SVG_TRIANGLES) DumpPrevTriangles(3, p, prev, triangles);
 
-            return true;
+            return -1;
         }
-    }
 
-    void TriangulateBoundary(Point& p, Point& prev, std::vector<Triangle>& triangles, std::vector<Point>& boundary)
-    {
-        Point dirToPrev = {
-            prev.x - p.x,
-            prev.y - p.y
-        };
+        // splits the edge a -> b and its twin at p, p lies on the edge
+        void SplitEdge(uint32_t a, uint32_t b, uint32_t p)
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> flips;
 
-        // figure out what the mountains are
-        std::vector<Point> boundaryUp;
-        std::vector<Point> boundaryDown;
+            int32_t t1 = FindTriangle(a, b);
+            int32_t t2 = FindTriangle(b, a);
 
-        for (auto& pt : boundary)
-        {
-            if (isAboveLine(p, dirToPrev, pt))
+            if (t1 != -1)
             {
-                boundaryUp.push_back(pt);
+                uint32_t c = Next(t1, b);
+                RemoveTriangle(t1);
+                AddTriangle(a, p, c);
+                AddTriangle(p, b, c);
+                flips.push_back({ c, a });
+                flips.push_back({ b, c });
             }
-            else
+
+            if (t2 != -1)
             {
-                boundaryDown.push_back(pt);
+                uint32_t d = Next(t2, a);
+                RemoveTriangle(t2);
+                AddTriangle(b, p, d);
+                AddTriangle(p, a, d);
+                flips.push_back({ d, b });
+                flips.push_back({ a, d });
             }
-        }
-
-        // remove consecutive duplicates
-        boundaryUp = deduplicateConcecutivePoints(boundaryUp);
-        boundaryDown = deduplicateConcecutivePoints(boundaryDown);
 
+            if (_constraints.erase(UndirectedKey(a, b)))
+            {
+                _constraints.insert(UndirectedKey(a, p));
+                _constraints.insert(UndirectedKey(p, b));
+            }
 
-        // now we have two boundaries and a line segment, we can create two monotone mountains and triangulate them
-        boundaryUp.insert(boundaryUp.begin(), p);
-        boundaryUp.push_back(prev);
-
-        boundaryDown.insert(boundaryDown.begin(), p);
-        boundaryDown.push_back(prev);
-        std::reverse(boundaryDown.begin(), boundaryDown.end());
+            Legalize(flips);
+        }
 
+        // flips edges a -> b whose opposite triangle has its far vertex inside the circumcircle
+        void Legalize(std::vector<std::pair<uint32_t, uint32_t>>& flips)
+        {
+            while (!flips.empty())
+            {
+                auto [a, b] = flips.back();
+                flips.pop_back();
 
-        size_t start = triangles.size();
+                int32_t t1 = FindTriangle(a, b);
+                int32_t t2 = FindTriangle(b, a);
+                if (t1 == -1 || t2 == -1 || _constraints.count(UndirectedKey(a, b)))
+                {
+                    continue;
+                }
 
-        if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles1.svg");
-        triangulateBoundary(boundaryUp, triangles);
-        if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles2.svg");
-        triangulateBoundary(boundaryDown, triangles);
-        if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles3.svg");
+                uint32_t p = Next(t1, b);
+                uint32_t d = Next(t2, a);
 
-        size_t size = triangles.size() - start;
+                const glm::dvec2& pa = _points[a];
+                const glm::dvec2& pb = _points[b];
+                const glm::dvec2& pp = _points[p];
+                const glm::dvec2& pd = _points[d];
 
-        if (DUMP_SVG_TRIANGLES) DumpPrevTriangles(size, p, prev, triangles);
-    }
+                // the new triangles must keep their winding, the quad may not be convex within tolerance
+                if (inCircle(pa, pb, pp, pd) <= EPS_MINISCULE || orient2d(pp, pa, pd) <= 0 || orient2d(pp, pd, pb) <= 0)
+                {
+                    continue;
+                }
 
-    bool connectPointsFromTriangle(Triangle t, Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        if (prev.id == t.a.id || prev.id == t.b.id || prev.id == t.c.id)
-        {
-            // we already have an edge from p to prev, because it's part of triangle t
-            return true;
+                RemoveTriangle(t1);
+                RemoveTriangle(t2);
+                AddTriangle(p, a, d);
+                AddTriangle(p, d, b);
+                flips.push_back({ a, d });
+                flips.push_back({ d, b });
+            }
         }
-        else
+
+        // any living triangle that has v as a corner
+        int32_t FindVertexTriangle(uint32_t v) const
         {
-            bool isInTriangle = PointInTriangle(t, prev);
-            if (isInTriangle)
+            uint32_t t = _vertexTriangle[v];
+            const auto& tri = _triangles[t];
+            if (_alive[t] && (tri[0] == v || tri[1] == v || tri[2] == v))
             {
-                // prev is geometrically inside this triangle, which should not be the case
-                // it should either be part of the triangle or outside it
-                // inside implies we did a bad job adding points!
-                printf("already in tri!\n");
+                return t;
             }
 
-
-            // no edge to previous
-            Point dirToPrev = {
-                prev.x - p.x,
-                prev.y - p.y
-            };
-
-            // because P is on the triangle, there's only one possible intersection line, the line not containing p
-            Point p1;
-            Point p2;
-
-            if (t.a.id == p.id)
-            {
-                p1 = t.b;
-                p2 = t.c;
-            }
-            else if (t.b.id == p.id)
-            {
-                p1 = t.c;
-                p2 = t.a;
-            }
-            else if (t.c.id == p.id)
+            for (size_t i = 0; i < _triangles.size(); i++)
             {
-                p1 = t.a;
-                p2 = t.b;
+                if (_alive[i] && (_triangles[i][0] == v || _triangles[i][1] == v || _triangles[i][2] == v))
+                {
+                    return static_cast<int32_t>(i);
+                }
             }
 
+            return -1;
+        }
 
-            // TODO: check if p1 or p2 lies exactly on p -> prev, if so recursive call on that point
-            // this is unlikely to happen, really only when a void has an internal touch OR when we start processing multiple voids in one pass.
-            // checking for this situation would also have to happen below
-
-            // p1 or p2 don't lie on p -> prev, so either internal segment p1 -> p2 intersects, or we don't have any intersection
-            bool linesIntersect = doLineSegmentsIntersect(p1(), p2(), p(), prev(), false);
-
-            if (!linesIntersect)
+        // triangle at u that u -> v leaves through, -1 if there is none, or -2 - w if u -> v runs through the vertex w next to u
+        int32_t FindFirstCrossing(uint32_t u, uint32_t v) const
+        {
+            int32_t start = FindVertexTriangle(u);
+            if (start == -1)
             {
-                if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles.svg");
-                Triangle tempCopy = t;
-                tempCopy.id = 0;
-                if (DUMP_SVG_TRIANGLES) DumpSVGTriangles({ tempCopy }, p, prev, L"triangle.svg");
-                // no intersection at p1, p2, or p1 -> p2, so this triangle is facing the wrong way
-                return false;
+                return -1;
             }
 
-            // we search in direction of p1 -> p2, so find other triangle on that edge
-            int32_t curTriangle = FindTriangleWithEdge(p2.id, p1.id, triangles);
+            const glm::dvec2& pu = _points[u];
+            const glm::dvec2& pv = _points[v];
+            double length = glm::distance(pu, pv);
 
-            if (curTriangle == -1)
-            {
-                if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles.svg");
-                Triangle tempCopy = t;
-                tempCopy.id = 0;
-                if (DUMP_SVG_TRIANGLES) DumpSVGTriangles({ tempCopy }, p, prev, L"triangle.svg");
-                printf("Something went wrong 2!");
-                return false;
-            }
-
-            uint32_t drawnTriangle = curTriangle;
+            auto check = [&](uint32_t t) -> int32_t {
+                uint32_t p1 = Next(t, u);
+                uint32_t p2 = Next(t, p1);
 
-            if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"trianglesx.svg");
-            DeleteTriangle(t.id, triangles);
-            DeleteTriangle(curTriangle, triangles);
-            if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles0.svg");
+                for (uint32_t w : { p1, p2 })
+                {
+                    glm::dvec2 d = _points[w] - pu;
+                    double along = glm::dot(d, pv - pu) / length;
+                    if (along > 0 && along < length && DistanceToLine(u, v, _points[w]) <= TRIANGULATION_EPS)
+                    {
+                        return -2 - static_cast<int32_t>(w);
+                    }
+                }
 
-            std::vector<Point> boundary;
-            boundary.push_back(p1);
-            boundary.push_back(p2);
+                if (orient2d(pu, pv, _points[p1]) < 0 && orient2d(pu, pv, _points[p2]) > 0)
+                {
+                    return static_cast<int32_t>(t);
+                }
 
-            Edge prevEdge;
-            prevEdge.a = p2.id;
-            prevEdge.b = p1.id;
+                return -1;
+            };
 
-            while (true)
+            // around u counter clockwise, then clockwise if the fan is open
+            int32_t t = start;
+            do
             {
-                if (curTriangle == -1)
+                int32_t result = check(t);
+                if (result != -1)
                 {
-                    if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, p, prev, L"triangles.svg");
-                    printf("Failed to find cur triangle!");
-                    return true;
+                    return result;
                 }
 
-                // proces this triangle
-                DeleteTriangle(curTriangle, triangles);
-
-                Triangle& cur = triangles[curTriangle];
+                uint32_t p2 = Next(t, Next(t, u));
+                t = FindTriangle(u, p2);
+            } while (t != -1 && t != start);
 
-                if (cur.a.id == prev.id || cur.b.id == prev.id || cur.c.id == prev.id)
-                {
-                    // reached prev
-                    break;
-                }
-                else
+            if (t == -1)
+            {
+                t = FindTriangle(Next(start, u), u);
+                while (t != -1)
                 {
-                    // select new triangle
-                    bool i1 = !EdgeEqual(prevEdge, cur.a, cur.b)
-                        && doLineSegmentsIntersect(cur.a(), cur.b(), p(), prev(), true);
-                    bool i2 = !EdgeEqual(prevEdge, cur.b, cur.c)
-                        && doLineSegmentsIntersect(cur.b(), cur.c(), p(), prev(), true);
-                    bool i3 = !EdgeEqual(prevEdge, cur.c, cur.a)
-                        && doLineSegmentsIntersect(cur.c(), cur.a(), p(), prev(), true);
-                    int32_t nextTriangle = -1;
-                    if (i1)
-                    {
-                        nextTriangle = FindTriangleWithEdge(cur.b.id, cur.a.id, triangles);
-                        prevEdge.a = cur.b.id;
-                        prevEdge.b = cur.a.id;
-                        boundary.push_back(cur.a);
-                        boundary.push_back(cur.b);
-                    }
-                    else if (i2)
-                    {
-                        nextTriangle = FindTriangleWithEdge(cur.c.id, cur.b.id, triangles);
-                        prevEdge.a = cur.c.id;
-                        prevEdge.b = cur.b.id;
-                        boundary.push_back(cur.b);
-                        boundary.push_back(cur.c);
-                    }
-                    else if (i3)
+                    int32_t result = check(t);
+                    if (result != -1)
                     {
-                        nextTriangle = FindTriangleWithEdge(cur.a.id, cur.c.id, triangles);
-                        prevEdge.a = cur.a.id;
-                        prevEdge.b = cur.c.id;
-                        boundary.push_back(cur.c);
-                        boundary.push_back(cur.a);
+                        return result;
                     }
 
-                    if (nextTriangle == -1)
-                    {
-                        Triangle tempCopyT = t;
-                        tempCopyT.id = 0;
-                        Triangle tempCopyCur = triangles[curTriangle];
-                        tempCopyCur.id = 0;
-                        DumpSVGTriangles({ tempCopyT, tempCopyCur }, p, prev, L"triangle.svg");
-
-                        DumpSVGTriangles(triangles, p, prev, L"triangles.svg");
-                        printf("Failed to find cur triangle!");
-                        return true;
-                    }
-
-                    curTriangle = nextTriangle;
+                    t = FindTriangle(Next(t, u), u);
                 }
             }
 
-            TriangulateBoundary(p, prev, triangles, boundary);
-            return true;
-        } 
-    }
-
-    void addPoint(Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        // prevent infinite loops
-        size_t numTriangles = triangles.size();
-        for (size_t i = 0; i < numTriangles; i++)
-        {
-            if (triangles[i].id != -1)
-            {
-                if (addPointToTriangle(triangles[i], p, prev, triangles))
-                {
-                    return;
-                }
-            }
+            return -1;
         }
-        printf("no bueno");
-    }
 
-    void connectPoints(Point& p, Point& prev, std::vector<Triangle>& triangles)
-    {
-        // check if points are already connected
-        size_t numTriangles = triangles.size();
-        for (size_t i = 0; i < numTriangles; i++)
+        // fills the area between a -> b and the chain of vertices left of it, the chain runs from a to b
+        void TriangulatePseudoPolygon(uint32_t a, uint32_t b, const std::vector<uint32_t>& chain, size_t begin, size_t end)
         {
-            Triangle& t = triangles[i];
-            if (t.id != -1)
+            if (begin == end)
             {
-                // t contains p
-                if (t.a.id == p.id || t.b.id == p.id || t.c.id == p.id)
-                {
-                    // t contains prev
-                    if (t.a.id == prev.id || t.b.id == prev.id || t.c.id == prev.id)
-                    {
-                        // t contains p and prev, no need to search further: p->prev is already connected
-                        return;
-                    }
-                }
+                return;
             }
-        }
 
-
-        // prevent infinite loops
-        numTriangles = triangles.size();
-        for (size_t i = 0; i < numTriangles; i++)
-        {
-            Triangle& t = triangles[i];
-            if (t.id != -1)
+            size_t c = begin;
+            for (size_t i = begin + 1; i < end; i++)
             {
-                if (t.a.id == p.id || t.b.id == p.id || t.c.id == p.id)
+                if (inCircle(_points[a], _points[b], _points[chain[c]], _points[chain[i]]) > 0)
                 {
-                    if (connectPointsFromTriangle(t, p, prev, triangles))
-                    {
-                        return;
-                    }
+                    c = i;
                 }
             }
-        }
-        printf("no bueno");
-    }
-
-    const int32_t steps = 100000;
-
-    glm::dvec2 toGrid(const glm::dvec2& min, const glm::dvec2& dim, const glm::dvec2& pt)
-    {
-        double multiplierX = 1 / dim.x * steps;
-        double multiplierY = 1 / dim.y * steps;
 
-        return {
-            (pt.x - min.x) * multiplierX,
-            (pt.y - min.y) * multiplierY
-        };
-    }
-
-    Point getPoint(const glm::dvec2& min, const glm::dvec2& dim, const glm::dvec2& pt, std::vector<Point>& points, bool& added)
-    {
-        added = false;
-        for (int i = 0; i < points.size(); i++)
-        {
-            // TODO: looks like EPS_SMALL may not be enough here
-            if (equals2d(toGrid(min, dim, pt), toGrid(min, dim, points[i]()), EPS_SMALL))
-            {
-                return points[i];
-            }
+            TriangulatePseudoPolygon(a, chain[c], chain, begin, c);
+            TriangulatePseudoPolygon(chain[c], b, chain, c + 1, end);
+            AddTriangle(a, b, chain[c]);
         }
-        added = true;
-        Point newPt = makePoint(pt.x, pt.y);
-        points.push_back(newPt);
-        return newPt;
-    }
+
+        std::vector<glm::dvec2> _points;
+        std::vector<std::array<uint32_t, 3>> _triangles;
+        std::vector<bool> _alive;
+        std::vector<uint32_t> _vertexTriangle;
+        std::unordered_map<uint64_t, uint32_t> _edges;
+        std::unordered_set<uint64_t> _constraints;
+        uint32_t _lastTriangle = 0;
+    };
 
     bool IsValidTriangulation(const std::vector<Triangle>& triangles)
     {
@@ -827,86 +585,35 @@ namespace webifc
         return valid;
     }
 
-    int instance = 0;
-
+    // triangulates the counter clockwise triangle a, b, c with the points and segments of the loops as vertices and edges
+    // points and segments outside the triangle are left out
     std::vector<Triangle> triangulate(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, std::vector<Loop>& loops)
     {
-        instance++;
-
-        triangleID = 0;
-        pointID = 0;
-
-        glm::dvec2 min = glm::min(a, glm::min(b, c));
-        glm::dvec2 max = glm::max(a, glm::max(b, c));
-
-        glm::dvec2 dim = max - min;
-
-        std::vector<Triangle> triangles;
-        std::vector<Point> points;
-        bool added;
-        Point pa = getPoint(min, dim, a, points, added);
-        Point pb = getPoint(min, dim, b, points, added);
-        Point pc = getPoint(min, dim, c, points, added);
+        ConstrainedTriangulation triangulation(a, b, c);
 
-        makeTriangle(triangles, pa, pb, pc);
-
-        std::vector<glm::dvec2> sortedPoints;
-        std::vector<std::pair<int, int>> connectPairs;
+        std::vector<std::pair<int32_t, int32_t>> segments;
         for (auto& loop : loops)
         {
-            if (loop.hasOne)
-            {
-                sortedPoints.push_back(loop.v1);
-            }
-            else
+            int32_t v1 = triangulation.AddPoint(loop.v1);
+            if (!loop.hasOne)
             {
-                sortedPoints.push_back(loop.v1);
-                sortedPoints.push_back(loop.v2);
+                int32_t v2 = triangulation.AddPoint(loop.v2);
+                segments.push_back({ v1, v2 });
             }
         }
 
-        std::sort(sortedPoints.begin(), sortedPoints.end(), [&](glm::dvec2 v1, glm::dvec2 v2) {
-            double dist1 = std::min(glm::distance(v1, a), std::min(glm::distance(v1, b), glm::distance(v1, c)));
-            double dist2 = std::min(glm::distance(v2, a), std::min(glm::distance(v2, b), glm::distance(v2, c)));
-            return dist1 < dist2;
-        });
-
-        // add all the points to triangle a,b,c
-        for (auto& p : sortedPoints)
+        for (auto& [v1, v2] : segments)
         {
-            Point prev;
-            Point pt = getPoint(min, dim, p, points, added);
-            if (added)
+            if (v1 != -1 && v2 != -1)
             {
-                bool ptInside = PointInTriangle(triangles[0], pt);
-                if (ptInside)
-                {
-                    addPoint(pt, prev, triangles);
-                    if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, pt, prev, L"triangles2.svg");
-                }
+                triangulation.AddSegment(v1, v2);
             }
         }
 
-        // connect any loops that need connecting
-        for (auto& loop : loops)
-        {
-            if (!loop.hasOne)
-            {
-                Point pt1 = getPoint(min, dim, loop.v1, points, added);
-                Point pt2 = getPoint(min, dim, loop.v2, points, added);
-
+        std::vector<Triangle> triangles = triangulation.GetTriangles();
 
-                bool pt1Inside = PointInTriangle(triangles[0], pt1);
-                bool pt2Inside = PointInTriangle(triangles[0], pt2);
-
-                if (pt1Inside && pt2Inside)
-                {
-                    connectPoints(pt1, pt2, triangles);
-                }
-
-            }
-        }
+        if (DUMP_SVG_TRIANGLES) DumpSVGTriangles(triangles, Point(), Point(), L"triangles.svg");
 
         return triangles;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "../../deps/glm/glm/glm.hpp"
+
+#include "../util.h"
+
+namespace webifc
+{
+    // finalizer of MurmurHash3, every input bit affects every output bit
+    inline uint64_t MixBits64(uint64_t v)
+    {
+        v ^= v >> 33;
+        v *= 0xff51afd7ed558ccdULL;
+        v ^= v >> 33;
+        v *= 0xc4ceb9fe1a85ec53ULL;
+        v ^= v >> 33;
+        return v;
+    }
+
+    // cells are as large as the tolerance, so a match is always in one of the 27 cells around a point
+    // the full cell coordinates are hashed, vertices of cells that still collide are told apart by their distance
+    inline uint64_t WeldCellKey(int64_t x, int64_t y, int64_t z)
+    {
+        return MixBits64(static_cast<uint64_t>(x) + MixBits64(static_cast<uint64_t>(y) + MixBits64(static_cast<uint64_t>(z))));
+    }
+
+    // merges vertices closer than tolerance whose normals are within the crease angle
+    // normals of merged vertices are averaged, degenerate triangles are dropped
+    IfcGeometry WeldVertices(const IfcGeometry& geom, double tolerance, double creaseAngleRad)
+    {
+        if (geom.numPoints == 0 || tolerance <= 0)
+        {
+            return geom;
+        }
+
+        const double tol2 = tolerance * tolerance;
+        const double minNormalDot = std::cos(creaseAngleRad);
+
+        // first vertex in each cell, following vertices are chained through next
+        std::unordered_map<uint64_t, uint32_t> cells;
+        cells.reserve(geom.numPoints);
+        std::vector<uint32_t> next;
+        next.reserve(geom.numPoints);
+
+        std::vector<glm::dvec3> points;
+        std::vector<glm::dvec3> firstNormals;
+        std::vector<glm::dvec3> summedNormals;
+        std::vector<uint32_t> remap(geom.numPoints);
+
+        const uint32_t NONE = UINT32_MAX;
+
+        for (uint32_t i = 0; i < geom.numPoints; i++)
+        {
+            glm::dvec3 pt = geom.GetPoint(i);
+            glm::dvec3 n = geom.GetNormal(i);
+
+            int64_t cx = static_cast<int64_t>(std::floor(pt.x / tolerance));
+            int64_t cy = static_cast<int64_t>(std::floor(pt.y / tolerance));
+            int64_t cz = static_cast<int64_t>(std::floor(pt.z / tolerance));
+
+            uint32_t match = NONE;
+            for (int64_t dx = -1; dx <= 1 && match == NONE; dx++)
+            {
+                for (int64_t dy = -1; dy <= 1 && match == NONE; dy++)
+                {
+                    for (int64_t dz = -1; dz <= 1 && match == NONE; dz++)
+                    {
+                        auto cell = cells.find(WeldCellKey(cx + dx, cy + dy, cz + dz));
+                        if (cell == cells.end())
+                        {
+                            continue;
+                        }
+
+                        for (uint32_t v = cell->second; v != NONE; v = next[v])
+                        {
+                            glm::dvec3 d = points[v] - pt;
+                            if (glm::dot(d, d) <= tol2 && glm::dot(firstNormals[v], n) >= minNormalDot)
+                            {
+                                match = v;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (match != NONE)
+            {
+                summedNormals[match] += n;
+                remap[i] = match;
+                continue;
+            }
+
+            uint32_t index = points.size();
+            points.push_back(pt);
+            firstNormals.push_back(n);
+            summedNormals.push_back(n);
+
+            uint64_t key = WeldCellKey(cx, cy, cz);
+            auto cell = cells.find(key);
+            if (cell == cells.end())
+            {
+                cells[key] = index;
+                next.push_back(NONE);
+            }
+            else
+            {
+                next.push_back(cell->second);
+                cell->second = index;
+            }
+
+            remap[i] = index;
+        }
+
+        IfcGeometry result;
+        result.vertexData.reserve(points.size() * VERTEX_FORMAT_SIZE_FLOATS);
+        result.indexData.reserve(geom.indexData.size());
+
+        for (uint32_t i = 0; i < points.size(); i++)
+        {
+            glm::dvec3 n = summedNormals[i];
+            double len = glm::length(n);
+            n = len > EPS_MINISCULE ? n / len : firstNormals[i];
+
+            result.AddPoint(points[i], n);
+        }
+
+        for (uint32_t i = 0; i < geom.numFaces; i++)
+        {
+            Face f = geom.GetFace(i);
+            uint32_t a = remap[f.i0];
+            uint32_t b = remap[f.i1];
+            uint32_t c = remap[f.i2];
+
+            if (a == b || b == c || a == c)
+            {
+                continue;
+            }
+
+            result.AddFace(a, b, c);
+        }
+
+        return result;
+    }
+}
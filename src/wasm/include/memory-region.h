@@ -0,0 +1,247 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+#include <scoped_allocator>
+
+namespace webifc
+{
+	const size_t REGION_BLOCK_SIZE = 1 << 20;
+	const size_t REGION_ALIGNMENT = 16;
+
+	//! Memory owned by a single model, allocated in large blocks and returned all at once when the region is destroyed
+	//! Reset rewinds the region while keeping its blocks, for use as a scratch arena
+	class MemoryRegion
+	{
+	public:
+		MemoryRegion(size_t blockSize = REGION_BLOCK_SIZE) :
+			_blockSize(blockSize)
+		{
+
+		}
+
+		MemoryRegion(const MemoryRegion&) = delete;
+		MemoryRegion& operator=(const MemoryRegion&) = delete;
+
+		~MemoryRegion()
+		{
+			Release();
+		}
+
+		void* Allocate(size_t size, size_t alignment = REGION_ALIGNMENT)
+		{
+			size = AlignUp(size == 0 ? 1 : size, REGION_ALIGNMENT);
+
+			// reuse memory of the same size, growing containers tend to go through the same sizes
+			if (alignment <= REGION_ALIGNMENT)
+			{
+				auto it = _freeLists.find(size);
+				if (it != _freeLists.end() && it->second != nullptr)
+				{
+					void* ptr = it->second;
+					it->second = *static_cast<void**>(ptr);
+					return ptr;
+				}
+			}
+
+			uintptr_t ptr = AlignUp(reinterpret_cast<uintptr_t>(_current), alignment);
+			if (_current == nullptr || ptr + size > reinterpret_cast<uintptr_t>(_end))
+			{
+				size_t blockSize = size + alignment;
+				if (blockSize > _blockSize)
+				{
+					// too large to share a block, the current block stays in use
+					uint8_t* block = NewBlock(blockSize);
+					void* aligned = reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(block), alignment));
+					_largeBlocks.emplace(aligned, std::make_pair(block, blockSize));
+					return aligned;
+				}
+
+				// blocks kept by Reset are used before new ones
+				_blockIndex = _current == nullptr ? 0 : _blockIndex + 1;
+				if (_blockIndex == _blocks.size())
+				{
+					_blocks.push_back(NewBlock(_blockSize));
+				}
+
+				_current = _blocks[_blockIndex];
+				_end = _current + _blockSize;
+				ptr = AlignUp(reinterpret_cast<uintptr_t>(_current), alignment);
+			}
+
+			_current = reinterpret_cast<uint8_t*>(ptr + size);
+			return reinterpret_cast<void*>(ptr);
+		}
+
+		void Deallocate(void* ptr, size_t size, size_t alignment = REGION_ALIGNMENT)
+		{
+			if (ptr == nullptr)
+			{
+				return;
+			}
+
+			// large blocks go back right away, a growing container never asks for the size it outgrew again
+			auto large = _largeBlocks.find(ptr);
+			if (large != _largeBlocks.end())
+			{
+				std::free(large->second.first);
+				_reservedBytes -= large->second.second;
+				_largeBlocks.erase(large);
+				return;
+			}
+
+			if (alignment > REGION_ALIGNMENT)
+			{
+				return;
+			}
+
+			size = AlignUp(size == 0 ? 1 : size, REGION_ALIGNMENT);
+			void*& head = _freeLists[size];
+			*static_cast<void**>(ptr) = head;
+			head = ptr;
+		}
+
+		//! Everything allocated before is invalid afterwards
+		void Reset()
+		{
+			for (auto& list : _freeLists)
+			{
+				list.second = nullptr;
+			}
+
+			FreeLargeBlocks();
+
+			_blockIndex = 0;
+			_current = nullptr;
+			_end = nullptr;
+		}
+
+		void Release()
+		{
+			Reset();
+
+			for (auto block : _blocks)
+			{
+				std::free(block);
+			}
+
+			_blocks.clear();
+			_freeLists.clear();
+			_reservedBytes = 0;
+		}
+
+		size_t GetNumBlocks()
+		{
+			return _blocks.size() + _largeBlocks.size();
+		}
+
+		size_t GetReservedBytes()
+		{
+			return _reservedBytes;
+		}
+
+	private:
+		static size_t AlignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		uint8_t* NewBlock(size_t size)
+		{
+			uint8_t* block = static_cast<uint8_t*>(std::malloc(size));
+			if (block == nullptr)
+			{
+				printf("Out of memory allocating region block of %zu bytes\n", size);
+				std::abort();
+			}
+
+			_reservedBytes += size;
+			return block;
+		}
+
+		void FreeLargeBlocks()
+		{
+			for (auto& block : _largeBlocks)
+			{
+				std::free(block.second.first);
+				_reservedBytes -= block.second.second;
+			}
+
+			_largeBlocks.clear();
+		}
+
+		size_t _blockSize;
+		size_t _reservedBytes = 0;
+		size_t _blockIndex = 0;
+		uint8_t* _current = nullptr;
+		uint8_t* _end = nullptr;
+		std::vector<uint8_t*> _blocks;
+		// by the pointer handed out, with the block and its size
+		std::unordered_map<void*, std::pair<uint8_t*, size_t>> _largeBlocks;
+		std::unordered_map<size_t, void*> _freeLists;
+	};
+
+	template <typename T>
+	class RegionAllocator
+	{
+	public:
+		using value_type = T;
+
+		RegionAllocator(MemoryRegion& region) :
+			_region(&region)
+		{
+
+		}
+
+		template <typename U>
+		RegionAllocator(const RegionAllocator<U>& other) :
+			_region(other.GetRegion())
+		{
+
+		}
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(_region->Allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* ptr, size_t n)
+		{
+			_region->Deallocate(ptr, n * sizeof(T), alignof(T));
+		}
+
+		MemoryRegion* GetRegion() const
+		{
+			return _region;
+		}
+
+	private:
+		MemoryRegion* _region;
+	};
+
+	template <typename T, typename U>
+	bool operator==(const RegionAllocator<T>& a, const RegionAllocator<U>& b)
+	{
+		return a.GetRegion() == b.GetRegion();
+	}
+
+	template <typename T, typename U>
+	bool operator!=(const RegionAllocator<T>& a, const RegionAllocator<U>& b)
+	{
+		return a.GetRegion() != b.GetRegion();
+	}
+
+	template <typename T>
+	using RegionVector = std::vector<T, RegionAllocator<T>>;
+
+	// scoped so vectors created inside the map end up in the same region
+	template <typename K, typename V>
+	using RegionMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, std::scoped_allocator_adaptor<RegionAllocator<std::pair<const K, V>>>>;
+}
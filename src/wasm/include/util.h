@@ -9,6 +9,10 @@
 #include <vector>
 #include <array>
 #include <unordered_map>
+#include <functional>
+#include <memory>
+
+#include "memory-region.h"
 
 #include "../deps/glm/glm/glm.hpp"
 
@@ -108,6 +112,10 @@ namespace webifc
 		uint32_t numPoints = 0;
 		uint32_t numFaces = 0;
 
+		// with float storage only fvertexData is kept, positions are relative to origin
+		bool isFloatStorage = false;
+		glm::dvec3 origin = glm::dvec3(0);
+
 		inline void AddPoint(glm::dvec4& pt, glm::dvec3& n)
 		{
 			glm::dvec3 p = pt;
@@ -120,13 +128,27 @@ namespace webifc
 			//vertexData[numPoints * VERTEX_FORMAT_SIZE_FLOATS + 0] = pt.x;
 			//vertexData[numPoints * VERTEX_FORMAT_SIZE_FLOATS + 1] = pt.y;
 			//vertexData[numPoints * VERTEX_FORMAT_SIZE_FLOATS + 2] = pt.z;
-			vertexData.push_back(pt.x);
-			vertexData.push_back(pt.y);
-			vertexData.push_back(pt.z);
+			if (isFloatStorage)
+			{
+				// points added after ConvertToFloatStorage are relative to the same origin
+				fvertexData.push_back(static_cast<float>(pt.x - origin.x));
+				fvertexData.push_back(static_cast<float>(pt.y - origin.y));
+				fvertexData.push_back(static_cast<float>(pt.z - origin.z));
+
+				fvertexData.push_back(static_cast<float>(n.x));
+				fvertexData.push_back(static_cast<float>(n.y));
+				fvertexData.push_back(static_cast<float>(n.z));
+			}
+			else
+			{
+				vertexData.push_back(pt.x);
+				vertexData.push_back(pt.y);
+				vertexData.push_back(pt.z);
 
-			vertexData.push_back(n.x);
-			vertexData.push_back(n.y);
-			vertexData.push_back(n.z);
+				vertexData.push_back(n.x);
+				vertexData.push_back(n.y);
+				vertexData.push_back(n.z);
+			}
 
 			if (std::isnan(pt.x) || std::isnan(pt.y) || std::isnan(pt.z))
 			{
@@ -174,6 +196,25 @@ namespace webifc
 			numFaces++;
 		}
 
+		//! Appends the faces of another geometry, the vertex data is copied as is
+		void AddGeometry(const IfcGeometry& geom)
+		{
+			uint32_t offset = numPoints;
+
+			for (uint32_t i = 0; i < geom.numPoints; i++)
+			{
+				glm::dvec3 pt = geom.GetPoint(i);
+				glm::dvec3 n = geom.GetNormal(i);
+				AddPoint(pt, n);
+			}
+
+			for (uint32_t i = 0; i < geom.numFaces; i++)
+			{
+				Face f = geom.GetFace(i);
+				AddFace(f.i0 + offset, f.i1 + offset, f.i2 + offset);
+			}
+		}
+
 		inline Face GetFace(uint32_t index) const
 		{
 			Face f;
@@ -185,6 +226,15 @@ namespace webifc
 
 		inline glm::dvec3 GetPoint(uint32_t index) const
 		{
+			if (isFloatStorage)
+			{
+				return origin + glm::dvec3(
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 0],
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 1],
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 2]
+				);
+			}
+
 			return glm::dvec3(
 				vertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 0],
 				vertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 1],
@@ -192,10 +242,64 @@ namespace webifc
 			);
 		}
 
+		inline glm::dvec3 GetNormal(uint32_t index) const
+		{
+			if (isFloatStorage)
+			{
+				return glm::dvec3(
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 3],
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 4],
+					fvertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 5]
+				);
+			}
+
+			return glm::dvec3(
+				vertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 3],
+				vertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 4],
+				vertexData[index * VERTEX_FORMAT_SIZE_FLOATS + 5]
+			);
+		}
+
+		//! Moves the vertices to float storage relative to the center of the bounds, this frees the doubles
+		//! Geometry is generated in doubles and converted once it is stored, so only the geometry being generated is ever held in doubles
+		void ConvertToFloatStorage()
+		{
+			if (isFloatStorage || numPoints == 0)
+			{
+				return;
+			}
+
+			glm::dvec3 min = GetPoint(0);
+			glm::dvec3 max = min;
+			for (uint32_t i = 1; i < numPoints; i++)
+			{
+				glm::dvec3 pt = GetPoint(i);
+				min = glm::min(min, pt);
+				max = glm::max(max, pt);
+			}
+
+			origin = (min + max) * 0.5;
+
+			fvertexData.resize(vertexData.size());
+			for (size_t i = 0; i < vertexData.size(); i += 6)
+			{
+				fvertexData[i + 0] = vertexData[i + 0] - origin.x;
+				fvertexData[i + 1] = vertexData[i + 1] - origin.y;
+				fvertexData[i + 2] = vertexData[i + 2] - origin.z;
+
+				fvertexData[i + 3] = vertexData[i + 3];
+				fvertexData[i + 4] = vertexData[i + 4];
+				fvertexData[i + 5] = vertexData[i + 5];
+			}
+
+			std::vector<double>().swap(vertexData);
+			isFloatStorage = true;
+		}
+
 		uint32_t GetVertexData()
 		{
 			// unfortunately webgl can't do doubles
-			if (fvertexData.size() != vertexData.size())
+			if (!isFloatStorage && fvertexData.size() != vertexData.size())
 			{
 				fvertexData.resize(vertexData.size());
 				for (size_t i = 0; i < vertexData.size(); i += 6)
@@ -238,7 +342,7 @@ namespace webifc
 
 		bool IsEmpty()
 		{
-			return vertexData.empty();
+			return numPoints == 0;
 		}
 	};
 
@@ -534,12 +638,183 @@ namespace webifc
 		bool isConvex;
 	};
 
+	//! Parameters of an extruded area solid, enough to build its geometry again
+	struct IfcExtrusion
+	{
+		std::shared_ptr<const IfcProfile> profile;
+		glm::dvec3 dir;
+		double depth;
+	};
+
+	//! Flat record of an extrusion for PARAMETRIC_EXTRUSIONS: the direction, the depth, 1 if the caps are convex without holes so they can be fanned,
+	//! the number of curves, then the point count and the points of the outer curve followed by each hole
+	std::vector<double> GetExtrusionData(const IfcExtrusion& extrusion)
+	{
+		std::vector<double> data = { extrusion.dir.x, extrusion.dir.y, extrusion.dir.z, extrusion.depth };
+
+		// hollow profiles count as convex when their outline is
+		data.push_back(extrusion.profile->isConvex && extrusion.profile->holes.empty() ? 1 : 0);
+		data.push_back(extrusion.profile->holes.size() + 1);
+
+		auto addCurve = [&](const IfcCurve<2>& curve)
+		{
+			data.push_back(curve.points.size());
+			for (auto& pt : curve.points)
+			{
+				data.push_back(pt.x);
+				data.push_back(pt.y);
+			}
+		};
+
+		addCurve(extrusion.profile->curve);
+		for (auto& hole : extrusion.profile->holes)
+		{
+			addCurve(hole);
+		}
+
+		return data;
+	}
+
+	//! Reads a record of GetExtrusionData back, returns false if the record is cut short
+	bool ReadExtrusionData(const std::vector<double>& data, IfcExtrusion& extrusion)
+	{
+		if (data.size() < 6)
+		{
+			return false;
+		}
+
+		auto profile = std::make_shared<IfcProfile>();
+		extrusion.dir = glm::dvec3(data[0], data[1], data[2]);
+		extrusion.depth = data[3];
+
+		profile->isConvex = data[4] != 0;
+
+		size_t numCurves = data[5];
+		size_t offset = 6;
+		for (size_t i = 0; i < numCurves; i++)
+		{
+			if (offset >= data.size())
+			{
+				return false;
+			}
+
+			size_t numPoints = data[offset++];
+			if (offset + numPoints * 2 > data.size())
+			{
+				return false;
+			}
+
+			IfcCurve<2> curve;
+			for (size_t j = 0; j < numPoints; j++, offset += 2)
+			{
+				curve.points.emplace_back(data[offset], data[offset + 1]);
+			}
+
+			if (i == 0)
+			{
+				profile->curve = std::move(curve);
+			}
+			else
+			{
+				profile->holes.push_back(std::move(curve));
+			}
+		}
+
+		extrusion.profile = profile;
+		return true;
+	}
+
+	uint64_t HashCombine(uint64_t seed, uint64_t value)
+	{
+		return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 12) + (seed >> 4));
+	}
+
+	uint64_t HashDouble(uint64_t seed, double value)
+	{
+		// std::hash maps 0 and -0 to the same value
+		return HashCombine(seed, std::hash<double>{}(value));
+	}
+
+	uint64_t HashCurve(uint64_t seed, const IfcCurve<2>& curve)
+	{
+		seed = HashCombine(seed, curve.points.size());
+		for (auto& pt : curve.points)
+		{
+			seed = HashDouble(seed, pt.x);
+			seed = HashDouble(seed, pt.y);
+		}
+
+		return seed;
+	}
+
+	uint64_t HashProfile(const IfcProfile& profile)
+	{
+		uint64_t seed = HashCurve(0, profile.curve);
+		for (auto& hole : profile.holes)
+		{
+			seed = HashCurve(seed, hole);
+		}
+
+		return seed;
+	}
+
+	uint64_t HashGeometry(const IfcGeometry& geom)
+	{
+		uint64_t seed = HashCombine(geom.numPoints, geom.numFaces);
+		for (auto& v : geom.vertexData)
+		{
+			seed = HashDouble(seed, v);
+		}
+		if (geom.isFloatStorage)
+		{
+			// otherwise fvertexData is just a copy for upload
+			for (auto& v : geom.fvertexData)
+			{
+				seed = HashCombine(seed, std::hash<float>{}(v));
+			}
+		}
+		seed = HashDouble(HashDouble(HashDouble(seed, geom.origin.x), geom.origin.y), geom.origin.z);
+		for (auto& i : geom.indexData)
+		{
+			seed = HashCombine(seed, i);
+		}
+
+		return seed;
+	}
+
+	//! Exact comparison of what HashProfile, the direction and the depth hash
+	bool IsEqualExtrusion(const IfcExtrusion& a, const IfcExtrusion& b)
+	{
+		if (a.dir != b.dir || a.depth != b.depth || a.profile->curve.points != b.profile->curve.points || a.profile->holes.size() != b.profile->holes.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.profile->holes.size(); i++)
+		{
+			if (a.profile->holes[i].points != b.profile->holes[i].points)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool IsEqualGeometry(const IfcGeometry& a, const IfcGeometry& b)
+	{
+		return a.numPoints == b.numPoints && a.numFaces == b.numFaces && a.isFloatStorage == b.isFloatStorage && a.origin == b.origin &&
+			a.vertexData == b.vertexData && (!a.isFloatStorage || a.fvertexData == b.fvertexData) && a.indexData == b.indexData;
+	}
+
 	struct IfcPlacedGeometry
 	{
 		glm::dvec4 color;
 		glm::dmat4 transformation;
 		std::array<double, 16> flatTransformation;
 		uint32_t geometryExpressID;
+		// the geometry is an extrusion record, see GetExtrusionData
+		bool isParametric = false;
 
 		void SetFlatTransformation()
 		{
@@ -559,6 +834,11 @@ namespace webifc
 		uint32_t expressID;
 	};
 
+	struct IfcComposedMesh;
+
+	//! Composed meshes are immutable once built, so subtrees can be shared instead of copied
+	using IfcComposedMeshPtr = std::shared_ptr<const IfcComposedMesh>;
+
 	struct IfcComposedMesh
 	{
 		glm::dvec4 color;
@@ -566,49 +846,71 @@ namespace webifc
 		uint32_t expressID;
 		bool hasGeometry = false;
 		bool hasColor = false;
-		std::vector<IfcComposedMesh> children;
+		std::vector<IfcComposedMeshPtr> children;
 	};
 
-	void flattenRecursive(IfcComposedMesh& mesh, std::unordered_map<uint32_t, IfcGeometry>& geometryMap, IfcGeometry& geom, glm::dmat4 mat)
+	void AddTransformedGeometry(IfcGeometry& geom, const IfcGeometry& source, const glm::dmat4& mat)
 	{
-		glm::dmat4 newMat = mat * mesh.transformation;
+		bool transformationBreaksWinding = MatrixFlipsTriangles(mat);
 
-		bool transformationBreaksWinding = MatrixFlipsTriangles(newMat);
+		for (uint32_t i = 0; i < source.numFaces; i++)
+		{
+			Face f = source.GetFace(i);
+			glm::dvec3 a = mat * glm::dvec4(source.GetPoint(f.i0), 1);
+			glm::dvec3 b = mat * glm::dvec4(source.GetPoint(f.i1), 1);
+			glm::dvec3 c = mat * glm::dvec4(source.GetPoint(f.i2), 1);
+
+			if (transformationBreaksWinding)
+			{
+				geom.AddFace(b, a, c);
+			}
+			else
+			{
+				geom.AddFace(a, b, c);
+			}
+		}
+	}
+
+	//! Closed box with outward facing triangles, faces of a flat box are dropped as zero area
+	IfcGeometry GetBoxGeometry(const glm::dvec3& min, const glm::dvec3& max)
+	{
+		IfcGeometry geom;
+
+		glm::dvec3 p[8];
+		for (int i = 0; i < 8; i++)
+		{
+			p[i] = glm::dvec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+		}
+
+		// corners of each side, counter clockwise seen from outside
+		const int sides[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+		for (auto& side : sides)
+		{
+			geom.AddFace(p[side[0]], p[side[1]], p[side[2]]);
+			geom.AddFace(p[side[0]], p[side[2]], p[side[3]]);
+		}
+
+		return geom;
+	}
+
+	void flattenRecursive(const IfcComposedMesh& mesh, const std::unordered_map<uint32_t, IfcGeometry>& geometryMap, IfcGeometry& geom, glm::dmat4 mat)
+	{
+		glm::dmat4 newMat = mat * mesh.transformation;
 
 		auto geomIt = geometryMap.find(mesh.expressID);
 
 		if (geomIt != geometryMap.end())
 		{
-			auto meshGeom = geomIt->second;
-
-			if (meshGeom.numFaces)
-			{
-				for (uint32_t i = 0; i < meshGeom.numFaces; i++)
-				{
-					Face f = meshGeom.GetFace(i);
-					glm::dvec3 a = newMat * glm::dvec4(meshGeom.GetPoint(f.i0), 1);
-					glm::dvec3 b = newMat * glm::dvec4(meshGeom.GetPoint(f.i1), 1);
-					glm::dvec3 c = newMat * glm::dvec4(meshGeom.GetPoint(f.i2), 1);
-
-					if (transformationBreaksWinding)
-					{
-						geom.AddFace(b, a, c);
-					}
-					else
-					{
-						geom.AddFace(a, b, c);
-					}
-				}
-			}
+			AddTransformedGeometry(geom, geomIt->second, newMat);
 		}
 
 		for (auto& c : mesh.children)
 		{
-			flattenRecursive(c, geometryMap, geom, newMat);
+			flattenRecursive(*c, geometryMap, geom, newMat);
 		}
 	}
 
-	IfcGeometry flatten(IfcComposedMesh& mesh, std::unordered_map<uint32_t, IfcGeometry>& geometryMap, glm::dmat4 mat = glm::dmat4(1))
+	IfcGeometry flatten(const IfcComposedMesh& mesh, const std::unordered_map<uint32_t, IfcGeometry>& geometryMap, glm::dmat4 mat = glm::dmat4(1))
 	{
 		IfcGeometry geom;
 		flattenRecursive(mesh, geometryMap, geom, mat);
@@ -994,6 +1296,132 @@ namespace webifc
 		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) >= 0;
 	}
 
+	// corners of a loop, a closing point that repeats the first one is not a corner of its own
+	template<typename Points>
+	size_t GetLoopCornerCount(const Points& points)
+	{
+		size_t count = points.size();
+		if (count > 1 && points[0][0] == points[count - 1][0] && points[0][1] == points[count - 1][1])
+		{
+			count--;
+		}
+
+		return count;
+	}
+
+	template<typename Points>
+	double GetLoopTurn(const Points& points, size_t count, size_t i)
+	{
+		const auto& a = points[(i + count - 1) % count];
+		const auto& b = points[i];
+		const auto& c = points[(i + 1) % count];
+		return (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+	}
+
+	//! True if a 2D loop turns the same way at every corner and goes around once, in either winding
+	template<typename Points>
+	bool IsConvexLoop(const Points& points)
+	{
+		size_t count = GetLoopCornerCount(points);
+		if (count < 3)
+		{
+			return false;
+		}
+
+		int turn = 0;
+		int xFlips = 0;
+		int xDir = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			double cross = GetLoopTurn(points, count, i);
+			int sign = cross > 0 ? 1 : (cross < 0 ? -1 : 0);
+			if (sign != 0)
+			{
+				if (turn != 0 && sign != turn)
+				{
+					return false;
+				}
+				turn = sign;
+			}
+
+			// a loop that goes around more than once changes its x direction more than twice
+			double dx = points[(i + 1) % count][0] - points[i][0];
+			int dir = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+			if (dir != 0)
+			{
+				if (xDir != 0 && dir != xDir)
+				{
+					xFlips++;
+				}
+				xDir = dir;
+			}
+		}
+
+		return turn != 0 && xFlips <= 2;
+	}
+
+	//! Fans a convex 2D loop out from its first corner, triangles wind counter clockwise like the ones of earcut, so one can stand in for the other
+	template<typename Points>
+	void FanTriangulate(const Points& points, std::vector<uint32_t>& indices)
+	{
+		indices.clear();
+
+		size_t count = GetLoopCornerCount(points);
+		double area = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto& a = points[i];
+			const auto& b = points[(i + 1) % count];
+			area += a[0] * b[1] - b[0] * a[1];
+		}
+
+		for (uint32_t i = 1; i + 1 < count; i++)
+		{
+			const auto& a = points[0];
+			const auto& b = points[i];
+			const auto& c = points[i + 1];
+
+			// corners in line with the first one only add slivers
+			if ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) == 0)
+			{
+				continue;
+			}
+
+			indices.push_back(0);
+			indices.push_back(area > 0 ? i : i + 1);
+			indices.push_back(area > 0 ? i + 1 : i);
+		}
+	}
+
+	//! Splits a quad along the diagonal that stays inside it, so concave quads work too, triangles wind like FanTriangulate
+	template<typename Points>
+	void TriangulateQuad(const Points& points, std::vector<uint32_t>& indices)
+	{
+		indices.clear();
+
+		auto orient = [&](uint32_t a, uint32_t b, uint32_t c) {
+			return (points[b][0] - points[a][0]) * (points[c][1] - points[a][1]) - (points[b][1] - points[a][1]) * (points[c][0] - points[a][0]);
+		};
+
+		double area = orient(0, 1, 2) + orient(0, 2, 3);
+
+		// 0 -> 2 stays inside if 1 and 3 are on either side of it
+		bool firstDiagonal = orient(0, 2, 1) * orient(0, 2, 3) <= 0;
+		const uint32_t triangles[2][3] = { { 0, 1, firstDiagonal ? 2u : 3u }, { firstDiagonal ? 0u : 1u, 2, 3 } };
+
+		for (auto& t : triangles)
+		{
+			if (orient(t[0], t[1], t[2]) == 0)
+			{
+				continue;
+			}
+
+			indices.push_back(t[0]);
+			indices.push_back(area > 0 ? t[1] : t[2]);
+			indices.push_back(area > 0 ? t[2] : t[1]);
+		}
+	}
+
 	glm::dmat4 NormalizeIFC(
 		glm::dvec4(1, 0, 0, 0),
 		glm::dvec4(0, 0, -1, 0),
@@ -1106,7 +1534,7 @@ namespace webifc
 		return obj.str();
 	}
 
-	std::string ToObj(IfcComposedMesh& mesh, std::unordered_map<uint32_t, IfcGeometry>& geometryMap, size_t& offset, glm::dmat4 mat = glm::dmat4(1))
+	std::string ToObj(const IfcComposedMesh& mesh, std::unordered_map<uint32_t, IfcGeometry>& geometryMap, size_t& offset, glm::dmat4 mat = glm::dmat4(1))
 	{
 		std::string complete;
 
@@ -1116,9 +1544,9 @@ namespace webifc
 
 		complete += ToObj(geom, offset, trans);
 
-		for (auto c : mesh.children)
+		for (auto& c : mesh.children)
 		{
-			complete += ToObj(c, geometryMap, offset, trans);
+			complete += ToObj(*c, geometryMap, offset, trans);
 		}
 
 		return complete;
@@ -1130,20 +1558,21 @@ namespace webifc
         writeFile(filename, ToObj(geom, offset));
 	}
 
-	//! This is essentially a chunked tightly packed dynamic array
+	//! This is essentially a chunked tightly packed dynamic array, chunks are taken from the model's memory region
 	template<uint32_t N>
 	class DynamicTape
 	{
 	public:
-		DynamicTape()
+		DynamicTape(MemoryRegion& region) :
+			_region(region)
 		{
 			AddChunk();
 		}
 
 		inline void AddChunk()
 		{
-			chunks.emplace_back();
-			memset(chunks.back().data(), 0, N);
+			chunks.push_back(static_cast<uint8_t*>(_region.Allocate(N)));
+			memset(chunks.back(), 0, N);
 			sizes.push_back(0);
 			writePtr++;
 		}
@@ -1159,14 +1588,14 @@ namespace webifc
 		inline void push(char v)
 		{
 			CheckChunk(1);
-			chunks.back().data()[sizes[writePtr]] = v;
+			chunks.back()[sizes[writePtr]] = v;
 			sizes[writePtr] += 1;
 		}
 
 		inline void push(void* v, unsigned long long size)
 		{
 			CheckChunk(size);
-			memcpy(chunks.back().data() + sizes[writePtr], v, size);
+			memcpy(chunks.back() + sizes[writePtr], v, size);
 			sizes[writePtr] += size;
 		}
 
@@ -1194,8 +1623,7 @@ namespace webifc
 		template <typename T>
 		inline T Read()
 		{
-			std::array<uint8_t, N>& chunk = chunks[readChunkIndex];
-			uint8_t* valuePtr = &chunk[readPtr];
+			uint8_t* valuePtr = chunks[readChunkIndex] + readPtr;
 
 			//T v = *(T*)(valuePtr);
 			// make this memory access aligned for emscripten
@@ -1210,8 +1638,7 @@ namespace webifc
 
 		void* GetReadPtr()
 		{
-			std::array<uint8_t, N>& chunk = chunks[readChunkIndex];
-			uint8_t* valuePtr = &chunk[readPtr];
+			uint8_t* valuePtr = chunks[readChunkIndex] + readPtr;
 
 			return (void*)valuePtr;
 		}
@@ -1259,8 +1686,7 @@ namespace webifc
 			std::ofstream file("tape.bin");
 			for (int i = 0; i < chunks.size(); i++)
 			{
-				std::array<uint8_t, N>& ch = chunks[i];
-				file.write((char*)ch.data(), sizes[i]);
+				file.write((char*)chunks[i], sizes[i]);
 			}
 		}
 
@@ -1305,7 +1731,8 @@ namespace webifc
 		uint32_t readPtr = 0;
 		uint32_t readChunkIndex = 0;
 		uint32_t writePtr = -1;
-		std::vector<std::array<uint8_t, N>> chunks;
+		MemoryRegion& _region;
+		std::vector<uint8_t*> chunks;
 		std::vector<size_t> sizes;
 	};
 
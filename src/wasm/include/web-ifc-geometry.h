@@ -9,11 +9,13 @@
 #include <array>
 #include <deque>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <algorithm>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #include "../deps/glm/glm/glm.hpp"
 #include "../deps/glm/glm/gtx/transform.hpp"
@@ -21,6 +23,12 @@
 
 #include "math/intersect-mesh-mesh.h"
 #include "math/bool-mesh-mesh.h"
+#include "math/mesh-boolean.h"
+#include "math/clip-mesh-plane.h"
+#include "math/weld-vertices.h"
+#include "math/profile-holes.h"
+#include "math/indexed-brep.h"
+#include "bool-result-cache.h"
 
 
 #include "ifc2x4.h"
@@ -29,6 +37,11 @@
 
 const double EXTRUSION_DISTANCE_HALFSPACE_M = 50;
 
+// the fast bool retriangulation gets unreliable when a single triangle is crossed by too many voids
+const uint32_t FAST_BOOL_MAX_VOIDS_PER_CUTTER = 16;
+// upper bound for adaptive tessellation, in segments per full circle
+const int ADAPTIVE_MAX_CIRCLE_SEGMENTS = 256;
+
 const bool DEBUG_DUMP_SVG = false;
 
 struct GeometryStatistics
@@ -37,11 +50,53 @@ struct GeometryStatistics
 	uint32_t meshCacheMisses = 0;
 	uint32_t verticesCached = 0;
 	uint32_t totalVertices = 0;
+	uint32_t placementCacheHits = 0;
+	uint32_t placementCacheMisses = 0;
+	uint32_t profileCacheHits = 0;
+	uint32_t profileCacheMisses = 0;
+	uint32_t curveCacheHits = 0;
+	uint32_t curveCacheMisses = 0;
+	uint32_t instanceCacheHits = 0;
+	uint32_t instanceCacheMisses = 0;
+	uint32_t geometryDedupeHits = 0;
+	uint32_t extrusionDedupeHits = 0;
+	uint32_t culledVoids = 0;
+	uint32_t skippedVoids = 0;
+	uint32_t voidSubtractions = 0;
+	uint32_t coaxialOpenings = 0;
+	uint32_t halfSpaceClips = 0;
+	uint32_t boolCacheHits = 0;
+	uint32_t boolCacheMisses = 0;
 
 	double GetCacheRatio()
 	{
 		return static_cast<double>(meshCacheHits) / (meshCacheHits + meshCacheMisses);
 	}
+
+	double GetBoolCacheRatio()
+	{
+		return static_cast<double>(boolCacheHits) / (boolCacheHits + boolCacheMisses);
+	}
+
+	double GetPlacementCacheRatio()
+	{
+		return static_cast<double>(placementCacheHits) / (placementCacheHits + placementCacheMisses);
+	}
+
+	double GetProfileCacheRatio()
+	{
+		return static_cast<double>(profileCacheHits) / (profileCacheHits + profileCacheMisses);
+	}
+
+	double GetCurveCacheRatio()
+	{
+		return static_cast<double>(curveCacheHits) / (curveCacheHits + curveCacheMisses);
+	}
+
+	double GetInstanceCacheRatio()
+	{
+		return static_cast<double>(instanceCacheHits) / (instanceCacheHits + instanceCacheMisses);
+	}
 };
 
 namespace webifc
@@ -50,20 +105,125 @@ namespace webifc
 	{
 	public:
 		IfcGeometryLoader(IfcLoader& l) :
+			IfcGeometryLoader(l, l.GetSettings())
+		{
+			// the model's own loader creates the cache, other levels of detail and later revisions join it with ShareBoolResultCache
+			if (_settings.BOOL_RESULT_CACHE)
+			{
+				_boolResultCache = std::make_shared<BoolResultCache>(static_cast<size_t>(_settings.BOOL_RESULT_CACHE_MB * 1024 * 1024));
+			}
+		}
+
+		//! Geometry of the same model generated with other settings, such as another level of detail
+		IfcGeometryLoader(IfcLoader& l, const LoaderSettings& settings) :
+			_transformation(1),
 			_loader(l),
-			_transformation(1)
+			_settings(settings)
 		{
 
 		}
 
+		//! Uses the boolean results of another loader, of the same model or of another revision of it
+		//! The cache is kept until its last loader is closed and stays within the size it was created with
+		//! Keys hold the engine and its settings, so loaders with other settings find only their own results
+		void ShareBoolResultCache(const IfcGeometryLoader& other)
+		{
+			if (_settings.BOOL_RESULT_CACHE && other._boolResultCache)
+			{
+				_boolResultCache = other._boolResultCache;
+			}
+		}
+
+		//! Parametric extrusions are tessellated on the first request
 		IfcGeometry& GetCachedGeometry(uint32_t expressID)
 		{
+			ExpandParametricGeometry(expressID);
 			return _expressIDToGeometry[expressID];
 		}
 
+		bool IsParametricGeometry(uint32_t expressID)
+		{
+			return _parametricExtrusions.find(expressID) != _parametricExtrusions.end();
+		}
+
+		//! Record of a geometry sent as an extrusion with PARAMETRIC_EXTRUSIONS, empty for any other geometry
+		std::vector<double> GetParametricGeometry(uint32_t expressID)
+		{
+			auto it = _parametricExtrusions.find(expressID);
+			if (it == _parametricExtrusions.end())
+			{
+				return {};
+			}
+
+			return GetExtrusionData(it->second);
+		}
+
+		//! Reference mesh of an extrusion record, identical to the one generated without PARAMETRIC_EXTRUSIONS
+		IfcGeometry ExpandExtrusion(const IfcExtrusion& extrusion)
+		{
+			return Weld(ExtrudeSolid(*extrusion.profile, extrusion.dir, extrusion.depth));
+		}
+
 		void ClearCachedGeometry()
 		{
-			_expressIDToGeometry.clear();
+			if (_instancedGeometryIDs.empty() && _dedupedGeometryIDs.empty())
+			{
+				_expressIDToGeometry.clear();
+				_parametricExtrusions.clear();
+				return;
+			}
+
+			// geometry shared between elements is kept around
+			for (auto it = _expressIDToGeometry.begin(); it != _expressIDToGeometry.end();)
+			{
+				if (!IsSharedGeometry(it->first))
+				{
+					it = _expressIDToGeometry.erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
+
+			for (auto it = _parametricExtrusions.begin(); it != _parametricExtrusions.end();)
+			{
+				if (!IsSharedGeometry(it->first))
+				{
+					it = _parametricExtrusions.erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
+		}
+
+		bool IsSharedGeometry(uint32_t expressID)
+		{
+			return _instancedGeometryIDs.find(expressID) != _instancedGeometryIDs.end() || _dedupedGeometryIDs.find(expressID) != _dedupedGeometryIDs.end();
+		}
+
+		void ClearDeduplicatedGeometry()
+		{
+			_geometryHashToID.clear();
+			_extrusionKeyToGeometryID.clear();
+			_dedupedGeometryIDs.clear();
+		}
+
+		//! Representation maps are generated again on their next use, their current geometry goes with the next ClearCachedGeometry
+		void ClearInstancedGeometry()
+		{
+			_representationMapToMesh.clear();
+			_instancedGeometryIDs.clear();
+		}
+
+		//! Geometries produced once per representation map when GEOMETRY_INSTANCING is set, these stay cached until the model is closed or edited
+		std::vector<uint32_t> GetInstancedGeometryIDs()
+		{
+			std::vector<uint32_t> ids(_instancedGeometryIDs.begin(), _instancedGeometryIDs.end());
+			std::sort(ids.begin(), ids.end());
+			return ids;
 		}
 
 		bool HasCachedGeometry(uint32_t expressID)
@@ -71,10 +231,45 @@ namespace webifc
 			return _expressIDToGeometry.find(expressID) != _expressIDToGeometry.end();
 		}
 
+		void ClearCachedPlacements()
+		{
+			_expressIDToPlacement.clear();
+		}
+
+		//! Placements are resolved through points and directions, so rewriting any of these may change cached results
+		void InvalidateCachedPlacements(uint32_t ifcType)
+		{
+			switch (ifcType)
+			{
+			case ifc2x4::IFCLOCALPLACEMENT:
+			case ifc2x4::IFCAXIS2PLACEMENT3D:
+			case ifc2x4::IFCCARTESIANTRANSFORMATIONOPERATOR3D:
+			case ifc2x4::IFCCARTESIANTRANSFORMATIONOPERATOR3DNONUNIFORM:
+			case ifc2x4::IFCCARTESIANPOINT:
+			case ifc2x4::IFCDIRECTION:
+				ClearCachedPlacements();
+				break;
+			default:
+				break;
+			}
+		}
+
+		void ClearCachedProfiles()
+		{
+			_profileCache.clear();
+			_curveCache2D.clear();
+			_curveCache3D.clear();
+			_geometryIDToExtrusion.clear();
+		}
+
 		IfcGeometry GetFlattenedGeometry(uint32_t expressID)
 		{
 			auto mesh = GetMesh(expressID);
-            return flatten(mesh, _expressIDToGeometry, NormalizeIFC);
+			auto geom = Weld(Flatten(*mesh, NormalizeIFC));
+
+			// parametric extrusions expanded by Flatten
+			_scratch.Reset();
+			return geom;
 		}
 
 		void AddComposedMeshToFlatMesh(IfcFlatMesh& flatMesh, const IfcComposedMesh& composedMesh, const glm::dmat4& parentMatrix = glm::dmat4(1), const glm::dvec4& color = glm::dvec4(1, 1, 1, 1), bool hasColor = false)
@@ -93,10 +288,19 @@ namespace webifc
 			{
 				IfcPlacedGeometry geometry;
 
-				if (!isCoordinated && _loader.GetSettings().COORDINATE_TO_ORIGIN)
+				bool isParametric = IsParametricGeometry(composedMesh.expressID);
+
+				if (!isCoordinated && _settings.COORDINATE_TO_ORIGIN)
 				{
-					auto& geom = _expressIDToGeometry[composedMesh.expressID];
-					auto pt = geom.GetPoint(0);
+					glm::dvec3 pt;
+					if (isParametric)
+					{
+						pt = glm::dvec3(_parametricExtrusions[composedMesh.expressID].profile->curve.points[0], 0);
+					}
+					else
+					{
+						pt = _expressIDToGeometry[composedMesh.expressID].GetPoint(0);
+					}
 					auto transformedPt = newMatrix * glm::dvec4(pt, 1);
 					coordinationMatrix = glm::translate(-glm::dvec3(transformedPt));
 					isCoordinated = true;
@@ -104,15 +308,24 @@ namespace webifc
 
 				geometry.color = newParentColor;
 				geometry.transformation = coordinationMatrix * newMatrix;
+
+				// float vertices are relative to the geometry origin, parametric records are expanded in doubles and never have one
+				auto geomIt = isParametric ? _expressIDToGeometry.end() : _expressIDToGeometry.find(composedMesh.expressID);
+				if (geomIt != _expressIDToGeometry.end() && geomIt->second.isFloatStorage)
+				{
+					geometry.transformation = geometry.transformation * glm::translate(geomIt->second.origin);
+				}
+
 				geometry.SetFlatTransformation();
 				geometry.geometryExpressID = composedMesh.expressID;
+				geometry.isParametric = isParametric;
 
 				flatMesh.geometries.push_back(geometry);
 			}
 
 			for (auto& c : composedMesh.children)
 			{
-				AddComposedMeshToFlatMesh(flatMesh, c, newMatrix, newParentColor, newHasColor);
+				AddComposedMeshToFlatMesh(flatMesh, *c, newMatrix, newParentColor, newHasColor);
 			}
 		}
 
@@ -121,42 +334,76 @@ namespace webifc
 			IfcFlatMesh flatMesh;
 			flatMesh.expressID = expressID;
 
-			IfcComposedMesh composedMesh = GetMesh(expressID);
+			auto composedMesh = GetMesh(expressID);
 
 			glm::dmat4 mat = glm::scale(glm::dvec3(_loader.GetLinearScalingFactor()));
 
-			AddComposedMeshToFlatMesh(flatMesh, composedMesh, _transformation * NormalizeIFC * mat);
+			AddComposedMeshToFlatMesh(flatMesh, *composedMesh, _transformation * NormalizeIFC * mat);
 
 			return flatMesh;
 		}
 
-		IfcComposedMesh GetMesh(uint32_t expressID)
+		//! Temporaries in the scratch region are released when the outermost call returns, so they only live as long as one element
+		IfcComposedMeshPtr GetMesh(uint32_t expressID)
+		{
+			_meshDepth++;
+			auto mesh = GetMeshWithCache(expressID);
+			if (--_meshDepth == 0)
+			{
+				_scratch.Reset();
+			}
+
+			return mesh;
+		}
+
+		IfcComposedMeshPtr GetMeshWithCache(uint32_t expressID)
 		{
-			if (_loader.GetSettings().MESH_CACHE)
+			if (_settings.MESH_CACHE)
 			{
 				auto it = _expressIDToMesh.find(expressID);
 
 				if (it == _expressIDToMesh.end())
 				{
 					_statistics.meshCacheMisses++;
-					_expressIDToMesh[expressID] = GetMeshByLine(_loader.ExpressIDToLineID(expressID));
+					auto mesh = std::make_shared<const IfcComposedMesh>(GetMeshByLine(_loader.ExpressIDToLineID(expressID)));
+					_expressIDToMesh[expressID] = mesh;
+					return mesh;
 				}
 				else
 				{
 					_statistics.meshCacheHits++;
 				}
 
-				return _expressIDToMesh[expressID];
+				return it->second;
 			}
 			else
 			{
-				return GetMeshByLine(_loader.ExpressIDToLineID(expressID));
+				return std::make_shared<const IfcComposedMesh>(GetMeshByLine(_loader.ExpressIDToLineID(expressID)));
+			}
+		}
+
+		//! Profiles are shared between all extrusions that reference them, so the result is immutable
+		std::shared_ptr<const IfcProfile> GetProfile(uint32_t expressID)
+		{
+			uint64_t key = GetTessellationCacheKey(expressID);
+			auto it = _profileCache.find(key);
+			if (it != _profileCache.end())
+			{
+				_statistics.profileCacheHits++;
+				return it->second;
 			}
+
+			_statistics.profileCacheMisses++;
+
+			auto profile = std::make_shared<IfcProfile>(GetProfileByLine(_loader.ExpressIDToLineID(expressID)));
+			OrientProfile(*profile);
+
+			_profileCache[key] = profile;
+			return profile;
 		}
 
-		IfcProfile GetProfile(uint32_t expressID)
+		void OrientProfile(IfcProfile& profile)
 		{
-			auto profile = GetProfileByLine(_loader.ExpressIDToLineID(expressID));
 			if (!profile.curve.IsCCW())
 			{
 				profile.curve.Invert();
@@ -168,11 +415,9 @@ namespace webifc
 					hole.Invert();
 				}
 			}
-
-			return profile;
 		}
 
-		void DumpMesh(IfcComposedMesh& mesh, std::wstring filename)
+		void DumpMesh(const IfcComposedMesh& mesh, std::wstring filename)
 		{
 			size_t offset = 0;
             writeFile(filename, ToObj(mesh, _expressIDToGeometry, offset, NormalizeIFC));
@@ -183,14 +428,72 @@ namespace webifc
             _transformation = val;
         }
 
+        const glm::dmat4& GetTransformation()
+        {
+            return _transformation;
+        }
+
+		//! Loaders of the same model share the COORDINATE_TO_ORIGIN offset, whichever placed the first geometry sets it
+		void SyncCoordination(IfcGeometryLoader& other)
+		{
+			if (other.isCoordinated)
+			{
+				coordinationMatrix = other.coordinationMatrix;
+				isCoordinated = true;
+			}
+			else if (isCoordinated)
+			{
+				other.coordinationMatrix = coordinationMatrix;
+				other.isCoordinated = true;
+			}
+		}
+
 		template<uint32_t DIM>
-		IfcCurve<DIM> GetCurve(uint32_t expressID)
+		std::shared_ptr<const IfcCurve<DIM>> GetCurve(uint32_t expressID)
 		{
-			IfcCurve<DIM> curve;
-			ComputeCurve<DIM>(expressID, curve);
+			auto& cache = GetCurveCache<DIM>();
+			uint64_t key = GetTessellationCacheKey(expressID);
+			auto it = cache.find(key);
+			if (it != cache.end())
+			{
+				_statistics.curveCacheHits++;
+				return it->second;
+			}
+
+			_statistics.curveCacheMisses++;
+
+			auto curve = std::make_shared<IfcCurve<DIM>>();
+			ComputeCurve<DIM>(expressID, *curve);
+
+			cache[key] = curve;
 			return curve;
 		}
 
+		//! Number of points on an arc, with ADAPTIVE_TESSELLATION enough to keep every chord within the chord and angle tolerances
+		//! Otherwise the fixed count is used whatever the radius
+		int GetArcPointCount(double radius, double angleRad, int fixedCount)
+		{
+			auto& settings = _settings;
+			if (!settings.ADAPTIVE_TESSELLATION)
+			{
+				return fixedCount;
+			}
+
+			double arc = std::fabs(angleRad);
+			double chordTolerance = settings.CHORD_TOLERANCE_M / _loader.GetLinearScalingFactor();
+			double maxStep = std::min(settings.ANGLE_TOLERANCE_DEG / 180 * CONST_PI, CONST_PI * 2 / 3);
+			radius = std::fabs(radius);
+			if (chordTolerance > 0 && chordTolerance < radius)
+			{
+				// the sagitta of a chord spanning the step is the chord error
+				maxStep = std::min(maxStep, 2 * std::acos(1 - chordTolerance / radius));
+			}
+
+			double maxSegments = std::ceil(arc / (CONST_PI * 2) * ADAPTIVE_MAX_CIRCLE_SEGMENTS);
+			double segments = std::min(std::ceil(arc / maxStep), maxSegments);
+			return static_cast<int>(std::max(segments, 1.0)) + 1;
+		}
+
 		GeometryStatistics GetStatistics()
 		{
 			return _statistics;
@@ -200,6 +503,32 @@ namespace webifc
         glm::dmat4 _transformation;
 		GeometryStatistics _statistics;
 
+		// circles are tessellated while building profiles and curves, so the segment count or tolerances are part of the key
+		uint64_t GetTessellationCacheKey(uint32_t expressID)
+		{
+			auto& settings = _settings;
+			uint64_t tessellation = static_cast<uint64_t>(settings.CIRCLE_SEGMENTS_HIGH);
+			if (settings.ADAPTIVE_TESSELLATION)
+			{
+				tessellation = HashDouble(HashDouble(tessellation, settings.CHORD_TOLERANCE_M), settings.ANGLE_TOLERANCE_DEG);
+			}
+
+			return (tessellation << 32) | expressID;
+		}
+
+		template<uint32_t DIM>
+		std::unordered_map<uint64_t, std::shared_ptr<const IfcCurve<DIM>>>& GetCurveCache()
+		{
+			if constexpr (DIM == 2)
+			{
+				return _curveCache2D;
+			}
+			else
+			{
+				return _curveCache3D;
+			}
+		}
+
 		IfcComposedMesh GetMeshByLine(uint32_t lineID)
 		{
 			auto& line = _loader.GetLine(lineID);
@@ -215,7 +544,7 @@ namespace webifc
 			auto styledItem = styledItems.find(line.expressID);
 			if (styledItem != styledItems.end())
 			{
-				auto items = styledItem->second;
+				auto& items = styledItem->second;
 				for (auto item : items)
 				{
 					bool success = GetColor(item.second, styledItemColor);
@@ -294,60 +623,107 @@ namespace webifc
 					for (auto relAggExpressID : relAggIt->second)
 					{
 						// hacky fix to avoid double application of the parent matrix
-						auto aggMesh = GetMesh(relAggExpressID);
+						auto aggMesh = *GetMesh(relAggExpressID);
 						aggMesh.transformation *= glm::inverse(mesh.transformation);
-						mesh.children.push_back(aggMesh);
+						mesh.children.push_back(std::make_shared<IfcComposedMesh>(aggMesh));
 					}
 				}
 				*/
 
 				auto relVoidsIt = relVoids.find(line.expressID);
 
-				if (relVoidsIt != relVoids.end() && !relVoidsIt->second.empty())
+				// proxies only need the envelope, so openings are left out
+				if (relVoidsIt != relVoids.end() && !relVoidsIt->second.empty() && !_settings.GEOMETRY_PROXIES)
 				{
 					IfcComposedMesh resultMesh;
 					resultMesh.transformation = glm::dmat4(1);
 
-					auto flatElementMesh = flatten(mesh, _expressIDToGeometry);
-
-					if (!flatElementMesh.IsEmpty())
+					std::vector<IfcComposedMeshPtr> voidMeshes;
+					for (auto relVoidExpressID : relVoidsIt->second)
 					{
+						voidMeshes.push_back(GetMesh(relVoidExpressID));
+					}
 
-						// TODO: this is inefficient, better make one-to-many subtraction in bool logic
-						for (auto relVoidExpressID : relVoidsIt->second)
+					IfcGeometry flatElementMesh;
+					IfcExtrusion cut;
+					glm::dmat4 cutMatrix;
+					if (CutCoaxialOpenings(mesh, voidMeshes, cut, cutMatrix))
+					{
+						if (voidMeshes.empty())
 						{
-							IfcComposedMesh voidMesh = GetMesh(relVoidExpressID);
-							auto flatVoidMesh = flatten(voidMesh, _expressIDToGeometry);
+							// every opening became a hole in the profile, so the element is still an extrusion in its own frame
+							resultMesh.transformation = cutMatrix;
+							resultMesh.hasGeometry = true;
+							resultMesh.hasColor = true;
+							resultMesh.color = styledItemColor;
 
-							if (_loader.GetSettings().DUMP_CSG_MESHES)
+							if (_settings.PARAMETRIC_EXTRUSIONS)
 							{
-								DumpIfcGeometry(flatVoidMesh, L"void.obj");
-								DumpIfcGeometry(flatElementMesh, L"mesh.obj");
+								resultMesh.expressID = line.expressID;
+								_parametricExtrusions[line.expressID] = cut;
 							}
-
-							if (_loader.GetSettings().USE_FAST_BOOLS)
+							else
 							{
-								IfcGeometry r1;
-								IfcGeometry r2;
+								resultMesh.expressID = StoreGeometry(line.expressID, ExtrudeSolid(*cut.profile, cut.dir, cut.depth));
+							}
+
+							return resultMesh;
+						}
 
-								intersectMeshMesh(flatElementMesh, flatVoidMesh, r1, r2);
+						AddTransformedGeometry(flatElementMesh, ExtrudeSolid(*cut.profile, cut.dir, cut.depth), cutMatrix);
+					}
+					else
+					{
+						flatElementMesh = Flatten(mesh);
+					}
 
-								flatElementMesh = boolSubtract(r1, r2);
+					std::vector<IfcGeometry> voids;
+					if (!flatElementMesh.IsEmpty())
+					{
+						for (auto& voidMesh : voidMeshes)
+						{
+							IfcGeometry voidGeom = Flatten(*voidMesh);
+							if (voidGeom.numPoints > 0)
+							{
+								AABB box = GetAABB(voidGeom);
+								if (IsSmallVoid(box.min, box.max))
+								{
+									_statistics.skippedVoids++;
+									continue;
+								}
 							}
-							else
+
+							voids.push_back(std::move(voidGeom));
+						}
+					}
+
+					if (!voids.empty())
+					{
+						// openings repeat with their element type, so results are cached in the frame of the element
+						bool cacheBools = _boolResultCache != nullptr;
+						BoolResultKey key;
+						if (cacheBools)
+						{
+							glm::dmat4 toElement = glm::inverse(mesh.transformation);
+							key = HashGeometryInFrame(GetBoolResultKey(BoolOperation::DIFFERENCE), flatElementMesh, toElement);
+							for (auto& v : voids)
 							{
-								flatElementMesh = boolSubtract_CSGJSCPP(flatElementMesh, flatVoidMesh);
+								key = HashGeometryInFrame(key, v, toElement);
 							}
+						}
+
+						if (!cacheBools || !FindBoolResult(key, mesh.transformation, flatElementMesh))
+						{
+							flatElementMesh = BoolSubtract(std::move(flatElementMesh), voids);
 
-							if (_loader.GetSettings().DUMP_CSG_MESHES)
+							if (cacheBools)
 							{
-								DumpIfcGeometry(flatElementMesh, L"res.obj");
+								AddBoolResult(std::move(key), mesh.transformation, flatElementMesh);
 							}
 						}
 					}
 
-					_expressIDToGeometry[line.expressID] = flatElementMesh;
-					resultMesh.expressID = line.expressID;
+					resultMesh.expressID = StoreGeometry(line.expressID, std::move(flatElementMesh));
 					resultMesh.hasGeometry = true;
 					resultMesh.hasColor = true;
 					resultMesh.color = styledItemColor;
@@ -370,7 +746,14 @@ namespace webifc
 					uint32_t localPlacement = _loader.GetRefArgument();
 
 					mesh.transformation = GetLocalPlacement(localPlacement);
-					mesh.children.push_back(GetMesh(ifcPresentation));
+					if (_settings.GEOMETRY_INSTANCING)
+					{
+						mesh.children.push_back(GetInstancedMesh(ifcPresentation));
+					}
+					else
+					{
+						mesh.children.push_back(GetMesh(ifcPresentation));
+					}
 					
 					return mesh;
 				}
@@ -381,17 +764,15 @@ namespace webifc
 					uint32_t secondOperandID = _loader.GetRefArgument();
 
 					auto firstMesh = GetMesh(firstOperandID);
-					auto secondMesh = GetMesh(secondOperandID);
-
-					auto flatFirstMesh = flatten(firstMesh, _expressIDToGeometry);
-					auto flatSecondMesh = flatten(secondMesh, _expressIDToGeometry);
-
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					if (_settings.GEOMETRY_PROXIES)
 					{
-						DumpIfcGeometry(flatFirstMesh, L"mesh.obj");
-						DumpIfcGeometry(flatSecondMesh, L"void.obj");
+						// clipping only removes material, the first operand encloses the result
+						mesh.children.push_back(firstMesh);
+						return mesh;
 					}
 
+					auto flatFirstMesh = Flatten(*firstMesh);
+
 					if (flatFirstMesh.numFaces == 0)
 					{
 						// bail out because we will get strange meshes
@@ -401,14 +782,51 @@ namespace webifc
 
 					webifc::IfcGeometry resultMesh;
 
-                    if (_loader.GetSettings().USE_FAST_BOOLS)
+					if (ClipByHalfSpace(flatFirstMesh, secondOperandID, resultMesh))
+					{
+						mesh.expressID = StoreGeometry(line.expressID, std::move(resultMesh));
+						mesh.hasGeometry = true;
+
+						return mesh;
+					}
+
+					auto secondMesh = GetMesh(secondOperandID);
+					auto flatSecondMesh = Flatten(*secondMesh);
+
+					bool cacheBools = _boolResultCache != nullptr;
+					BoolResultKey key;
+					if (cacheBools)
+					{
+						glm::dmat4 toFirst = glm::inverse(firstMesh->transformation);
+						key = HashGeometryInFrame(HashGeometryInFrame(GetBoolResultKey(BoolOperation::DIFFERENCE), flatFirstMesh, toFirst), flatSecondMesh, toFirst);
+
+						if (FindBoolResult(key, firstMesh->transformation, resultMesh))
+						{
+							mesh.expressID = StoreGeometry(line.expressID, std::move(resultMesh));
+							mesh.hasGeometry = true;
+
+							return mesh;
+						}
+					}
+
+					if (_settings.DUMP_CSG_MESHES)
+					{
+						DumpIfcGeometry(flatFirstMesh, L"mesh.obj");
+						DumpIfcGeometry(flatSecondMesh, L"void.obj");
+					}
+
+					if (_settings.USE_NATIVE_BOOLS)
+					{
+						resultMesh = meshBoolean(flatFirstMesh, flatSecondMesh, BoolOperation::DIFFERENCE);
+					}
+					else if (_settings.USE_FAST_BOOLS)
 					{
 						IfcGeometry r1;
 						IfcGeometry r2;
 
 						intersectMeshMesh(flatFirstMesh, flatSecondMesh, r1, r2);
 
-						if (_loader.GetSettings().DUMP_CSG_MESHES)
+						if (_settings.DUMP_CSG_MESHES)
 						{
 							DumpIfcGeometry(r1, L"substep1.obj");
 							DumpIfcGeometry(r2, L"substep2.obj");
@@ -421,12 +839,17 @@ namespace webifc
 						resultMesh = boolSubtract_CSGJSCPP(flatFirstMesh, flatSecondMesh);
 					}
 
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					if (cacheBools)
+					{
+						AddBoolResult(std::move(key), firstMesh->transformation, resultMesh);
+					}
+
+					if (_settings.DUMP_CSG_MESHES)
 					{
 						DumpIfcGeometry(resultMesh, L"result.obj");
 					}
 
-					_expressIDToGeometry[line.expressID] = resultMesh;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(resultMesh));
 					mesh.hasGeometry = true;
 
 					return mesh;
@@ -438,7 +861,9 @@ namespace webifc
 					_loader.MoveToArgumentOffset(line, 0);
 					std::string op = _loader.GetStringArgument();
 
-					if (op != "DIFFERENCE")
+					// only the native engine does the other operations
+					bool nativeBools = _settings.USE_NATIVE_BOOLS;
+					if (op != "DIFFERENCE" && !(nativeBools && (op == "UNION" || op == "INTERSECTION")))
 					{
 						std::cout << "Unsupported boolean op " << op << " at " << line.expressID << std::endl;
 						return mesh;
@@ -448,17 +873,19 @@ namespace webifc
 					uint32_t secondOperandID = _loader.GetRefArgument();
 
 					auto firstMesh = GetMesh(firstOperandID);
-					auto secondMesh = GetMesh(secondOperandID);
-
-					auto flatFirstMesh = flatten(firstMesh, _expressIDToGeometry);
-					auto flatSecondMesh = flatten(secondMesh, _expressIDToGeometry);
-
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					if (_settings.GEOMETRY_PROXIES)
 					{
-						DumpIfcGeometry(flatFirstMesh, L"mesh.obj");
-						DumpIfcGeometry(flatSecondMesh, L"void.obj");
+						// the operands enclose the result, a union needs both
+						mesh.children.push_back(firstMesh);
+						if (op == "UNION")
+						{
+							mesh.children.push_back(GetMesh(secondOperandID));
+						}
+						return mesh;
 					}
 
+					auto flatFirstMesh = Flatten(*firstMesh);
+
 					if (flatFirstMesh.numFaces == 0)
 					{
 						// bail out because we will get strange meshes
@@ -466,34 +893,91 @@ namespace webifc
 						return mesh;
 					}
 
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					if (op == "DIFFERENCE")
 					{
-						DumpIfcGeometry(flatFirstMesh, L"substep1.obj");
-						DumpIfcGeometry(flatSecondMesh, L"substep2.obj");
-					}
+						webifc::IfcGeometry clippedMesh;
+						if (ClipByHalfSpace(flatFirstMesh, secondOperandID, clippedMesh))
+						{
+							mesh.expressID = StoreGeometry(line.expressID, std::move(clippedMesh));
+							mesh.hasGeometry = true;
 
-					webifc::IfcGeometry resultMesh;
-                    if (_loader.GetSettings().USE_FAST_BOOLS)
-					{
-						IfcGeometry r1;
-						IfcGeometry r2;
+							return mesh;
+						}
+					}
 
-						intersectMeshMesh(flatFirstMesh, flatSecondMesh, r1, r2);
+					auto secondMesh = GetMesh(secondOperandID);
+					auto flatSecondMesh = Flatten(*secondMesh);
 
-						resultMesh = boolSubtract(r1, r2);
+					if (_settings.DUMP_CSG_MESHES)
+					{
+						DumpIfcGeometry(flatFirstMesh, L"mesh.obj");
+						DumpIfcGeometry(flatSecondMesh, L"void.obj");
 					}
-					else
+
+					if (_settings.DUMP_CSG_MESHES)
 					{
-						resultMesh = boolSubtract_CSGJSCPP(flatFirstMesh, flatSecondMesh);
+						DumpIfcGeometry(flatFirstMesh, L"substep1.obj");
+						DumpIfcGeometry(flatSecondMesh, L"substep2.obj");
 					}
 
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					BoolOperation boolOp = BoolOperation::DIFFERENCE;
+					if (op == "UNION")
 					{
-						DumpIfcGeometry(resultMesh, L"result.obj");
+						boolOp = BoolOperation::UNION;
+					}
+					else if (op == "INTERSECTION")
+					{
+						boolOp = BoolOperation::INTERSECTION;
 					}
 
-					_expressIDToGeometry[line.expressID] = resultMesh;
-					mesh.hasGeometry = true;
+					webifc::IfcGeometry resultMesh;
+
+					bool cacheBools = _boolResultCache != nullptr;
+					BoolResultKey key;
+					if (cacheBools)
+					{
+						glm::dmat4 toFirst = glm::inverse(firstMesh->transformation);
+						key = HashGeometryInFrame(HashGeometryInFrame(GetBoolResultKey(boolOp), flatFirstMesh, toFirst), flatSecondMesh, toFirst);
+
+						if (FindBoolResult(key, firstMesh->transformation, resultMesh))
+						{
+							mesh.expressID = StoreGeometry(line.expressID, std::move(resultMesh));
+							mesh.hasGeometry = true;
+
+							return mesh;
+						}
+					}
+
+					if (nativeBools)
+					{
+						resultMesh = meshBoolean(flatFirstMesh, flatSecondMesh, boolOp);
+					}
+					else if (_settings.USE_FAST_BOOLS)
+					{
+						IfcGeometry r1;
+						IfcGeometry r2;
+
+						intersectMeshMesh(flatFirstMesh, flatSecondMesh, r1, r2);
+
+						resultMesh = boolSubtract(r1, r2);
+					}
+					else
+					{
+						resultMesh = boolSubtract_CSGJSCPP(flatFirstMesh, flatSecondMesh);
+					}
+
+					if (cacheBools)
+					{
+						AddBoolResult(std::move(key), firstMesh->transformation, resultMesh);
+					}
+
+					if (_settings.DUMP_CSG_MESHES)
+					{
+						DumpIfcGeometry(resultMesh, L"result.obj");
+					}
+
+					mesh.expressID = StoreGeometry(line.expressID, std::move(resultMesh));
+					mesh.hasGeometry = true;
 
 					return mesh;
 				}
@@ -536,7 +1020,7 @@ namespace webifc
 
 					mesh.transformation = surface.transformation;
 					// TODO: this is getting problematic.....
-					_expressIDToGeometry[line.expressID] = geom;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 
 					return mesh;
@@ -551,7 +1035,7 @@ namespace webifc
 
 					IfcSurface surface = GetSurface(surfaceID);
 					glm::dmat4 position = GetLocalPlacement(positionID);
-					webifc::IfcCurve<2> curve = GetCurve<2>(boundaryID);
+					webifc::IfcCurve<2> curve = *GetCurve<2>(boundaryID);
 
 					if (!curve.IsCCW())
 					{
@@ -589,13 +1073,13 @@ namespace webifc
 						}
 					}
 					
-					if (_loader.GetSettings().DUMP_CSG_MESHES)
+					if (_settings.DUMP_CSG_MESHES)
 					{
 						DumpIfcGeometry(geom, L"pbhs.obj");
 					}
 
 					// TODO: this is getting problematic.....
-					_expressIDToGeometry[line.expressID] = geom;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 					mesh.transformation = position;
 
@@ -621,12 +1105,11 @@ namespace webifc
 					for (auto& shell : shells)
 					{
 						uint32_t shellRef = _loader.GetRefArgument(shell);
-						IfcComposedMesh temp;
-						_expressIDToGeometry[shellRef] = GetBrep(shellRef);
-						temp.expressID = shellRef;
-						temp.hasGeometry = true;
-						temp.transformation = glm::dmat4(1);
-						mesh.children.push_back(temp);
+						auto temp = std::make_shared<IfcComposedMesh>();
+						temp->expressID = StoreGeometry(shellRef, GetBrep(shellRef));
+						temp->hasGeometry = true;
+						temp->transformation = glm::dmat4(1);
+						mesh.children.push_back(std::move(temp));
 					}
 
 					return mesh;
@@ -636,7 +1119,7 @@ namespace webifc
 					_loader.MoveToArgumentOffset(line, 0);
 					uint32_t ifcPresentation = _loader.GetRefArgument();
 
-					_expressIDToGeometry[line.expressID] = GetBrep(ifcPresentation);
+					mesh.expressID = StoreGeometry(line.expressID, GetBrep(ifcPresentation));
 					mesh.hasGeometry = true;
 
 					return mesh;
@@ -708,8 +1191,7 @@ namespace webifc
 						std::cout << "Unsupported IFCPOLYGONALFACESET with PnIndex!" << std::endl;
 					}
 
-					_expressIDToGeometry[line.expressID] = geom;
-					mesh.expressID = line.expressID;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 					
 					return mesh;
@@ -721,39 +1203,45 @@ namespace webifc
 					auto coordinatesRef = _loader.GetRefArgument();
 					auto points = ReadIfcCartesianPointList3D(coordinatesRef);
 
-					// second argument normals, ignored
+					std::vector<glm::dvec3> normals;
+					_loader.MoveToArgumentOffset(line, 1);
+					if (_loader.GetTokenType() == IfcTokenType::SET_BEGIN)
+					{
+						_loader.Reverse();
+						normals = Read2DArrayOfThreeDoubles();
+					}
+
 					// third argument closed, ignored
 
 					// indices
 					_loader.MoveToArgumentOffset(line, 3);
 					auto indices = Read2DArrayOfThreeIndices();
 
-					IfcGeometry geom;
-
-
+					// IFC4 has a NormalIndex per corner here, IFC4 ADD2 a PnIndex that CoordIndex refers to instead of the coordinates
+					std::vector<uint32_t> normalIndices;
+					std::vector<uint32_t> pnIndex;
 					_loader.MoveToArgumentOffset(line, 4);
 					if (_loader.GetTokenType() == IfcTokenType::SET_BEGIN)
 					{
+						bool nested = _loader.GetTokenType() == IfcTokenType::SET_BEGIN;
+						_loader.Reverse();
 						_loader.Reverse();
-						auto pnIndex = Read2DArrayOfThreeIndices();
 
-						// ignore
-						// std::cout << "Unsupported IFCTRIANGULATEDFACESET with PnIndex!" << std::endl;
+						if (nested)
+						{
+							normalIndices = Read2DArrayOfThreeIndices();
+						}
+						else
+						{
+							pnIndex = ReadArrayOfIndices();
+						}
 					}
 
-					for (int i = 0; i < indices.size(); i += 3)
-					{
-						int i1 = indices[i + 0] - 1;
-						int i2 = indices[i + 1] - 1;
-						int i3 = indices[i + 2] - 1;
-
-						geom.AddFace(points[i1], points[i2], points[i3]);
-					}
+					IfcGeometry geom = GetTriangulatedFaceSet(points, normals, indices, normalIndices, pnIndex);
 
 					// DumpIfcGeometry(geom, L"test.obj");
 
-					_expressIDToGeometry[line.expressID] = geom;
-					mesh.expressID = line.expressID;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 					
 					return mesh;
@@ -776,15 +1264,22 @@ namespace webifc
 					double startParam = 0; // = _loader.GetDoubleArgument();
 					double endParam = 0; // = _loader.GetDoubleArgument();
 
-					IfcCurve<3> directrix = GetCurve<3>(directrixRef);
+					auto directrix = GetCurve<3>(directrixRef);
+
+					if (_settings.GEOMETRY_PROXIES)
+					{
+						mesh.expressID = StoreGeometry(line.expressID, GetSweepBox(*directrix, radius));
+						mesh.hasGeometry = true;
+
+						return mesh;
+					}
 
 					IfcProfile profile;
-					profile.curve = GetCircleCurve(radius, _loader.GetSettings().CIRCLE_SEGMENTS_MEDIUM);
+					profile.curve = GetCircleCurve(radius, GetArcPointCount(radius, CONST_PI * 2, _settings.CIRCLE_SEGMENTS_MEDIUM));
 
-					IfcGeometry geom = Sweep(profile, directrix);
+					IfcGeometry geom = Sweep(profile, *directrix);
 
-					_expressIDToGeometry[line.expressID] = geom;
-					mesh.expressID = line.expressID;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 
 					return mesh;
@@ -799,25 +1294,46 @@ namespace webifc
 					uint32_t axis1PlacementID = _loader.GetRefArgument();
 					double angle = _loader.GetDoubleArgument();
 
-					IfcProfile profile = GetProfile(profileID);
+					auto profile = GetProfile(profileID);
 					glm::dmat4 placement = GetLocalPlacement(placementID);
 					glm::dvec3 pos;
 					glm::dvec3 axis;
 
 					GetAxis1Placement(axis1PlacementID, pos, axis);
 
-					IfcCurve<3> directrix = BuildArc(pos, axis, angle);
+					// the profile point farthest from the axis has the largest chord error
+					double sweepRadius = 0;
+					for (auto& pt : profile->curve.points)
+					{
+						glm::dvec3 d = glm::dvec3(pt, 0) - pos;
+						sweepRadius = std::max(sweepRadius, glm::length(d - axis * glm::dot(d, axis)));
+					}
+
+					IfcCurve<3> directrix = BuildArc(pos, axis, angle, GetArcPointCount(sweepRadius, angle, _settings.CIRCLE_SEGMENTS_MEDIUM));
+
+					IfcGeometry geom;
+					if (_settings.GEOMETRY_PROXIES)
+					{
+						double profileRadius = 0;
+						for (auto& pt : profile->curve.points)
+						{
+							profileRadius = std::max(profileRadius, glm::length(pt));
+						}
 
-					IfcGeometry geom = Sweep(profile, directrix);
+						geom = GetSweepBox(directrix, profileRadius);
+					}
+					else
+					{
+						geom = Sweep(*profile, directrix);
+					}
 
 					mesh.transformation = placement;
-					_expressIDToGeometry[line.expressID] = geom;
-					mesh.expressID = line.expressID;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
 
 					mesh.hasColor = hasColor;
 					mesh.color = styledItemColor;
-					_expressIDToMesh[line.expressID] = mesh;
+					_expressIDToMesh[line.expressID] = std::make_shared<const IfcComposedMesh>(mesh);
 					return mesh;
 				}
 				case ifc2x4::IFCEXTRUDEDAREASOLID:
@@ -828,8 +1344,8 @@ namespace webifc
 					uint32_t directionID = _loader.GetRefArgument();
 					double depth = _loader.GetDoubleArgument();
 
-					IfcProfile profile = GetProfile(profileID);
-					if (profile.curve.points.empty())
+					auto profile = GetProfile(profileID);
+					if (profile->curve.points.empty())
 					{
 						return mesh;
 					}
@@ -837,35 +1353,73 @@ namespace webifc
 					mesh.transformation = GetLocalPlacement(placementID);
 					glm::dvec3 dir = GetCartesianPoint3D(directionID);
 
-					double dirDot = glm::dot(dir, glm::dvec3(0, 0, 1));
-					bool flipWinding = dirDot < 0; // can't be perp according to spec
-
-					if (DEBUG_DUMP_SVG)
+					if (_settings.GEOMETRY_PROXIES)
 					{
-						DumpSVGCurve(profile.curve.points, L"IFCEXTRUDEDAREASOLID_curve.html");
+						// the bounds of the profile swept along the extrusion, the solid itself isn't needed
+						glm::dvec2 min;
+						glm::dvec2 max;
+						getCurveBounds(profile->curve, min, max);
+
+						glm::dvec3 offset = dir * depth;
+						glm::dvec3 boxMin = glm::min(glm::dvec3(min, 0), glm::dvec3(min, 0) + offset);
+						glm::dvec3 boxMax = glm::max(glm::dvec3(max, 0), glm::dvec3(max, 0) + offset);
+
+						mesh.expressID = StoreGeometry(line.expressID, GetBoxGeometry(boxMin, boxMax));
+						mesh.hasGeometry = true;
+
+						return mesh;
 					}
 
-					IfcGeometry geom = Extrude(profile, dir, depth);
+					if (_settings.PARAMETRIC_EXTRUSIONS)
+					{
+						// the client builds the solid, here it is only tessellated when an operation or GetGeometry needs it
+						mesh.expressID = line.expressID;
+						mesh.hasGeometry = true;
+						_geometryIDToExtrusion[mesh.expressID] = { profile, dir, depth };
+						_parametricExtrusions[mesh.expressID] = { profile, dir, depth };
 
-					if (flipWinding)
+						return mesh;
+					}
+
+					// identical profile, direction and depth give identical meshes, a hit is compared with the extrusion it came from
+					uint64_t extrusionKey = 0;
+					if (_settings.GEOMETRY_DEDUPLICATION)
 					{
-						for (uint32_t i = 0; i < geom.numFaces; i++)
+						extrusionKey = HashDouble(HashDouble(HashDouble(HashDouble(HashProfile(*profile), dir.x), dir.y), dir.z), depth);
+						auto it = _extrusionKeyToGeometryID.find(extrusionKey);
+						auto extrusionIt = it == _extrusionKeyToGeometryID.end() ? _geometryIDToExtrusion.end() : _geometryIDToExtrusion.find(it->second);
+						if (extrusionIt != _geometryIDToExtrusion.end() && HasCachedGeometry(it->second) && IsEqualExtrusion(extrusionIt->second, { profile, dir, depth }))
 						{
-							uint32_t temp = geom.indexData[i * 3 + 0];
-							temp = geom.indexData[i * 3 + 0];
-							geom.indexData[i * 3 + 0] = geom.indexData[i * 3 + 1];
-							geom.indexData[i * 3 + 1] = temp;
+							_statistics.extrusionDedupeHits++;
+							_dedupedGeometryIDs.insert(it->second);
+							mesh.expressID = it->second;
+							mesh.hasGeometry = true;
+							_geometryIDToExtrusion[mesh.expressID] = { profile, dir, depth };
+
+							return mesh;
 						}
 					}
 
+					if (DEBUG_DUMP_SVG)
+					{
+						DumpSVGCurve(profile->curve.points, L"IFCEXTRUDEDAREASOLID_curve.html");
+					}
+
+					IfcGeometry geom = ExtrudeSolid(*profile, dir, depth);
+
 					if (DEBUG_DUMP_SVG)
 					{
 						DumpIfcGeometry(geom, L"IFCEXTRUDEDAREASOLID_geom.obj");
 					}
 
-					_expressIDToGeometry[line.expressID] = geom;
-					mesh.expressID = line.expressID;
+					mesh.expressID = StoreGeometry(line.expressID, std::move(geom));
 					mesh.hasGeometry = true;
+					_geometryIDToExtrusion[mesh.expressID] = { profile, dir, depth };
+
+					if (_settings.GEOMETRY_DEDUPLICATION)
+					{
+						_extrusionKeyToGeometryID[extrusionKey] = mesh.expressID;
+					}
 					
 					return mesh;
 				}
@@ -879,7 +1433,27 @@ namespace webifc
 			return IfcComposedMesh();
 		}
 
-		IfcCurve<3> BuildArc(const glm::dvec3& pos, const glm::dvec3& axis, double angleRad)
+		//! Box of GEOMETRY_PROXIES around a profile swept along a directrix, the profile points are at most radius from it
+		//! apart from the mitred corners of sharp bends
+		IfcGeometry GetSweepBox(const IfcCurve<3>& directrix, double radius)
+		{
+			if (directrix.points.size() <= 1)
+			{
+				return IfcGeometry();
+			}
+
+			glm::dvec3 min = directrix.points[0];
+			glm::dvec3 max = directrix.points[0];
+			for (auto& pt : directrix.points)
+			{
+				min = glm::min(min, pt);
+				max = glm::max(max, pt);
+			}
+
+			return GetBoxGeometry(min - glm::dvec3(radius), max + glm::dvec3(radius));
+		}
+
+		IfcCurve<3> BuildArc(const glm::dvec3& pos, const glm::dvec3& axis, double angleRad, int numSegments)
 		{
 			IfcCurve<3> curve;
 
@@ -888,7 +1462,7 @@ namespace webifc
 			glm::dvec3 right = -pos;
 			glm::dvec3 up = glm::cross(axis, right);
 
-			auto curve2D = GetEllipseCurve(1, 1, _loader.GetSettings().CIRCLE_SEGMENTS_MEDIUM, glm::dmat3(1), 0, angleRad, true);
+			auto curve2D = GetEllipseCurve(1, 1, numSegments, glm::dmat3(1), 0, angleRad, true);
 
 			for (auto& pt2D : curve2D.points)
 			{
@@ -939,16 +1513,152 @@ namespace webifc
 			return result;
 		}
 
-		std::vector<glm::dvec3> ReadIfcCartesianPointList3D(uint32_t expressID)
+		std::vector<uint32_t> ReadArrayOfIndices()
 		{
-			auto lineID = _loader.ExpressIDToLineID(expressID);
-			auto& line = _loader.GetLine(lineID);
+			std::vector<uint32_t> result;
 
-			_loader.MoveToArgumentOffset(line, 0);
+			// read set begin
+			_loader.GetTokenType();
+
+			while (_loader.GetTokenType() != IfcTokenType::SET_END)
+			{
+				_loader.Reverse();
+				result.push_back(static_cast<uint32_t>(_loader.GetDoubleArgument()));
+			}
+
+			return result;
+		}
+
+		//! Indexed mesh of a triangulated face set, the coordinates are copied once and the normals of the file are kept
+		//! without normals, triangles share their corners unless they meet at a crease
+		IfcGeometry GetTriangulatedFaceSet(const std::vector<glm::dvec3>& points, const std::vector<glm::dvec3>& normals, const std::vector<uint32_t>& indices,
+			const std::vector<uint32_t>& normalIndices, const std::vector<uint32_t>& pnIndex)
+		{
+			// the vertices CoordIndex refers to, one based
+			uint32_t numVertices = pnIndex.empty() ? points.size() : pnIndex.size();
+			auto getPoint = [&](uint32_t vertex)
+			{
+				return pnIndex.empty() ? points[vertex - 1] : points[pnIndex[vertex - 1] - 1];
+			};
+
+			for (uint32_t pn : pnIndex)
+			{
+				if (pn == 0 || pn > points.size())
+				{
+					std::cout << "Bad PnIndex in triangulated face set" << std::endl;
+					return IfcGeometry();
+				}
+			}
+
+			auto isValidTriangle = [&](size_t i)
+			{
+				uint32_t a = indices[i + 0];
+				uint32_t b = indices[i + 1];
+				uint32_t c = indices[i + 2];
+				return a > 0 && b > 0 && c > 0 && a <= numVertices && b <= numVertices && c <= numVertices && a != b && b != c && c != a;
+			};
+
+			auto getNormal = [&](uint32_t index)
+			{
+				glm::dvec3 n = normals[index];
+				return n == glm::dvec3(0) ? n : glm::normalize(n);
+			};
+
+			IfcGeometry geom;
+
+			if (!normals.empty() && normalIndices.empty() && normals.size() >= numVertices)
+			{
+				// a normal per vertex, the vertices and indices pass through as they are
+				geom.vertexData.reserve(numVertices * VERTEX_FORMAT_SIZE_FLOATS);
+				geom.indexData.reserve(indices.size());
+				for (uint32_t vertex = 1; vertex <= numVertices; vertex++)
+				{
+					glm::dvec3 pt = getPoint(vertex);
+					glm::dvec3 n = getNormal(vertex - 1);
+					geom.AddPoint(pt, n);
+				}
+
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					if (isValidTriangle(i))
+					{
+						geom.AddFace(indices[i + 0] - 1, indices[i + 1] - 1, indices[i + 2] - 1);
+					}
+				}
+			}
+			else if (!normals.empty() && normalIndices.size() == indices.size())
+			{
+				// a vertex per pair of point and normal used by the corners
+				std::unordered_map<uint64_t, uint32_t> vertices;
+				geom.indexData.reserve(indices.size());
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					if (!isValidTriangle(i))
+					{
+						continue;
+					}
+
+					uint32_t corners[3];
+					bool validNormals = true;
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t normalIndex = normalIndices[i + k];
+						if (normalIndex == 0 || normalIndex > normals.size())
+						{
+							validNormals = false;
+							break;
+						}
+
+						uint64_t key = (static_cast<uint64_t>(indices[i + k]) << 32) | normalIndex;
+						auto it = vertices.find(key);
+						if (it == vertices.end())
+						{
+							glm::dvec3 pt = getPoint(indices[i + k]);
+							glm::dvec3 n = getNormal(normalIndex - 1);
+							it = vertices.emplace(key, geom.numPoints).first;
+							geom.AddPoint(pt, n);
+						}
+						corners[k] = it->second;
+					}
+
+					if (validNormals)
+					{
+						geom.AddFace(corners[0], corners[1], corners[2]);
+					}
+				}
+			}
+			else
+			{
+				IndexedBrep brep;
+				for (uint32_t vertex = 1; vertex <= numVertices; vertex++)
+				{
+					brep.AddPoint(getPoint(vertex));
+				}
+
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					if (isValidTriangle(i))
+					{
+						brep.StartFace();
+						brep.StartLoop();
+						brep.AddCorner(indices[i + 0] - 1);
+						brep.AddCorner(indices[i + 1] - 1);
+						brep.AddCorner(indices[i + 2] - 1);
+					}
+				}
+
+				geom = brep.Build(glm::cos(glm::radians(_settings.WELD_CREASE_ANGLE_DEG)));
+			}
+
+			return geom;
+		}
 
+		std::vector<glm::dvec3> Read2DArrayOfThreeDoubles()
+		{
 			std::vector<glm::dvec3> result;
 
-			IfcTokenType t = _loader.GetTokenType();
+			// read set begin
+			_loader.GetTokenType();
 
 			// while we have point set begin
 			while (_loader.GetTokenType() == IfcTokenType::SET_BEGIN)
@@ -966,6 +1676,15 @@ namespace webifc
 			return result;
 		}
 
+		std::vector<glm::dvec3> ReadIfcCartesianPointList3D(uint32_t expressID)
+		{
+			auto lineID = _loader.ExpressIDToLineID(expressID);
+			auto& line = _loader.GetLine(lineID);
+
+			_loader.MoveToArgumentOffset(line, 0);
+			return Read2DArrayOfThreeDoubles();
+		}
+
 		std::vector<glm::dvec2> ReadIfcCartesianPointList2D(uint32_t expressID)
 		{
 			// TODO: near-duplicate of 3D, can make template
@@ -1067,14 +1786,23 @@ namespace webifc
 				_loader.MoveToArgumentOffset(line, 0);
 				auto faces = _loader.GetSetArgument();
 
-				IfcGeometry geometry;
+				// faces share their points, each point is read once and gets one vertex per crease around it
+				IndexedBrep brep;
 				for (auto& faceToken : faces)
 				{
 					uint32_t faceID = _loader.GetRefArgument(faceToken);
-					AddFaceToGeometry(faceID, geometry);
+					AddFaceToBrep(faceID, brep);
+				}
+
+				if (_settings.GEOMETRY_PROXIES)
+				{
+					// the points give the box, the faces don't have to be triangulated
+					glm::dvec3 min;
+					glm::dvec3 max;
+					return brep.GetBounds(min, max) ? GetBoxGeometry(min, max) : IfcGeometry();
 				}
 
-				return geometry;
+				return brep.Build(glm::cos(glm::radians(_settings.WELD_CREASE_ANGLE_DEG)));
 			}
 			default:
 				std::cout << "Unexpected shell type: " << line.ifcType << " at " << expressID << std::endl;
@@ -1205,7 +1933,7 @@ namespace webifc
 			return false;
 		}
 
-		void AddFaceToGeometry(uint32_t expressID, IfcGeometry& geometry)
+		void AddFaceToBrep(uint32_t expressID, IndexedBrep& brep)
 		{
 			auto lineID = _loader.ExpressIDToLineID(expressID);
 			auto& line = _loader.GetLine(lineID);
@@ -1217,15 +1945,13 @@ namespace webifc
 				_loader.MoveToArgumentOffset(line, 0);
 				auto bounds = _loader.GetSetArgument();
 
-				std::vector<IfcBound3D> bounds3D(bounds.size());
-
-				for (int i = 0; i < bounds.size(); i++)
+				// TODO: assuming that outer bound is first!
+				brep.StartFace();
+				for (auto& boundToken : bounds)
 				{
-					uint32_t boundID = _loader.GetRefArgument(bounds[i]);
-					bounds3D[i] = GetBound(boundID);
+					uint32_t boundID = _loader.GetRefArgument(boundToken);
+					AddBoundToBrep(boundID, brep);
 				}
-
-				TriangulateBounds(geometry, bounds3D);
 				break;
 			}
 
@@ -1235,7 +1961,7 @@ namespace webifc
 			}
 		}
 
-		IfcBound3D GetBound(uint32_t expressID)
+		void AddBoundToBrep(uint32_t expressID, IndexedBrep& brep)
 		{
 			auto lineID = _loader.ExpressIDToLineID(expressID);
 			auto& line = _loader.GetLine(lineID);
@@ -1243,89 +1969,54 @@ namespace webifc
 			switch (line.ifcType)
 			{
 			case ifc2x4::IFCFACEOUTERBOUND:
-			{
-				_loader.MoveToArgumentOffset(line, 0);
-				uint32_t loop = _loader.GetRefArgument();
-				// IfcToken orientation = tokens[_loader.GetArgumentOffset(tokens, 1)];
-
-				IfcBound3D bound;
-				bound.curve = GetLoop(loop);
-				bound.orientation = true;
-				bound.type = IfcBoundType::OUTERBOUND;
-
-				return bound;
-			}
 			case ifc2x4::IFCFACEBOUND:
 			{
 				_loader.MoveToArgumentOffset(line, 0);
-				uint32_t loop = _loader.GetRefArgument();
-				// IfcToken orientation = tokens[_loader.GetArgumentOffset(tokens, 1)];
-
-				IfcBound3D bound;
-				bound.curve = GetLoop(loop);
-				bound.orientation = true;
-				bound.type = IfcBoundType::BOUND;
-
-				return bound;
-			}
-
-			default:
-				std::cout << "Unexpected bound type: " << line.ifcType << " at " << expressID << std::endl;
-				break;
-			}
-
-			return IfcBound3D();
-		}
+				uint32_t loopID = _loader.GetRefArgument();
 
-		IfcCurve3D GetLoop(uint32_t expressID)
-		{
-			auto lineID = _loader.ExpressIDToLineID(expressID);
-			auto& line = _loader.GetLine(lineID);
-
-			switch (line.ifcType)
-			{
-			case ifc2x4::IFCPOLYLOOP:
-			{
-				IfcCurve3D curve;
+				auto& loop = _loader.GetLine(_loader.ExpressIDToLineID(loopID));
+				if (loop.ifcType != ifc2x4::IFCPOLYLOOP)
+				{
+					std::cout << "Unexpected loop type: " << loop.ifcType << " at " << loopID << std::endl;
+					break;
+				}
 
-				_loader.MoveToArgumentOffset(line, 0);
+				_loader.MoveToArgumentOffset(loop, 0);
 				auto points = _loader.GetSetArgument();
 
-				curve.points.reserve(points.size());
-
+				brep.StartLoop();
 				uint32_t prevID = 0;
 				for (auto& token : points)
 				{
-					uint32_t pointId = _loader.GetRefArgument(token);
-					
+					uint32_t pointID = _loader.GetRefArgument(token);
+
 					// trim out consecutive equal points
-					if (pointId != prevID)
+					if (pointID != prevID)
 					{
-						curve.points.push_back(GetCartesianPoint3D(pointId));
+						int32_t index = brep.FindPoint(pointID);
+						if (index < 0)
+						{
+							index = brep.AddPoint(pointID, GetCartesianPoint3D(pointID));
+						}
+						brep.AddCorner(index);
 					}
 
-					prevID = pointId;
+					prevID = pointID;
 				}
-
-				return curve;
+				break;
 			}
 
 			default:
-				std::cout << "Unexpected loop type: " << line.ifcType << " at " << expressID << std::endl;
+				std::cout << "Unexpected bound type: " << line.ifcType << " at " << expressID << std::endl;
 				break;
 			}
-
-			IfcCurve3D curve;
-			return curve;
 		}
 
 		void TriangulateBounds(IfcGeometry& geometry, std::vector<IfcBound3D>& bounds)
 		{
 			if (bounds.size() == 1 && bounds[0].curve.points.size() == 3)
 			{
-				auto c = bounds[0].curve;
-
-				size_t offset = geometry.numPoints;
+				auto& c = bounds[0].curve;
 
 				geometry.AddFace(c.points[0], c.points[1], c.points[2]);
 			}
@@ -1334,7 +2025,7 @@ namespace webifc
 				// bound greater than 4 vertices or with holes, triangulate
 				// TODO: modify to use glm::dvec2 with custom accessors
 				using Point = std::array<double, 2>;
-				std::vector<std::vector<Point>> polygon;
+				RegionVector<RegionVector<Point>> polygon(_scratch);
 
 				uint32_t offset = geometry.numPoints;
 				
@@ -1351,11 +2042,12 @@ namespace webifc
 				glm::dvec3 n = glm::normalize(glm::cross(v12, v13));
 				v12 = glm::cross(v13, n);
 
-				std::vector<glm::dvec2> temp;
-
+				polygon.reserve(bounds.size());
 				for (auto& bound : bounds)
 				{
-					std::vector<Point> points;
+					polygon.emplace_back(_scratch);
+					auto& points = polygon.back();
+					points.reserve(bound.curve.points.size());
 					for (int i = 0; i < bound.curve.points.size(); i++)
 					{
 						glm::dvec3 pt = bound.curve.points[i];
@@ -1369,15 +2061,27 @@ namespace webifc
 							glm::dot(pt2, v13)
 						);
 
-						temp.push_back(proj);
 						points.push_back({ proj.x, proj.y });
 					}
-
-					polygon.push_back(points);
 				}
 
-
-				std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
+				// quads and convex faces without holes skip earcut, most BREP faces are one of those
+				bool simple = false;
+				if (polygon.size() == 1 && GetLoopCornerCount(polygon[0]) == 4)
+				{
+					TriangulateQuad(polygon[0], _fanIndices);
+					simple = true;
+				}
+				else if (polygon.size() == 1 && IsConvexLoop(polygon[0]))
+				{
+					FanTriangulate(polygon[0], _fanIndices);
+					simple = true;
+				}
+				else
+				{
+					_earcut(polygon);
+				}
+				auto& indices = simple ? _fanIndices : _earcut.indices;
 
 				for (int i = 0; i < indices.size(); i += 3)
 				{
@@ -1390,7 +2094,7 @@ namespace webifc
 			}
 		}
 
-		//! This implementation generates much more vertices than needed, and does not have smoothed normals
+		//! Sweeps the profile and its holes along the directrix, segments and profile edges share their vertices unless they meet at a crease
 		IfcGeometry Sweep(const IfcProfile& profile, const IfcCurve<3>& directrix, const glm::dvec3& initialDirectrixNormal = glm::dvec3(0))
 		{
 			IfcGeometry geom;
@@ -1403,58 +2107,124 @@ namespace webifc
 				return geom;
 			}
 
-			// compute curve for each part of the directrix
-			std::vector<IfcCurve<3>> curves;
+			double minNormalDot = glm::cos(glm::radians(_settings.WELD_CREASE_ANGLE_DEG));
 
-			for (int i = 0; i < dpts.size(); i++)
+			// the outer curve followed by the holes, closed loops don't repeat their first point
+			std::vector<glm::dvec2> profilePoints;
+			std::vector<uint32_t> loopStarts;
+			bool allLoopsClosed = true;
+			auto addLoop = [&](const IfcCurve<2>& curve)
 			{
-				IfcCurve<3> segmentForCurve;
-
-				glm::dvec3 planeNormal;
-				glm::dvec3 directrixSegmentNormal;
-				glm::dvec3 planeOrigin;
-
-				if (i == 0) // start
-				{
-					planeNormal = glm::normalize(dpts[1] - dpts[0]);
-					directrixSegmentNormal = planeNormal;
-					planeOrigin = dpts[0];
-				}
-				else if (i == dpts.size() - 1) // end
-				{
-					planeNormal = glm::normalize(dpts[i] - dpts[i - 1]);
-					directrixSegmentNormal = planeNormal;
-					planeOrigin = dpts[i];
-				}
-				else // middle
+				uint32_t start = profilePoints.size();
+				for (auto& pt : curve.points)
 				{
-					// possibly the directrix is bad
-					glm::dvec3 n1 = glm::normalize(dpts[i] - dpts[i - 1]);
-					glm::dvec3 n2 = glm::normalize(dpts[i + 1] - dpts[i]);
-					glm::dvec3 p = glm::normalize(glm::cross(n1, n2));
-
-					if (std::isnan(p.x))
+					if (profilePoints.size() == start || !equals2d(pt, profilePoints.back(), EPS_SMALL))
 					{
-						// TODO: sometimes outliers cause the perp to become NaN! 
-						// this is bad news, as it nans the points added to the final mesh
-						// also, it's hard to bail out now :/
-						// see curve.add() for more info on how this is currently "solved"
-						printf("NaN perp!\n");
+						profilePoints.push_back(pt);
 					}
-
-					glm::dvec3 u1 = glm::normalize(glm::cross(n1, p));
-					glm::dvec3 u2 = glm::normalize(glm::cross(n2, p));
-					glm::dvec3 au = glm::normalize(u1 + u2);
-					planeNormal = glm::normalize(glm::cross(au, p));
-					directrixSegmentNormal = n1; // n1 or n2 doesn't matter
-
-					planeOrigin = dpts[i];
 				}
 
-				if (curves.empty())
+				bool closed = false;
+				while (profilePoints.size() > start + 1 && equals2d(profilePoints.back(), profilePoints[start], EPS_SMALL))
 				{
-					// construct initial curve
-					glm::dvec3 left;
+					profilePoints.pop_back();
+					closed = true;
+				}
+
+				loopStarts.push_back(start);
+				allLoopsClosed = allLoopsClosed && closed && profilePoints.size() - start >= 3;
+			};
+
+			addLoop(profile.curve);
+			for (auto& hole : profile.holes)
+			{
+				addLoop(hole);
+			}
+			loopStarts.push_back(profilePoints.size());
+
+			// each profile point has a column of vertices along the sweep, two at profile corners so the sides stay flat there
+			uint32_t numProfilePoints = profilePoints.size();
+			std::vector<uint32_t> columnIn(numProfilePoints);
+			std::vector<uint32_t> columnOut(numProfilePoints);
+			std::vector<uint32_t> columnPoint;
+			for (size_t loop = 0; loop + 1 < loopStarts.size(); loop++)
+			{
+				uint32_t start = loopStarts[loop];
+				uint32_t end = loopStarts[loop + 1];
+				for (uint32_t i = start; i < end; i++)
+				{
+					bool hasIn = allLoopsClosed || i > start;
+					bool hasOut = allLoopsClosed || i + 1 < end;
+					uint32_t prev = i > start ? i - 1 : end - 1;
+					uint32_t next = i + 1 < end ? i + 1 : start;
+
+					bool smooth = hasIn && hasOut && glm::dot(glm::normalize(profilePoints[i] - profilePoints[prev]), glm::normalize(profilePoints[next] - profilePoints[i])) >= minNormalDot;
+
+					columnIn[i] = columnPoint.size();
+					columnPoint.push_back(i);
+					if (smooth)
+					{
+						columnOut[i] = columnIn[i];
+					}
+					else
+					{
+						columnOut[i] = columnPoint.size();
+						columnPoint.push_back(i);
+					}
+				}
+			}
+			uint32_t numColumns = columnPoint.size();
+
+			// the profile is carried along the directrix, each ring is the previous one projected onto the next mitre plane
+			std::vector<glm::dvec3> positions;
+			std::vector<uint32_t> ringIn(dpts.size());
+			std::vector<uint32_t> ringOut(dpts.size());
+			std::vector<glm::dvec3> ring(numProfilePoints);
+
+			for (int i = 0; i < dpts.size(); i++)
+			{
+				glm::dvec3 planeNormal;
+				glm::dvec3 directrixSegmentNormal;
+				glm::dvec3 planeOrigin = dpts[i];
+				bool crease = false;
+
+				if (i == 0) // start
+				{
+					planeNormal = glm::normalize(dpts[1] - dpts[0]);
+					directrixSegmentNormal = planeNormal;
+				}
+				else if (i == dpts.size() - 1) // end
+				{
+					planeNormal = glm::normalize(dpts[i] - dpts[i - 1]);
+					directrixSegmentNormal = planeNormal;
+				}
+				else // middle
+				{
+					glm::dvec3 n1 = glm::normalize(dpts[i] - dpts[i - 1]);
+					glm::dvec3 n2 = glm::normalize(dpts[i + 1] - dpts[i]);
+					directrixSegmentNormal = n1; // n1 or n2 doesn't matter
+					crease = glm::dot(n1, n2) < minNormalDot;
+
+					glm::dvec3 p = glm::cross(n1, n2);
+					if (glm::length(p) < EPS_TINY)
+					{
+						// the directrix goes straight on, the mitre plane is perpendicular to it
+						planeNormal = n1;
+					}
+					else
+					{
+						p = glm::normalize(p);
+						glm::dvec3 u1 = glm::normalize(glm::cross(n1, p));
+						glm::dvec3 u2 = glm::normalize(glm::cross(n2, p));
+						glm::dvec3 au = glm::normalize(u1 + u2);
+						planeNormal = glm::normalize(glm::cross(au, p));
+					}
+				}
+
+				if (i == 0)
+				{
+					// construct initial ring
+					glm::dvec3 left;
 					if (initialDirectrixNormal == glm::dvec3(0))
 					{
 						left = glm::cross(directrixSegmentNormal, glm::dvec3(directrixSegmentNormal.y, directrixSegmentNormal.x, directrixSegmentNormal.z));
@@ -1476,109 +2246,234 @@ namespace webifc
 					glm::dvec3 right = glm::normalize(glm::cross(directrixSegmentNormal, left));
 					left = glm::normalize(glm::cross(directrixSegmentNormal, right));
 
-					// project profile onto planeNormal, place on planeOrigin
-					// TODO: look at holes
-					auto& ppts = profile.curve.points;
-					for (auto& pt2D : ppts)
+					for (uint32_t j = 0; j < numProfilePoints; j++)
 					{
-						glm::dvec3 pt = pt2D.x * left + pt2D.y * right + planeOrigin;
-						glm::dvec3 proj = projectOntoPlane(planeOrigin, planeNormal, pt, directrixSegmentNormal);
-
-						segmentForCurve.Add(pt);
+						ring[j] = profilePoints[j].x * left + profilePoints[j].y * right + planeOrigin;
 					}
 				}
 				else
 				{
-					// project previous curve onto the normal
-					const IfcCurve<3>& prevCurve = curves.back();
-
-					auto& ppts = prevCurve.points;
-					for (auto& pt : ppts)
+					for (auto& pt : ring)
 					{
-						glm::dvec3 proj = projectOntoPlane(planeOrigin, planeNormal, pt, directrixSegmentNormal);
+						pt = projectOntoPlane(planeOrigin, planeNormal, pt, directrixSegmentNormal);
+					}
+				}
+
+				ringIn[i] = positions.size();
+				for (uint32_t c = 0; c < numColumns; c++)
+				{
+					positions.push_back(ring[columnPoint[c]]);
+				}
 
-						segmentForCurve.Add(proj);
+				ringOut[i] = ringIn[i];
+				if (crease)
+				{
+					// a second copy of the ring, so the segments on either side of the crease get their own normals
+					ringOut[i] = positions.size();
+					for (uint32_t c = 0; c < numColumns; c++)
+					{
+						positions.push_back(ring[columnPoint[c]]);
 					}
 				}
-				
-				curves.push_back(segmentForCurve);
 			}
 
-			// connect the curves
+			// vertex normals are the area weighted sum of the triangles around them
+			std::vector<glm::dvec3> normals(positions.size(), glm::dvec3(0));
+			auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c)
+			{
+				glm::dvec3 n;
+				if (!computeSafeNormal(positions[a], positions[b], positions[c], n))
+				{
+					// zero area triangle, for instance where a revolved profile touches the axis
+					return;
+				}
+
+				n = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+				normals[a] += n;
+				normals[b] += n;
+				normals[c] += n;
+				geom.AddFace(a, b, c);
+			};
+
+			// connect the rings
 			for (int i = 1; i < dpts.size(); i++)
 			{
-				const auto& c1 = curves[i - 1].points;
-				const auto& c2 = curves[i].points;
+				uint32_t bottom = ringOut[i - 1];
+				uint32_t top = ringIn[i];
+
+				for (size_t loop = 0; loop + 1 < loopStarts.size(); loop++)
+				{
+					uint32_t start = loopStarts[loop];
+					uint32_t end = loopStarts[loop + 1];
+					uint32_t edgeEnd = allLoopsClosed ? end : end - 1;
+					for (uint32_t j = start; j < edgeEnd; j++)
+					{
+						uint32_t next = j + 1 < end ? j + 1 : start;
+
+						uint32_t bl = bottom + columnOut[j];
+						uint32_t br = bottom + columnIn[next];
+
+						uint32_t tl = top + columnOut[j];
+						uint32_t tr = top + columnIn[next];
+
+						addTriangle(tl, br, bl);
+						addTriangle(tl, tr, br);
+					}
+				}
+			}
+
+			// closed profiles along open directrices get caps, wound like the sides so the solid stays consistent
+			if (allLoopsClosed && !equals(dpts.front(), dpts.back(), EPS_SMALL))
+			{
+				std::vector<uint32_t>* indices = &_fanIndices;
+				if (loopStarts.size() == 2 && IsConvexLoop(profilePoints))
+				{
+					FanTriangulate(profilePoints, _fanIndices);
+				}
+				else
+				{
+					using Point = std::array<double, 2>;
+					RegionVector<RegionVector<Point>> polygon(_scratch);
+					for (size_t loop = 0; loop + 1 < loopStarts.size(); loop++)
+					{
+						polygon.emplace_back(_scratch);
+						for (uint32_t j = loopStarts[loop]; j < loopStarts[loop + 1]; j++)
+						{
+							polygon.back().push_back({ profilePoints[j].x, profilePoints[j].y });
+						}
+					}
 
-				uint32_t capSize = c1.size();
-				for (int j = 1; j < capSize; j++)
+					_earcut(polygon);
+					indices = &_earcut.indices;
+				}
+
+				// the triangles are counter clockwise, the start cap follows the direction of the outer loop and the end cap goes against it
+				double area = 0;
+				for (uint32_t j = 0; j < loopStarts[1]; j++)
 				{
-					glm::dvec3 bl = c1[j - 1];
-					glm::dvec3 br = c1[j - 0];
+					auto& a = profilePoints[j];
+					auto& b = profilePoints[j + 1 < loopStarts[1] ? j + 1 : 0];
+					area += a.x * b.y - b.x * a.y;
+				}
+				bool outerCCW = area > 0;
 
-					glm::dvec3 tl = c2[j - 1];
-					glm::dvec3 tr = c2[j - 0];
+				for (int cap = 0; cap < 2; cap++)
+				{
+					uint32_t capStart = positions.size();
+					uint32_t ringStart = cap == 0 ? ringIn[0] : ringOut[dpts.size() - 1];
+					for (uint32_t j = 0; j < numProfilePoints; j++)
+					{
+						positions.push_back(positions[ringStart + columnIn[j]]);
+						normals.push_back(glm::dvec3(0));
+					}
 
-					geom.AddFace(tl, br, bl);
-					geom.AddFace(tl, tr, br);
+					bool keep = (cap == 0) == outerCCW;
+					for (size_t t = 0; t + 2 < indices->size(); t += 3)
+					{
+						uint32_t a = capStart + (*indices)[t + 0];
+						uint32_t b = capStart + (*indices)[t + 1];
+						uint32_t c = capStart + (*indices)[t + 2];
+						if (keep)
+						{
+							addTriangle(a, b, c);
+						}
+						else
+						{
+							addTriangle(a, c, b);
+						}
+					}
 				}
 			}
 
+			for (size_t i = 0; i < positions.size(); i++)
+			{
+				glm::dvec3 n = normals[i] == glm::dvec3(0) ? normals[i] : glm::normalize(normals[i]);
+				geom.AddPoint(positions[i], n);
+			}
+
 			//DumpSVGCurve(directrix.points, glm::dvec3(), L"directrix.html");
 			//DumpIfcGeometry(geom, L"sweep.obj");
 
 			return geom;
 		}
 
-		IfcGeometry Extrude(IfcProfile profile, glm::dvec3 dir, double distance, glm::dvec3 cuttingPlaneNormal = glm::dvec3(0), glm::dvec3 cuttingPlanePos = glm::dvec3(0))
+		//! Geometry of an extruded area solid
+		IfcGeometry ExtrudeSolid(const IfcProfile& profile, glm::dvec3 dir, double depth)
+		{
+			double dirDot = glm::dot(dir, glm::dvec3(0, 0, 1));
+			bool flipWinding = dirDot < 0; // can't be perp according to spec
+
+			IfcGeometry geom = Extrude(profile, dir, depth);
+
+			if (flipWinding)
+			{
+				for (uint32_t i = 0; i < geom.numFaces; i++)
+				{
+					uint32_t temp = geom.indexData[i * 3 + 0];
+					temp = geom.indexData[i * 3 + 0];
+					geom.indexData[i * 3 + 0] = geom.indexData[i * 3 + 1];
+					geom.indexData[i * 3 + 1] = temp;
+				}
+			}
+
+			return geom;
+		}
+
+		IfcGeometry Extrude(const IfcProfile& profile, glm::dvec3 dir, double distance, glm::dvec3 cuttingPlaneNormal = glm::dvec3(0), glm::dvec3 cuttingPlanePos = glm::dvec3(0))
 		{
 			IfcGeometry geom;
-			std::vector<bool> holesIndicesHash;
+
+			// the caps store the outer curve followed by each hole, the sides are built per ring
+			RegionVector<const IfcCurve<2>*> rings(_scratch);
+			rings.push_back(&profile.curve);
+			for (auto& hole : profile.holes)
+			{
+				rings.push_back(&hole);
+			}
 
 			// build the caps
 			{
+				// convex outlines, rectangles among them, are fanned out, only concave outlines and holes need earcut
+				bool convex = profile.isConvex && profile.holes.empty();
+
 				using Point = std::array<double, 2>;
-				int polygonCount = 1 + profile.holes.size(); //Main profile + holes
-				std::vector<std::vector<Point>> polygon(polygonCount);
+				RegionVector<RegionVector<Point>> polygon(_scratch); //Main profile + holes
+				polygon.reserve(convex ? 0 : rings.size());
 
 				glm::dvec3 normal = dir;
 
-				for (int i = 0; i < profile.curve.points.size(); i++)
-				{
-					glm::dvec2 pt = profile.curve.points[i];
-					glm::dvec4 et = glm::dvec4(glm::dvec3(pt, 0) + dir * distance, 1);
-
-					geom.AddPoint(et, normal);
-					polygon[0].push_back({ pt.x, pt.y });
-				}
-
-				for(int i = 0; i < profile.curve.points.size(); i++)
+				for (size_t i = 0; i < rings.size(); i++)
 				{
-					holesIndicesHash.push_back(false);
-				}
-
-				for (int i = 0; i < profile.holes.size(); i++)
-				{
-					IfcCurve<2> hole = profile.holes[i];
-					int pointCount = hole.points.size();
-
-					for (int j = 0; j < pointCount; j++)
+					if (!convex)
 					{
-						holesIndicesHash.push_back(j == 0);
+						polygon.emplace_back(_scratch);
+						polygon[i].reserve(rings[i]->points.size());
+					}
 
-						glm::dvec2 pt = hole.points[j];
+					for (auto& pt : rings[i]->points)
+					{
 						glm::dvec4 et = glm::dvec4(glm::dvec3(pt, 0) + dir * distance, 1);
 
-						profile.curve.Add(pt);
 						geom.AddPoint(et, normal);
-						polygon[i + 1].push_back({ pt.x, pt.y }); //Index 0 is main profile; see earcut reference
+						if (!convex)
+						{
+							polygon[i].push_back({ pt.x, pt.y }); //Index 0 is main profile; see earcut reference
+						}
 					}
 				}
 
-				std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
+				if (convex)
+				{
+					FanTriangulate(profile.curve.points, _fanIndices);
+				}
+				else
+				{
+					_earcut(polygon);
+				}
+				auto& indices = convex ? _fanIndices : _earcut.indices;
 
 				uint32_t offset = 0;
-				bool winding = GetWindingOfTriangle(geom.GetPoint(offset + indices[0]), geom.GetPoint(offset + indices[1]), geom.GetPoint(offset + indices[2]));
+				bool winding = indices.empty() || GetWindingOfTriangle(geom.GetPoint(offset + indices[0]), geom.GetPoint(offset + indices[1]), geom.GetPoint(offset + indices[2]));
 				bool flipWinding = !winding;
 
 				for (int i = 0; i < indices.size(); i += 3)
@@ -1597,32 +2492,34 @@ namespace webifc
 
 				normal = -dir;
 
-				for (int i = 0; i < profile.curve.points.size(); i++)
+				for (auto ring : rings)
 				{
-					glm::dvec2 pt = profile.curve.points[i];
-					glm::dvec4 et = glm::dvec4(glm::dvec3(pt, 0), 1);
-
-					if (cuttingPlaneNormal != glm::dvec3(0))
+					for (auto& pt : ring->points)
 					{
-						et = glm::dvec4(glm::dvec3(pt, 0), 1);
-						glm::dvec3 transDir = glm::dvec4(dir, 0);
+						glm::dvec4 et = glm::dvec4(glm::dvec3(pt, 0), 1);
 
-						// project {et} onto the plane, following the extrusion normal						
-						double ldotn = glm::dot(transDir, cuttingPlaneNormal);
-						if (ldotn == 0)
-						{
-							printf("0 direction in extrude\n");
-						}
-						else
+						if (cuttingPlaneNormal != glm::dvec3(0))
 						{
-							glm::dvec3 dpos = cuttingPlanePos - glm::dvec3(et);
-							double dist = glm::dot(dpos, cuttingPlaneNormal) / ldotn;
-							// we want to apply dist, even when negative
-							et = et + glm::dvec4(dist * transDir, 1);
+							et = glm::dvec4(glm::dvec3(pt, 0), 1);
+							glm::dvec3 transDir = glm::dvec4(dir, 0);
+
+							// project {et} onto the plane, following the extrusion normal						
+							double ldotn = glm::dot(transDir, cuttingPlaneNormal);
+							if (ldotn == 0)
+							{
+								printf("0 direction in extrude\n");
+							}
+							else
+							{
+								glm::dvec3 dpos = cuttingPlanePos - glm::dvec3(et);
+								double dist = glm::dot(dpos, cuttingPlaneNormal) / ldotn;
+								// we want to apply dist, even when negative
+								et = et + glm::dvec4(dist * transDir, 1);
+							}
 						}
-					}
 
-					geom.AddPoint(et, normal);
+						geom.AddPoint(et, normal);
+					}
 				}
 
 				for (int i = 0; i < indices.size(); i += 3)
@@ -1638,29 +2535,31 @@ namespace webifc
 				}
 			}
 
-			uint32_t capSize = profile.curve.points.size();
-			for (int i = 1; i < capSize; i++)
+			uint32_t capSize = geom.numPoints / 2;
+			uint32_t ringStart = 0;
+			for (auto ring : rings)
 			{
 				//https://github.com/tomvandig/web-ifc/issues/5
-				if (holesIndicesHash[i])
+				// rings are not connected to each other
+				uint32_t ringEnd = ringStart + ring->points.size();
+				for (uint32_t i = ringStart + 1; i < ringEnd; i++)
 				{
-					continue;
-				}
+					uint32_t bl = i - 1;
+					uint32_t br = i - 0;
 
-				uint32_t bl = i - 1;
-				uint32_t br = i - 0;
+					uint32_t tl = capSize + i - 1;
+					uint32_t tr = capSize + i - 0;
 
-				uint32_t tl = capSize + i - 1;
-				uint32_t tr = capSize + i - 0;
+					// this winding should be correct
+					geom.AddFace(geom.GetPoint(tl),
+						geom.GetPoint(br),
+						geom.GetPoint(bl));
 
-				// this winding should be correct
-				geom.AddFace(geom.GetPoint(tl),
-					geom.GetPoint(br),
-					geom.GetPoint(bl));
-
-				geom.AddFace(geom.GetPoint(tl),
-					geom.GetPoint(tr),
-					geom.GetPoint(br));
+					geom.AddFace(geom.GetPoint(tl),
+						geom.GetPoint(tr),
+						geom.GetPoint(br));
+				}
+				ringStart = ringEnd;
 			}
 
 			return geom;
@@ -1668,21 +2567,476 @@ namespace webifc
 
 		bool IsCurveConvex(IfcCurve<2>& curve)
 		{
-			for (int i = 2; i < curve.points.size(); i++)
+			return IsConvexLoop(curve.points);
+		}
+
+
+		IfcGeometry Weld(IfcGeometry&& geom)
+		{
+			if (!_settings.WELD_VERTICES)
+			{
+				return std::move(geom);
+			}
+
+			double tolerance = _settings.WELD_TOLERANCE_M / _loader.GetLinearScalingFactor();
+			return WeldVertices(geom, tolerance, glm::radians(_settings.WELD_CREASE_ANGLE_DEG));
+		}
+
+		//! Returns the ID the geometry ends up under, with GEOMETRY_DEDUPLICATION this is the first identical geometry seen
+		uint32_t StoreGeometry(uint32_t expressID, IfcGeometry&& geom)
+		{
+			// anything more detailed than a box is replaced by its bounds, in its own frame so the box follows the placement
+			if (_settings.GEOMETRY_PROXIES && geom.numFaces > 12)
+			{
+				AABB box = GetAABB(geom);
+				geom = GetBoxGeometry(box.min, box.max);
+			}
+
+			geom = Weld(std::move(geom));
+
+			if (_settings.FLOAT_VERTEX_STORAGE)
+			{
+				geom.ConvertToFloatStorage();
+			}
+
+			if (!_settings.GEOMETRY_DEDUPLICATION)
+			{
+				_expressIDToGeometry[expressID] = std::move(geom);
+				return expressID;
+			}
+
+			uint64_t hash = HashGeometry(geom);
+			auto it = _geometryHashToID.find(hash);
+			if (it == _geometryHashToID.end())
+			{
+				_geometryHashToID[hash] = expressID;
+				_expressIDToGeometry[expressID] = std::move(geom);
+				return expressID;
+			}
+
+			uint32_t canonicalID = it->second;
+			auto canonical = _expressIDToGeometry.find(canonicalID);
+			if (canonical == _expressIDToGeometry.end())
+			{
+				// canonical geometry was cleared after streaming, this copy takes its place
+				_expressIDToGeometry[canonicalID] = std::move(geom);
+			}
+			else if (!IsEqualGeometry(canonical->second, geom))
+			{
+				// hash collision
+				_expressIDToGeometry[expressID] = std::move(geom);
+				return expressID;
+			}
+
+			_statistics.geometryDedupeHits++;
+			_dedupedGeometryIDs.insert(canonicalID);
+			return canonicalID;
+		}
+
+		//! Openings whose bounds fit in a MIN_VOID_SIZE_M cube are left out, for coarse levels of detail
+		bool IsSmallVoid(const glm::dvec3& min, const glm::dvec3& max)
+		{
+			if (_settings.MIN_VOID_SIZE_M <= 0)
 			{
-				glm::dvec2 a = curve.points[i - 2];
-				glm::dvec2 b = curve.points[i - 1];
-				glm::dvec2 c = curve.points[i - 0];
+				return false;
+			}
+
+			glm::dvec3 size = max - min;
+			double minSize = _settings.MIN_VOID_SIZE_M / _loader.GetLinearScalingFactor();
+			return size.x < minSize && size.y < minSize && size.z < minSize;
+		}
+
+		//! Key of a boolean run by the current engine, the operands are added with HashGeometryInFrame
+		BoolResultKey GetBoolResultKey(BoolOperation op)
+		{
+			auto& settings = _settings;
+			int64_t engine = settings.USE_NATIVE_BOOLS ? 2 : (settings.USE_FAST_BOOLS ? 1 : 0);
+			BoolResultKey key;
+			key.Add(static_cast<int64_t>(op));
+			key.Add(engine);
+			// voids are subtracted in groups of this size, the grouping changes the result
+			key.Add(GetMaxVoidsPerCutter());
+			return key;
+		}
+
+		uint32_t GetMaxVoidsPerCutter()
+		{
+			bool fastBools = _settings.USE_FAST_BOOLS && !_settings.USE_NATIVE_BOOLS;
+			return fastBools ? FAST_BOOL_MAX_VOIDS_PER_CUTTER : UINT32_MAX;
+		}
 
-				if (!isConvexOrColinear(a, b, c))
+		//! Places a result cached in the frame of the first operand
+		bool FindBoolResult(const BoolResultKey& key, const glm::dmat4& frame, IfcGeometry& result)
+		{
+			auto cached = _boolResultCache->Find(key);
+			if (!cached)
+			{
+				_statistics.boolCacheMisses++;
+				return false;
+			}
+
+			_statistics.boolCacheHits++;
+			result = TransformGeometry(*cached, frame);
+			return true;
+		}
+
+		void AddBoolResult(BoolResultKey&& key, const glm::dmat4& frame, const IfcGeometry& result)
+		{
+			_boolResultCache->Add(std::move(key), TransformGeometry(result, glm::inverse(frame)));
+		}
+
+		//! Subtracts all voids at once, voids that don't touch the element are skipped
+		IfcGeometry BoolSubtract(IfcGeometry&& element, const std::vector<IfcGeometry>& voids)
+		{
+			auto cutters = makeCutters(element, voids, GetMaxVoidsPerCutter(), _statistics.culledVoids);
+
+			IfcGeometry result = std::move(element);
+			for (auto& cutter : cutters)
+			{
+				result = BoolSubtract(result, cutter);
+			}
+
+			return result;
+		}
+
+		IfcGeometry BoolSubtract(IfcGeometry& first, IfcGeometry& second)
+		{
+			_statistics.voidSubtractions++;
+
+			if (_settings.DUMP_CSG_MESHES)
+			{
+				DumpIfcGeometry(second, L"void.obj");
+				DumpIfcGeometry(first, L"mesh.obj");
+			}
+
+			IfcGeometry result;
+
+			if (_settings.USE_NATIVE_BOOLS)
+			{
+				result = meshBoolean(first, second, BoolOperation::DIFFERENCE);
+			}
+			else if (_settings.USE_FAST_BOOLS)
+			{
+				IfcGeometry r1;
+				IfcGeometry r2;
+
+				intersectMeshMesh(first, second, r1, r2);
+
+				result = boolSubtract(r1, r2);
+			}
+			else
+			{
+				result = boolSubtract_CSGJSCPP(first, second);
+			}
+
+			if (_settings.DUMP_CSG_MESHES)
+			{
+				DumpIfcGeometry(result, L"res.obj");
+			}
+
+			return result;
+		}
+
+		//! Subtracts a half space by cutting along its plane, without building a solid for it
+		//! Bounded half spaces only when their boundary contains everything the plane removes
+		bool ClipByHalfSpace(const IfcGeometry& mesh, uint32_t halfSpaceID, IfcGeometry& result)
+		{
+			uint32_t lineID = _loader.ExpressIDToLineID(halfSpaceID);
+			auto& line = _loader.GetLine(lineID);
+
+			if (line.ifcType != ifc2x4::IFCHALFSPACESOLID && line.ifcType != ifc2x4::IFCPOLYGONALBOUNDEDHALFSPACE)
+			{
+				return false;
+			}
+
+			_loader.MoveToArgumentOffset(line, 0);
+			uint32_t surfaceID = _loader.GetRefArgument();
+			std::string agreement = _loader.GetStringArgument();
+			uint32_t positionID = 0;
+			uint32_t boundaryID = 0;
+			if (line.ifcType == ifc2x4::IFCPOLYGONALBOUNDEDHALFSPACE)
+			{
+				positionID = _loader.GetRefArgument();
+				boundaryID = _loader.GetRefArgument();
+			}
+
+			IfcSurface surface = GetSurface(surfaceID);
+			glm::dvec3 planeNormal = glm::normalize(glm::dvec3(surface.transformation[2]));
+			glm::dvec3 planePos = surface.transformation[3];
+
+			IfcGeometry clipped;
+
+			if (line.ifcType == ifc2x4::IFCHALFSPACESOLID)
+			{
+				// with the agreement flag set the material is below the plane
+				if (agreement == "T")
+				{
+					planeNormal *= -1;
+				}
+
+				if (!clipMeshByPlane(mesh, planePos, planeNormal, clipped, _earcut))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				glm::dmat4 position = GetLocalPlacement(positionID);
+				webifc::IfcCurve<2> curve = *GetCurve<2>(boundaryID);
+
+				// same solid as the extrusion in IFCPOLYGONALBOUNDEDHALFSPACE, the plane is given in the boundary's placement
+				// and the prism goes up from it
+				glm::dvec3 extrusionDir = glm::normalize(glm::dvec3(position[2]));
+				planeNormal = glm::normalize(glm::dvec3(position * glm::dvec4(planeNormal, 0)));
+				planePos = position * glm::dvec4(planePos, 1);
+
+				double ldotn = glm::dot(extrusionDir, planeNormal);
+				if (ldotn == 0)
+				{
+					return false;
+				}
+
+				if (ldotn < 0)
+				{
+					planeNormal *= -1;
+				}
+
+				IfcGeometry removedFaces;
+				if (!clipMeshByPlane(mesh, planePos, planeNormal, clipped, _earcut, &removedFaces))
 				{
 					return false;
 				}
+
+				// the removed part lies inside the prism if its outer faces do, seen along the extrusion, as the
+				// cap is at the bottom of it
+				glm::dmat4 toBoundary = glm::inverse(position);
+				for (uint32_t i = 0; i < removedFaces.numFaces; i++)
+				{
+					Face f = removedFaces.GetFace(i);
+					glm::dvec2 a(toBoundary * glm::dvec4(removedFaces.GetPoint(f.i0), 1));
+					glm::dvec2 b(toBoundary * glm::dvec4(removedFaces.GetPoint(f.i1), 1));
+					glm::dvec2 c(toBoundary * glm::dvec4(removedFaces.GetPoint(f.i2), 1));
+					if (!isTriangleInsideCurve(a, b, c, curve))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (_settings.DUMP_CSG_MESHES)
+			{
+				DumpIfcGeometry(mesh, L"mesh.obj");
+				DumpIfcGeometry(clipped, L"clip.obj");
 			}
 
+			_statistics.halfSpaceClips++;
+			result = std::move(clipped);
 			return true;
 		}
 
+		void ExpandParametricGeometry(uint32_t expressID)
+		{
+			auto it = _parametricExtrusions.find(expressID);
+			if (it == _parametricExtrusions.end() || HasCachedGeometry(expressID))
+			{
+				return;
+			}
+
+			// kept in doubles with FLOAT_VERTEX_STORAGE too, placed meshes of the record carry no origin
+			_expressIDToGeometry[expressID] = ExpandExtrusion(it->second);
+		}
+
+		//! Flattens a composed mesh, tessellating the parametric extrusions in it first
+		IfcGeometry Flatten(const IfcComposedMesh& mesh, const glm::dmat4& mat = glm::dmat4(1))
+		{
+			if (!_parametricExtrusions.empty())
+			{
+				ExpandParametricGeometries(mesh);
+			}
+
+			return flatten(mesh, _expressIDToGeometry, mat);
+		}
+
+		void ExpandParametricGeometries(const IfcComposedMesh& mesh)
+		{
+			if (mesh.hasGeometry)
+			{
+				ExpandParametricGeometry(mesh.expressID);
+			}
+
+			for (auto& c : mesh.children)
+			{
+				ExpandParametricGeometries(*c);
+			}
+		}
+
+		//! Geometries of a composed mesh with their placement, in the order flatten visits them
+		void CollectGeometries(const IfcComposedMesh& mesh, const glm::dmat4& parentMatrix, std::vector<std::pair<uint32_t, glm::dmat4>>& geometries)
+		{
+			glm::dmat4 matrix = parentMatrix * mesh.transformation;
+
+			if (_expressIDToGeometry.count(mesh.expressID) || IsParametricGeometry(mesh.expressID))
+			{
+				geometries.emplace_back(mesh.expressID, matrix);
+			}
+
+			for (auto& c : mesh.children)
+			{
+				CollectGeometries(*c, matrix, geometries);
+			}
+		}
+
+		bool GetSingleExtrusion(const IfcComposedMesh& mesh, IfcExtrusion& extrusion, glm::dmat4& matrix)
+		{
+			std::vector<std::pair<uint32_t, glm::dmat4>> geometries;
+			CollectGeometries(mesh, glm::dmat4(1), geometries);
+
+			if (geometries.size() != 1)
+			{
+				return false;
+			}
+
+			auto it = _geometryIDToExtrusion.find(geometries[0].first);
+			if (it == _geometryIDToExtrusion.end())
+			{
+				return false;
+			}
+
+			extrusion = it->second;
+			matrix = geometries[0].second;
+			return true;
+		}
+
+		//! Openings extruded along the extrusion of the element and through all of it become holes in its profile
+		//! these are removed from voidMeshes, as are small ones that IsSmallVoid leaves out, returns false if none could be cut this way
+		//! the result is the extrusion with these holes, placed by resultMatrix
+		bool CutCoaxialOpenings(const IfcComposedMesh& element, std::vector<IfcComposedMeshPtr>& voidMeshes, IfcExtrusion& result, glm::dmat4& resultMatrix)
+		{
+			IfcExtrusion elementExtrusion;
+			glm::dmat4 elementMatrix;
+			if (!GetSingleExtrusion(element, elementExtrusion, elementMatrix))
+			{
+				return false;
+			}
+
+			glm::dvec3 extrusion = elementExtrusion.dir * elementExtrusion.depth;
+			if (std::fabs(extrusion.z) < EPS_SMALL)
+			{
+				return false;
+			}
+
+			double elementMinZ = std::min(0.0, extrusion.z);
+			double elementMaxZ = std::max(0.0, extrusion.z);
+			glm::dmat4 toElement = glm::inverse(elementMatrix);
+
+			IfcProfile profile = *elementExtrusion.profile;
+			std::vector<IfcComposedMeshPtr> remaining;
+
+			for (auto& voidMesh : voidMeshes)
+			{
+				IfcExtrusion voidExtrusion;
+				glm::dmat4 voidMatrix;
+				if (!GetSingleExtrusion(*voidMesh, voidExtrusion, voidMatrix) || !voidExtrusion.profile->holes.empty())
+				{
+					remaining.push_back(voidMesh);
+					continue;
+				}
+
+				// the opening in the frame of the element profile
+				glm::dmat4 voidToElement = toElement * voidMatrix;
+				glm::dvec3 voidExtrusionDir = glm::dmat3(voidToElement) * (voidExtrusion.dir * voidExtrusion.depth);
+
+				glm::dvec3 cross = glm::cross(glm::normalize(voidExtrusionDir), glm::normalize(extrusion));
+				if (glm::length(cross) > EPS_SMALL)
+				{
+					remaining.push_back(voidMesh);
+					continue;
+				}
+
+				// project the opening profile along the extrusion onto the element profile plane
+				// the opening must reach through the element for every point of its profile
+				IfcCurve<2> hole;
+				bool throughElement = true;
+				glm::dvec3 voidMin(DBL_MAX);
+				glm::dvec3 voidMax(-DBL_MAX);
+				glm::dvec3 worldExtrusion = glm::dmat3(voidMatrix) * (voidExtrusion.dir * voidExtrusion.depth);
+				for (auto& pt : voidExtrusion.profile->curve.points)
+				{
+					glm::dvec3 p = voidToElement * glm::dvec4(pt, 0, 1);
+					double minZ = std::min(p.z, p.z + voidExtrusionDir.z);
+					double maxZ = std::max(p.z, p.z + voidExtrusionDir.z);
+					if (minZ > elementMinZ + EPS_SMALL || maxZ < elementMaxZ - EPS_SMALL)
+					{
+						throughElement = false;
+						break;
+					}
+
+					glm::dvec3 projected = p - extrusion * (p.z / extrusion.z);
+					hole.Add(glm::dvec2(projected));
+
+					// the bounds of the opening as Flatten places it
+					glm::dvec3 world = voidMatrix * glm::dvec4(pt, 0, 1);
+					voidMin = glm::min(voidMin, glm::min(world, world + worldExtrusion));
+					voidMax = glm::max(voidMax, glm::max(world, world + worldExtrusion));
+				}
+
+				if (throughElement && IsSmallVoid(voidMin, voidMax))
+				{
+					_statistics.skippedVoids++;
+					continue;
+				}
+
+				if (!throughElement || !addProfileHole(profile, std::move(hole)))
+				{
+					remaining.push_back(voidMesh);
+					continue;
+				}
+
+				_statistics.coaxialOpenings++;
+			}
+
+			if (remaining.size() == voidMeshes.size())
+			{
+				return false;
+			}
+
+			result = { std::make_shared<const IfcProfile>(std::move(profile)), elementExtrusion.dir, elementExtrusion.depth };
+			resultMatrix = elementMatrix;
+
+			voidMeshes = std::move(remaining);
+			return true;
+		}
+
+		IfcComposedMeshPtr GetInstancedMesh(uint32_t representationMapID)
+		{
+			auto it = _representationMapToMesh.find(representationMapID);
+			if (it != _representationMapToMesh.end())
+			{
+				_statistics.instanceCacheHits++;
+				return it->second;
+			}
+
+			_statistics.instanceCacheMisses++;
+
+			auto mesh = GetMesh(representationMapID);
+			AddInstancedGeometryIDs(*mesh);
+			_representationMapToMesh[representationMapID] = mesh;
+
+			return mesh;
+		}
+
+		void AddInstancedGeometryIDs(const IfcComposedMesh& mesh)
+		{
+			if (mesh.hasGeometry)
+			{
+				_instancedGeometryIDs.insert(mesh.expressID);
+			}
+
+			for (auto& c : mesh.children)
+			{
+				AddInstancedGeometryIDs(*c);
+			}
+		}
 
 		IfcProfile GetProfileByLine(uint32_t lineID)
 		{
@@ -1696,7 +3050,7 @@ namespace webifc
 				_loader.MoveToArgumentOffset(line, 0);
 				profile.type = _loader.GetStringArgument();
 				_loader.MoveToArgumentOffset(line, 2);
-				profile.curve = GetCurve<2>(_loader.GetRefArgument());
+				profile.curve = *GetCurve<2>(_loader.GetRefArgument());
 				profile.isConvex = IsCurveConvex(profile.curve);
 
 				return profile;
@@ -1708,7 +3062,7 @@ namespace webifc
 				_loader.MoveToArgumentOffset(line, 0);
 				profile.type = _loader.GetStringArgument();
 				_loader.MoveToArgumentOffset(line, 2);
-				profile.curve = GetCurve<2>(_loader.GetRefArgument());
+				profile.curve = *GetCurve<2>(_loader.GetRefArgument());
 				profile.isConvex = IsCurveConvex(profile.curve);
 
 				_loader.MoveToArgumentOffset(line, 3);
@@ -1716,8 +3070,7 @@ namespace webifc
 				
 				for (auto& hole : holes)
 				{
-					IfcCurve<2> holeCurve = GetCurve<2>(_loader.GetRefArgument(hole));
-					profile.holes.push_back(holeCurve);
+					profile.holes.push_back(*GetCurve<2>(_loader.GetRefArgument(hole)));
 				}
 
 				return profile;
@@ -1780,7 +3133,7 @@ namespace webifc
 				
 				glm::dmat3 placement = GetAxis2Placement2D(placementID);
 
-				profile.curve = GetCircleCurve(radius, _loader.GetSettings().CIRCLE_SEGMENTS_HIGH, placement);
+				profile.curve = GetCircleCurve(radius, GetArcPointCount(radius, CONST_PI * 2, _settings.CIRCLE_SEGMENTS_HIGH), placement);
 
 				return profile;
 			}
@@ -1799,7 +3152,9 @@ namespace webifc
 
 				glm::dmat3 placement = GetAxis2Placement2D(placementID);
 
-				profile.curve = GetEllipseCurve(radiusX, radiusY, _loader.GetSettings().CIRCLE_SEGMENTS_HIGH, placement);
+				// the larger radius bounds the chord error
+				int numSegments = GetArcPointCount(std::max(std::fabs(radiusX), std::fabs(radiusY)), CONST_PI * 2, _settings.CIRCLE_SEGMENTS_HIGH);
+				profile.curve = GetEllipseCurve(radiusX, radiusY, numSegments, placement);
 
 				return profile;
 			}
@@ -1818,8 +3173,9 @@ namespace webifc
 
 				glm::dmat3 placement = GetAxis2Placement2D(placementID);
 
-				profile.curve = GetCircleCurve(radius, _loader.GetSettings().CIRCLE_SEGMENTS_HIGH, placement);
-				profile.holes.push_back(GetCircleCurve(radius - thickness, _loader.GetSettings().CIRCLE_SEGMENTS_HIGH, placement));
+				int numSegments = _settings.CIRCLE_SEGMENTS_HIGH;
+				profile.curve = GetCircleCurve(radius, GetArcPointCount(radius, CONST_PI * 2, numSegments), placement);
+				profile.holes.push_back(GetCircleCurve(radius - thickness, GetArcPointCount(radius - thickness, CONST_PI * 2, numSegments), placement));
 				std::reverse(profile.holes[0].points.begin(), profile.holes[0].points.end());
 
 				return profile;
@@ -1830,7 +3186,7 @@ namespace webifc
 
 				_loader.MoveToArgumentOffset(line, 0);
 				profile.type = _loader.GetStringArgument();
-				profile.isConvex = true;
+				profile.isConvex = false;
 
 				_loader.MoveToArgumentOffset(line, 2);
 				uint32_t placementID = _loader.GetRefArgument();
@@ -1918,7 +3274,24 @@ namespace webifc
 
 		glm::dmat4 GetLocalPlacement(uint32_t expressID)
 		{
-			uint32_t lineID = _loader.ExpressIDToLineID(expressID);
+			auto it = _expressIDToPlacement.find(expressID);
+			if (it != _expressIDToPlacement.end())
+			{
+				_statistics.placementCacheHits++;
+				return it->second;
+			}
+
+			// parent placements are cached through the recursion
+			glm::dmat4 placement = GetLocalPlacementByLine(_loader.ExpressIDToLineID(expressID));
+
+			_statistics.placementCacheMisses++;
+			_expressIDToPlacement[expressID] = placement;
+
+			return placement;
+		}
+
+		glm::dmat4 GetLocalPlacementByLine(uint32_t lineID)
+		{
 			auto& line = _loader.GetLine(lineID);
 			switch (line.ifcType)
 			{
@@ -2046,7 +3419,7 @@ namespace webifc
 			}
 
 			default:
-				std::cout << "Unexpected placement type: " << line.ifcType << " at " << expressID << std::endl;
+				std::cout << "Unexpected placement type: " << line.ifcType << " at " << line.expressID << std::endl;
 				break;
 			}
 
@@ -2289,7 +3662,7 @@ namespace webifc
 
 				size_t startIndex = curve.points.size();
 
-				const int numSegments = _loader.GetSettings().CIRCLE_SEGMENTS_HIGH;
+				const int numSegments = GetArcPointCount(radius, lengthRad, _settings.CIRCLE_SEGMENTS_HIGH);
 
 				for (int i = 0; i < numSegments; i++)
 				{
@@ -2404,7 +3777,29 @@ namespace webifc
 		glm::dmat4 coordinationMatrix = glm::dmat4(1.0);
 		bool isCoordinated = false;
 		IfcLoader& _loader;
+		LoaderSettings _settings;
 		std::unordered_map<uint32_t, IfcGeometry> _expressIDToGeometry;
-		std::unordered_map<uint32_t, IfcComposedMesh> _expressIDToMesh;
+		std::unordered_map<uint32_t, IfcComposedMeshPtr> _expressIDToMesh;
+		std::unordered_map<uint32_t, IfcComposedMeshPtr> _representationMapToMesh;
+		std::unordered_set<uint32_t> _instancedGeometryIDs;
+		std::unordered_map<uint64_t, uint32_t> _geometryHashToID;
+		std::unordered_map<uint64_t, uint32_t> _extrusionKeyToGeometryID;
+		std::unordered_map<uint32_t, IfcExtrusion> _geometryIDToExtrusion;
+		// geometries sent as extrusion records with PARAMETRIC_EXTRUSIONS, freed with the cached geometry
+		std::unordered_map<uint32_t, IfcExtrusion> _parametricExtrusions;
+		std::unordered_set<uint32_t> _dedupedGeometryIDs;
+		// only with BOOL_RESULT_CACHE
+		std::shared_ptr<BoolResultCache> _boolResultCache;
+
+		// temporaries of the element being generated, reset after each element
+		MemoryRegion _scratch;
+		uint32_t _meshDepth = 0;
+		// reused so the index buffer is only allocated once
+		mapbox::detail::Earcut<uint32_t> _earcut;
+		std::vector<uint32_t> _fanIndices;
+		std::unordered_map<uint32_t, glm::dmat4> _expressIDToPlacement;
+		std::unordered_map<uint64_t, std::shared_ptr<const IfcProfile>> _profileCache;
+		std::unordered_map<uint64_t, std::shared_ptr<const IfcCurve<2>>> _curveCache2D;
+		std::unordered_map<uint64_t, std::shared_ptr<const IfcCurve<3>>> _curveCache3D;
 	};
 }
\ No newline at end of file
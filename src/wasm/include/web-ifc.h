@@ -34,6 +34,21 @@ namespace webifc
         int CIRCLE_SEGMENTS_MEDIUM = 8;
         int CIRCLE_SEGMENTS_HIGH = 12;
         bool MESH_CACHE = false;
+        bool GEOMETRY_INSTANCING = false;
+        bool GEOMETRY_DEDUPLICATION = false;
+        bool WELD_VERTICES = false;
+        double WELD_TOLERANCE_M = 1e-6;
+        double WELD_CREASE_ANGLE_DEG = 20;
+        bool FLOAT_VERTEX_STORAGE = false;
+        bool USE_NATIVE_BOOLS = false;
+        bool BOOL_RESULT_CACHE = false;
+        double BOOL_RESULT_CACHE_MB = 128;
+        bool ADAPTIVE_TESSELLATION = false;
+        double CHORD_TOLERANCE_M = 0.005;
+        double ANGLE_TOLERANCE_DEG = 90;
+        double MIN_VOID_SIZE_M = 0;
+        bool GEOMETRY_PROXIES = false;
+        bool PARAMETRIC_EXTRUSIONS = false;
     };
 
 	long long ms()
@@ -50,7 +65,9 @@ namespace webifc
 	{
 	public:
         IfcLoader(const LoaderSettings& s = {}):
-            _settings(s)
+            _tape(_region),
+            _settings(s),
+            _metaData(_region)
         {
             
         }
@@ -61,31 +78,31 @@ namespace webifc
 		}
 
 		// this is lazy
-		std::unordered_map<uint32_t, std::vector<uint32_t>>& GetRelVoids()
+		RegionMap<uint32_t, RegionVector<uint32_t>>& GetRelVoids()
 		{
 			return _metaData._relVoids;
 		}
 
 		// this is lazy
-		std::unordered_map<uint32_t, std::vector<uint32_t>>& GetRelAggregates()
+		RegionMap<uint32_t, RegionVector<uint32_t>>& GetRelAggregates()
 		{
 			return _metaData._relAggregates;
 		}
 
 		// this is lazy
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>& GetStyledItems()
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>>& GetStyledItems()
 		{
 			return _metaData._styledItems;
 		}
 
 		// this is lazy
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>& GetRelMaterials()
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>>& GetRelMaterials()
 		{
 			return _metaData._relMaterials;
 		}
 
 		// this is lazy
-		std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>>& GetMaterialDefinitions()
+		RegionMap<uint32_t, RegionVector<std::pair<uint32_t, uint32_t>>>& GetMaterialDefinitions()
 		{
 			return _metaData._materialDefinitions;
 		}
@@ -374,7 +391,7 @@ namespace webifc
             return _metaData.lines.size();
         }
 
-		std::vector<uint32_t>& GetLineIDsWithType(uint32_t type)
+		RegionVector<uint32_t>& GetLineIDsWithType(uint32_t type)
 		{
 			return _metaData.ifcTypeToLineID[type];
 		}
@@ -774,6 +791,7 @@ namespace webifc
 
 	private:
         bool _open = false;
+		MemoryRegion _region; // owns tape and metadata memory, declared first so it outlives them
 		DynamicTape<TAPE_SIZE> _tape; // 16mb chunked tape
         LoaderSettings _settings;
 
@@ -1,5 +1,16 @@
 #include "../deps/tinycpptest/TinyCppTest.hpp"
 #include "../include/util.h"
+#include "../include/math/is-inside-mesh.h"
+#include "../include/math/profile-holes.h"
+#include "../include/math/mesh-boolean.h"
+#include "../include/math/intersect-mesh-mesh.h"
+#include "../include/math/bool-mesh-mesh.h"
+#include "../include/math/clip-mesh-plane.h"
+#include "../include/math/triangulate-with-boundaries.h"
+#include "../include/math/indexed-brep.h"
+#include "../include/math/weld-vertices.h"
+#include "../include/bool-result-cache.h"
+#include "../include/web-ifc-geometry.h"
 
 using namespace webifc;
 
@@ -10,3 +21,1343 @@ TEST (TriangleAreaTest)
 	glm::dvec3 c (0.0, 1.0, 0.0);
 	ASSERT_EQ_EPS (areaOfTriangle (a, b, c), 0.5, EPS_TINY);
 }
+
+TEST (GeometryHashTest)
+{
+	glm::dvec3 a (0.0, 0.0, 0.0);
+	glm::dvec3 b (1.0, 0.0, 0.0);
+	glm::dvec3 c (0.0, 1.0, 0.0);
+	glm::dvec3 d (-0.0, 1.0, 0.0);
+
+	IfcGeometry g1;
+	g1.AddFace (a, b, c);
+	IfcGeometry g2;
+	g2.AddFace (a, b, d);
+	IfcGeometry g3;
+	g3.AddFace (a, c, b);
+
+	ASSERT_EQ (HashGeometry (g1), HashGeometry (g2));
+	ASSERT (IsEqualGeometry (g1, g2));
+	ASSERT_NEQ (HashGeometry (g1), HashGeometry (g3));
+	ASSERT (!IsEqualGeometry (g1, g3));
+}
+
+TEST (InsideMeshBVHTest)
+{
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+
+	BVH bvh (cube);
+	std::vector<uint32_t> candidates;
+	glm::dvec3 normal (0, 0, 1);
+
+	ASSERT (isInsideMesh (glm::dvec3 (0.5, 0.5, 0.5), normal, cube, bvh, candidates) == MeshLocation::INSIDE);
+	ASSERT (isInsideMesh (glm::dvec3 (1.5, 0.5, 0.5), normal, cube, bvh, candidates) == MeshLocation::OUTSIDE);
+
+	for (int i = 0; i < 1000; i++)
+	{
+		glm::dvec3 pt ((i % 10) * 0.17 - 0.3, ((i / 10) % 10) * 0.17 - 0.3, (i / 100) * 0.17 - 0.3);
+		ASSERT (isInsideMesh (pt, normal, cube, bvh, candidates) == isInsideMesh (pt, normal, cube));
+	}
+}
+
+TEST (ProfileHoleTest)
+{
+	IfcProfile profile;
+	profile.curve = GetRectangleCurve (10.0, 10.0);
+
+	ASSERT (addProfileHole (profile, GetRectangleCurve (2.0, 2.0)));
+	ASSERT_EQ (profile.holes.size (), 1);
+	ASSERT (!profile.holes[0].IsCCW ());
+
+	// overlaps the first hole
+	ASSERT (!addProfileHole (profile, GetRectangleCurve (2.0, 2.0, glm::dmat3 (1, 0, 0, 0, 1, 0, 1, 0, 1))));
+	// crosses the outer curve
+	ASSERT (!addProfileHole (profile, GetRectangleCurve (2.0, 2.0, glm::dmat3 (1, 0, 0, 0, 1, 0, 5, 0, 1))));
+	ASSERT (addProfileHole (profile, GetRectangleCurve (2.0, 2.0, glm::dmat3 (1, 0, 0, 0, 1, 0, 3, 3, 1))));
+	ASSERT_EQ (profile.holes.size (), 2);
+}
+
+double GetVolume (const IfcGeometry& geom)
+{
+	double volume = 0;
+	for (uint32_t i = 0; i < geom.numFaces; i++)
+	{
+		Face f = geom.GetFace (i);
+		volume += glm::dot (geom.GetPoint (f.i0), glm::cross (geom.GetPoint (f.i1), geom.GetPoint (f.i2))) / 6.0;
+	}
+
+	return volume;
+}
+
+TEST (MeshBooleanTest)
+{
+	glm::dvec3 a (0, 0, 0);
+	glm::dvec3 b (1, 0, 0);
+	glm::dvec3 c (0, 1, 0);
+	ASSERT (orient3d (a, b, c, glm::dvec3 (0.3, 0.3, 1e-300)) > 0);
+	ASSERT (orient3d (a, b, c, glm::dvec3 (0.3, 0.3, -1e-300)) < 0);
+	ASSERT_EQ (orient3d (a, b, glm::dvec3 (0.1, 0.1, 0.1), glm::dvec3 (0.3, 0.3, 0.3)), 0.0);
+
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+	IfcGeometry shifted = GetBoxGeometry (glm::dvec3 (0.5), glm::dvec3 (1.5));
+
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, shifted, BoolOperation::DIFFERENCE)), 0.875, EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, shifted, BoolOperation::UNION)), 1.875, EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, shifted, BoolOperation::INTERSECTION)), 0.125, EPS_SMALL);
+
+	// shares four face planes with the cube
+	IfcGeometry flush = GetBoxGeometry (glm::dvec3 (0.5, 0, 0), glm::dvec3 (1.5, 1, 1));
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, flush, BoolOperation::DIFFERENCE)), 0.5, EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, flush, BoolOperation::UNION)), 1.5, EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (meshBoolean (cube, flush, BoolOperation::INTERSECTION)), 0.5, EPS_SMALL);
+}
+
+TEST (ClipMeshByPlaneTest)
+{
+	mapbox::detail::Earcut<uint32_t> earcut;
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+
+	IfcGeometry half;
+	ASSERT (clipMeshByPlane (cube, glm::dvec3 (0, 0, 0.5), glm::dvec3 (0, 0, 1), half, earcut));
+	ASSERT_EQ_EPS (GetVolume (half), 0.5, EPS_SMALL);
+
+	// cuts off the corner at (1, 1, 1)
+	IfcGeometry corner;
+	IfcGeometry removed;
+	ASSERT (clipMeshByPlane (cube, glm::dvec3 (1, 1, 0.5), glm::normalize (glm::dvec3 (1, 1, 1)), corner, earcut, &removed));
+	ASSERT_EQ_EPS (GetVolume (corner), (1.0 - 0.125 / 6), EPS_SMALL);
+	// a corner triangle on each of the three sides it cuts
+	double removedArea = 0;
+	for (uint32_t i = 0; i < removed.numFaces; i++)
+	{
+		Face f = removed.GetFace (i);
+		removedArea += areaOfTriangle (removed.GetPoint (f.i0), removed.GetPoint (f.i1), removed.GetPoint (f.i2));
+	}
+	ASSERT_EQ_EPS (removedArea, (3 * 0.125), EPS_SMALL);
+
+	// a plane through a face keeps the whole box
+	IfcGeometry whole;
+	ASSERT (clipMeshByPlane (cube, glm::dvec3 (0, 0, 1), glm::dvec3 (0, 0, 1), whole, earcut));
+	ASSERT_EQ_EPS (GetVolume (whole), 1.0, EPS_SMALL);
+}
+
+TEST (BoolResultCacheTest)
+{
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+	IfcGeometry moved = GetBoxGeometry (glm::dvec3 (10, 20, 30), glm::dvec3 (11, 21, 31));
+
+	// the same box at two placements hashes the same in its own frame
+	glm::dmat4 back (1);
+	back[3] = glm::dvec4 (-10, -20, -30, 1);
+	BoolResultKey key = HashGeometryInFrame (BoolResultKey (), cube, glm::dmat4 (1));
+	ASSERT (HashGeometryInFrame (BoolResultKey (), moved, back) == key);
+	ASSERT (HashGeometryInFrame (BoolResultKey (), moved, glm::dmat4 (1)) != key);
+
+	BoolResultCache cache (cube.vertexData.size () * sizeof (double) + cube.indexData.size () * sizeof (uint32_t) + key.values.size () * sizeof (int64_t));
+	cache.Add (BoolResultKey (key), IfcGeometry (cube));
+	ASSERT (cache.Find (key) != nullptr);
+
+	// a key that only agrees in its hash is a miss
+	BoolResultKey collision = key;
+	collision.values.back ()++;
+	ASSERT (cache.Find (collision) == nullptr);
+
+	// only room for one result, the older one goes
+	BoolResultKey other = HashGeometryInFrame (BoolResultKey (), moved, glm::dmat4 (1));
+	cache.Add (BoolResultKey (other), IfcGeometry (cube));
+	ASSERT (cache.Find (key) == nullptr);
+	ASSERT (cache.Find (other) != nullptr);
+
+	cache.Clear ();
+	ASSERT (cache.Find (other) == nullptr);
+	ASSERT_EQ (cache.GetSize (), 0);
+}
+
+TEST (TriangulateWithBoundariesTest)
+{
+	glm::dvec2 a (0, 0);
+	glm::dvec2 b (1, 0);
+	glm::dvec2 c (0, 1);
+
+	// a chain of segments, a long one across the others' triangles, one along the outline and one through an earlier point
+	std::vector<Loop> loops;
+	loops.push_back ({ true, glm::dvec2 (0.25, 0.25), glm::dvec2 (0.25, 0.25) });
+	loops.push_back ({ false, glm::dvec2 (0.1, 0.1), glm::dvec2 (0.4, 0.4) });
+	loops.push_back ({ false, glm::dvec2 (0.4, 0.4), glm::dvec2 (0.1, 0.6) });
+	loops.push_back ({ false, glm::dvec2 (0.05, 0.8), glm::dvec2 (0.8, 0.05) });
+	loops.push_back ({ false, glm::dvec2 (0.2, 0), glm::dvec2 (0.7, 0) });
+	loops.push_back ({ false, glm::dvec2 (0.3, 0.7), glm::dvec2 (0.3, 0.7) });
+
+	std::vector<Triangle> triangles = triangulate (a, b, c, loops);
+	ASSERT (IsValidTriangulation (triangles));
+
+	double area = 0;
+	for (auto& t : triangles)
+	{
+		double signedArea = cross2d (t.b () - t.a (), t.c () - t.a ()) / 2;
+		ASSERT (signedArea > 0);
+		area += signedArea;
+	}
+	ASSERT_EQ_EPS (area, 0.5, EPS_SMALL);
+
+	// every segment ends up as an edge, or as a run of edges where it passes through other points
+	auto hasEdgeAt = [&](glm::dvec2 p, glm::dvec2 q) {
+		for (auto& t : triangles)
+		{
+			Point pts[3] = { t.a, t.b, t.c };
+			for (int k = 0; k < 3; k++)
+			{
+				if (equals2d (pts[k] (), p, EPS_SMALL) && equals2d (pts[(k + 1) % 3] (), q, EPS_SMALL))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	};
+	ASSERT (hasEdgeAt (glm::dvec2 (0.1, 0.1), glm::dvec2 (0.25, 0.25)) || hasEdgeAt (glm::dvec2 (0.25, 0.25), glm::dvec2 (0.1, 0.1)));
+	ASSERT (hasEdgeAt (glm::dvec2 (0.4, 0.4), glm::dvec2 (0.1, 0.6)) || hasEdgeAt (glm::dvec2 (0.1, 0.6), glm::dvec2 (0.4, 0.4)));
+	ASSERT (hasEdgeAt (glm::dvec2 (0.05, 0.8), glm::dvec2 (0.8, 0.05)) || hasEdgeAt (glm::dvec2 (0.8, 0.05), glm::dvec2 (0.05, 0.8)));
+	ASSERT (hasEdgeAt (glm::dvec2 (0.2, 0), glm::dvec2 (0.7, 0)));
+}
+
+TEST (ConvexLoopTest)
+{
+	// closed by repeating the first point, clockwise
+	std::vector<glm::dvec2> square = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 } };
+	std::vector<glm::dvec2> arrow = { { 0, 0 }, { 2, 1 }, { 0, 2 }, { 1, 1 } };
+	ASSERT (IsConvexLoop (square));
+	ASSERT (!IsConvexLoop (arrow));
+
+	// triangles wind counter clockwise like earcut's, whatever the winding of the loop
+	std::vector<uint32_t> indices;
+	FanTriangulate (square, indices);
+	ASSERT_EQ (indices.size (), 6);
+	for (size_t i = 0; i < indices.size (); i += 3)
+	{
+		ASSERT (cross2d (square[indices[i + 1]] - square[indices[i]], square[indices[i + 2]] - square[indices[i]]) > 0);
+	}
+
+	// the concave quad can only be split from its reflex corner
+	TriangulateQuad (arrow, indices);
+	ASSERT_EQ (indices.size (), 6);
+	double area = 0;
+	for (size_t i = 0; i < indices.size (); i += 3)
+	{
+		double signedArea = cross2d (arrow[indices[i + 1]] - arrow[indices[i]], arrow[indices[i + 2]] - arrow[indices[i]]) / 2;
+		ASSERT (signedArea > 0);
+		area += signedArea;
+	}
+	ASSERT_EQ_EPS (area, 1.0, EPS_SMALL);
+}
+
+TEST (IndexedBrepTest)
+{
+	// the triangles of a unit cube as faces referring to its eight corners
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+	IndexedBrep brep;
+	std::vector<glm::dvec3> corners;
+	auto getCorner = [&](glm::dvec3 pt) {
+		auto it = std::find (corners.begin (), corners.end (), pt);
+		if (it == corners.end ())
+		{
+			brep.AddPoint (100 + static_cast<uint32_t> (corners.size ()), pt);
+			corners.push_back (pt);
+			return static_cast<uint32_t> (corners.size () - 1);
+		}
+		return static_cast<uint32_t> (it - corners.begin ());
+	};
+
+	for (uint32_t i = 0; i < cube.numFaces; i++)
+	{
+		Face f = cube.GetFace (i);
+		brep.StartFace ();
+		brep.StartLoop ();
+		brep.AddCorner (getCorner (cube.GetPoint (f.i0)));
+		brep.AddCorner (getCorner (cube.GetPoint (f.i1)));
+		brep.AddCorner (getCorner (cube.GetPoint (f.i2)));
+	}
+	ASSERT_EQ (corners.size (), 8);
+	ASSERT_EQ (brep.FindPoint (103), 3);
+	ASSERT_EQ (brep.FindPoint (108), -1);
+
+	// every cube edge is a crease, so each side keeps its own vertices
+	IfcGeometry flat = brep.Build (glm::cos (glm::radians (20.0)));
+	ASSERT_EQ (flat.numPoints, 24);
+	ASSERT_EQ (flat.numFaces, 12);
+	ASSERT_EQ_EPS (GetVolume (flat), 1.0, EPS_SMALL);
+
+	IfcGeometry smooth = brep.Build (-1);
+	ASSERT_EQ (smooth.numPoints, 8);
+	ASSERT_EQ (smooth.numFaces, 12);
+	ASSERT_EQ_EPS (GetVolume (smooth), 1.0, EPS_SMALL);
+}
+
+TEST (MemoryRegionTest)
+{
+	MemoryRegion region (1024);
+
+	// pieces of a shared block are reused for the same size
+	void* small = region.Allocate (100);
+	region.Deallocate (small, 100);
+	ASSERT (region.Allocate (100) == small);
+
+	// blocks of their own are freed right away
+	size_t reserved = region.GetReservedBytes ();
+	void* large = region.Allocate (4096);
+	ASSERT (region.GetReservedBytes () > reserved + 4096);
+	region.Deallocate (large, 4096);
+	ASSERT_EQ (region.GetReservedBytes (), reserved);
+	ASSERT_EQ (region.GetNumBlocks (), 1);
+}
+
+TEST (ExtrusionDataTest)
+{
+	auto profile = std::make_shared<IfcProfile> ();
+	profile->curve = GetRectangleCurve (4.0, 2.0);
+	profile->holes.push_back (GetRectangleCurve (1.0, 1.0));
+	profile->isConvex = false;
+
+	IfcExtrusion extrusion = { profile, glm::dvec3 (0, 0, 1), 3.0 };
+	std::vector<double> data = GetExtrusionData (extrusion);
+
+	IfcExtrusion read;
+	ASSERT (ReadExtrusionData (data, read));
+	ASSERT_EQ (read.depth, 3.0);
+	ASSERT (read.dir == extrusion.dir);
+	ASSERT (!read.profile->isConvex);
+	ASSERT (read.profile->curve.points == profile->curve.points);
+	ASSERT_EQ (read.profile->holes.size (), 1);
+	ASSERT (read.profile->holes[0].points == profile->holes[0].points);
+	ASSERT (IsEqualExtrusion (read, extrusion));
+
+	IfcExtrusion deeper = { profile, glm::dvec3 (0, 0, 1), 3.5 };
+	ASSERT (!IsEqualExtrusion (deeper, extrusion));
+
+	// a record cut short is rejected
+	data.pop_back ();
+	ASSERT (!ReadExtrusionData (data, read));
+
+	// hollow profiles have a convex outline, but their caps can't be fanned
+	auto hollow = std::make_shared<IfcProfile> (*profile);
+	hollow->isConvex = true;
+	extrusion.profile = hollow;
+	ASSERT_EQ (GetExtrusionData (extrusion)[4], 0.0);
+
+	hollow->holes.clear ();
+	ASSERT_EQ (GetExtrusionData (extrusion)[4], 1.0);
+}
+
+// a model in metres around the given lines, numbered from #10
+std::string MakeIfc (const std::string& lines)
+{
+	return "ISO-10303-21;\nHEADER;\nENDSEC;\nDATA;\n"
+		"#1=IFCPROJECT('0',$,$,$,$,$,$,$,#2);\n"
+		"#2=IFCUNITASSIGNMENT((#3));\n"
+		"#3=IFCSIUNIT(*,.LENGTHUNIT.,$,.METRE.);\n" +
+		lines + "ENDSEC;\nEND-ISO-10303-21;\n";
+}
+
+const std::string EXTRUSION_IFC = MakeIfc (
+	"#10=IFCCARTESIANPOINT((1.,2.));\n"
+	"#11=IFCAXIS2PLACEMENT2D(#10,$);\n"
+	"#12=IFCRECTANGLEPROFILEDEF(.AREA.,$,#11,4.,2.);\n"
+	"#13=IFCCARTESIANPOINT((100000.,200000.,30.));\n"
+	"#14=IFCAXIS2PLACEMENT3D(#13,$,$);\n"
+	"#15=IFCDIRECTION((0.,0.,1.));\n"
+	"#16=IFCEXTRUDEDAREASOLID(#12,#14,#15,3.);\n");
+
+TEST (ProfileCacheTest)
+{
+	// two profiles of one outline, the first extruded twice, and an extrusion only generated after clearing the cache
+	IfcLoader loader;
+	loader.LoadFile (MakeIfc (
+		"#10=IFCCARTESIANPOINT((0.,0.));\n"
+		"#11=IFCCARTESIANPOINT((2.,0.));\n"
+		"#12=IFCCARTESIANPOINT((2.,1.));\n"
+		"#13=IFCPOLYLINE((#10,#11,#12,#10));\n"
+		"#14=IFCARBITRARYCLOSEDPROFILEDEF(.AREA.,$,#13);\n"
+		"#15=IFCARBITRARYCLOSEDPROFILEDEF(.AREA.,$,#13);\n"
+		"#20=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#21=IFCAXIS2PLACEMENT3D(#20,$,$);\n"
+		"#22=IFCDIRECTION((0.,0.,1.));\n"
+		"#23=IFCEXTRUDEDAREASOLID(#14,#21,#22,1.);\n"
+		"#24=IFCEXTRUDEDAREASOLID(#14,#21,#22,2.);\n"
+		"#25=IFCEXTRUDEDAREASOLID(#15,#21,#22,1.);\n"
+		"#26=IFCEXTRUDEDAREASOLID(#14,#21,#22,3.);\n"));
+	IfcGeometryLoader geometryLoader (loader);
+
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetFlattenedGeometry (23)), 1.0, EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetFlattenedGeometry (24)), 2.0, EPS_SMALL);
+	ASSERT_EQ (geometryLoader.GetStatistics ().profileCacheMisses, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().profileCacheHits, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().curveCacheMisses, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().curveCacheHits, 0);
+
+	// another profile of the same outline reuses the curve
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetFlattenedGeometry (25)), 1.0, EPS_SMALL);
+	ASSERT_EQ (geometryLoader.GetStatistics ().profileCacheMisses, 2);
+	ASSERT_EQ (geometryLoader.GetStatistics ().curveCacheMisses, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().curveCacheHits, 1);
+
+	geometryLoader.ClearCachedProfiles ();
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetFlattenedGeometry (26)), 3.0, EPS_SMALL);
+	ASSERT_EQ (geometryLoader.GetStatistics ().profileCacheMisses, 3);
+	ASSERT_EQ (geometryLoader.GetStatistics ().profileCacheHits, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().curveCacheMisses, 2);
+}
+
+TEST (ParametricExtrusionTest)
+{
+	IfcLoader reference;
+	reference.LoadFile (EXTRUSION_IFC);
+	IfcGeometryLoader referenceGeometry (reference);
+	IfcFlatMesh referenceMesh = referenceGeometry.GetFlatMesh (16);
+	ASSERT_EQ (referenceMesh.geometries.size (), 1);
+	ASSERT (!referenceMesh.geometries[0].isParametric);
+
+	LoaderSettings settings;
+	settings.PARAMETRIC_EXTRUSIONS = true;
+	settings.FLOAT_VERTEX_STORAGE = true;
+	IfcLoader loader (settings);
+	loader.LoadFile (EXTRUSION_IFC);
+	IfcGeometryLoader geometryLoader (loader);
+
+	IfcFlatMesh mesh = geometryLoader.GetFlatMesh (16);
+	ASSERT_EQ (mesh.geometries.size (), 1);
+	ASSERT (mesh.geometries[0].isParametric);
+	ASSERT (mesh.geometries[0].transformation == referenceMesh.geometries[0].transformation);
+
+	// the record expands to the mesh generated without the setting
+	IfcExtrusion extrusion;
+	ASSERT (ReadExtrusionData (geometryLoader.GetParametricGeometry (16), extrusion));
+	IfcGeometry expanded = geometryLoader.ExpandExtrusion (extrusion);
+	ASSERT (IsEqualGeometry (expanded, referenceGeometry.GetCachedGeometry (16)));
+
+	// GetGeometry of the record is in the same frame, and placing it again afterwards doesn't move it
+	IfcGeometry& cached = geometryLoader.GetCachedGeometry (16);
+	ASSERT (!cached.isFloatStorage);
+	ASSERT (IsEqualGeometry (cached, expanded));
+	mesh = geometryLoader.GetFlatMesh (16);
+	ASSERT (mesh.geometries[0].transformation == referenceMesh.geometries[0].transformation);
+}
+
+TEST (ArcPointCountTest)
+{
+	LoaderSettings settings;
+	IfcLoader loader (settings);
+	loader.LoadFile (MakeIfc (""));
+	ASSERT_EQ (IfcGeometryLoader (loader).GetArcPointCount (1000, CONST_PI * 2, 12), 12);
+
+	settings.ADAPTIVE_TESSELLATION = true;
+	IfcGeometryLoader geometryLoader (loader, settings);
+
+	// a 1 m circle needs steps of 2 * acos (1 - 0.005) to stay within 5 mm, 32 of them
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1, CONST_PI * 2, 12), 33);
+	ASSERT_EQ (geometryLoader.GetArcPointCount (-1, -CONST_PI * 2, 12), 33);
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1, CONST_PI, 12), 17);
+
+	// below the chord tolerance only the angle tolerance of 90 degrees counts
+	ASSERT_EQ (geometryLoader.GetArcPointCount (0.001, CONST_PI * 2, 12), 5);
+	ASSERT_EQ (geometryLoader.GetArcPointCount (0.001, CONST_PI / 4, 12), 2);
+	// at least one segment, however short the arc
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1, 1e-9, 12), 2);
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1, 0, 12), 2);
+
+	// very large radii stop at ADAPTIVE_MAX_CIRCLE_SEGMENTS per full circle
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1e6, CONST_PI * 2, 12), (ADAPTIVE_MAX_CIRCLE_SEGMENTS + 1));
+	ASSERT_EQ (geometryLoader.GetArcPointCount (1e6, CONST_PI / 2, 12), (ADAPTIVE_MAX_CIRCLE_SEGMENTS / 4 + 1));
+
+	LoaderSettings fineAngle = settings;
+	fineAngle.ANGLE_TOLERANCE_DEG = 10;
+	ASSERT_EQ (IfcGeometryLoader (loader, fineAngle).GetArcPointCount (0.001, CONST_PI * 2, 12), 37);
+
+	// the chord tolerance is in metres whatever the model's unit
+	std::string millimetres = MakeIfc ("");
+	millimetres.replace (millimetres.find ("$,.METRE."), 9, ".MILLI.,.METRE.");
+	IfcLoader millimetreLoader (settings);
+	millimetreLoader.LoadFile (millimetres);
+	ASSERT_EQ (IfcGeometryLoader (millimetreLoader).GetArcPointCount (1000, CONST_PI * 2, 12), 33);
+}
+
+TEST (TriangleInsideCurveTest)
+{
+	// an L with its reflex corner at (1, 1)
+	IfcCurve<2> curve;
+	curve.points = { { 0, 0 }, { 2, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 2 } };
+
+	ASSERT (isTriangleInsideCurve (glm::dvec2 (0, 0), glm::dvec2 (2, 0), glm::dvec2 (1, 1), curve));
+	ASSERT (isTriangleInsideCurve (glm::dvec2 (0.2, 0.2), glm::dvec2 (0.2, 1.8), glm::dvec2 (0.8, 0.5), curve));
+	// all corners inside, but it spans the notch
+	ASSERT (!isTriangleInsideCurve (glm::dvec2 (1.9, 0.5), glm::dvec2 (0.5, 1.9), glm::dvec2 (0.2, 0.2), curve));
+	// corners on the outline, across the notch
+	ASSERT (!isTriangleInsideCurve (glm::dvec2 (2, 1), glm::dvec2 (1, 2), glm::dvec2 (2, 2), curve));
+
+	curve.Invert ();
+	ASSERT (isTriangleInsideCurve (glm::dvec2 (0, 0), glm::dvec2 (1, 1), glm::dvec2 (2, 0), curve));
+	ASSERT (!isTriangleInsideCurve (glm::dvec2 (1.9, 0.5), glm::dvec2 (0.5, 1.9), glm::dvec2 (0.2, 0.2), curve));
+}
+
+// a 10 x 2 x 3 box with the part above z = 2 inside the boundary clipped off
+std::string GetBoundedClipIfc (const std::string& boundary)
+{
+	return MakeIfc (
+		"#10=IFCCARTESIANPOINT((0.,0.));\n"
+		"#11=IFCAXIS2PLACEMENT2D(#10,$);\n"
+		"#12=IFCRECTANGLEPROFILEDEF(.AREA.,$,#11,10.,2.);\n"
+		"#13=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#14=IFCAXIS2PLACEMENT3D(#13,$,$);\n"
+		"#15=IFCDIRECTION((0.,0.,1.));\n"
+		"#16=IFCEXTRUDEDAREASOLID(#12,#14,#15,3.);\n"
+		"#17=IFCCARTESIANPOINT((0.,0.,2.));\n"
+		"#18=IFCAXIS2PLACEMENT3D(#17,$,$);\n"
+		"#19=IFCPLANE(#14);\n"
+		"#20=IFCPOLYLINE((" + boundary + "));\n"
+		"#21=IFCPOLYGONALBOUNDEDHALFSPACE(#19,.F.,#18,#20);\n"
+		"#22=IFCBOOLEANCLIPPINGRESULT(.DIFFERENCE.,#16,#21);\n"
+		"#30=IFCCARTESIANPOINT((-6.,-2.));\n"
+		"#31=IFCCARTESIANPOINT((6.,-2.));\n"
+		"#32=IFCCARTESIANPOINT((6.,5.));\n"
+		"#33=IFCCARTESIANPOINT((5.5,5.));\n"
+		"#34=IFCCARTESIANPOINT((5.5,1.5));\n"
+		"#35=IFCCARTESIANPOINT((-6.,1.5));\n"
+		"#36=IFCCARTESIANPOINT((6.,2.));\n"
+		"#37=IFCCARTESIANPOINT((1.,2.));\n"
+		"#38=IFCCARTESIANPOINT((0.,0.));\n"
+		"#39=IFCCARTESIANPOINT((-1.,2.));\n"
+		"#40=IFCCARTESIANPOINT((-6.,2.));\n");
+}
+
+TEST (PolygonalBoundedHalfSpaceTest)
+{
+	// the reflex corner of the boundary is off the box, so the plane cut is enough
+	IfcLoader loader;
+	loader.LoadFile (GetBoundedClipIfc ("#30,#31,#32,#33,#34,#35,#30"));
+	IfcGeometryLoader geometryLoader (loader);
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetFlattenedGeometry (22)), 40.0, EPS_SMALL);
+	ASSERT_EQ (geometryLoader.GetStatistics ().halfSpaceClips, 1);
+
+	// a notch reaching into the box keeps a wedge above the plane, which takes the boolean
+	IfcLoader notchedLoader;
+	notchedLoader.LoadFile (GetBoundedClipIfc ("#30,#31,#36,#37,#38,#39,#40,#30"));
+	IfcGeometryLoader notchedGeometryLoader (notchedLoader);
+	notchedGeometryLoader.GetFlattenedGeometry (22);
+	ASSERT_EQ (notchedGeometryLoader.GetStatistics ().halfSpaceClips, 0);
+}
+
+// two elements with a mapped item each of one representation map of a unit cube
+const std::string MAPPED_IFC = MakeIfc (
+	"#10=IFCCARTESIANPOINT((0.,0.,0.));\n"
+	"#11=IFCAXIS2PLACEMENT3D(#10,$,$);\n"
+	"#12=IFCDIRECTION((0.,0.,1.));\n"
+	"#13=IFCCARTESIANPOINT((0.,0.));\n"
+	"#14=IFCAXIS2PLACEMENT2D(#13,$);\n"
+	"#15=IFCRECTANGLEPROFILEDEF(.AREA.,$,#14,1.,1.);\n"
+	"#16=IFCEXTRUDEDAREASOLID(#15,#11,#12,1.);\n"
+	"#17=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#16));\n"
+	"#18=IFCREPRESENTATIONMAP(#11,#17);\n"
+	"#19=IFCCARTESIANTRANSFORMATIONOPERATOR3D($,$,#10,$,$);\n"
+	"#20=IFCMAPPEDITEM(#18,#19);\n"
+	"#21=IFCSHAPEREPRESENTATION($,'Body','MappedRepresentation',(#20));\n"
+	"#22=IFCPRODUCTDEFINITIONSHAPE($,$,(#21));\n"
+	"#23=IFCCARTESIANPOINT((5.,0.,0.));\n"
+	"#24=IFCAXIS2PLACEMENT3D(#23,$,$);\n"
+	"#25=IFCLOCALPLACEMENT($,#24);\n"
+	"#26=IFCBUILDINGELEMENTPROXY('a',$,$,$,$,#25,#22,$,$);\n"
+	"#30=IFCMAPPEDITEM(#18,#19);\n"
+	"#31=IFCSHAPEREPRESENTATION($,'Body','MappedRepresentation',(#30));\n"
+	"#32=IFCPRODUCTDEFINITIONSHAPE($,$,(#31));\n"
+	"#33=IFCCARTESIANPOINT((0.,5.,0.));\n"
+	"#34=IFCAXIS2PLACEMENT3D(#33,$,$);\n"
+	"#35=IFCLOCALPLACEMENT($,#34);\n"
+	"#36=IFCBUILDINGELEMENTPROXY('b',$,$,$,$,#35,#32,$,$);\n");
+
+TEST (InstancedGeometryTest)
+{
+	LoaderSettings settings;
+	settings.GEOMETRY_INSTANCING = true;
+	IfcLoader loader (settings);
+	loader.LoadFile (MAPPED_IFC);
+	IfcGeometryLoader geometryLoader (loader);
+
+	IfcFlatMesh first = geometryLoader.GetFlatMesh (26);
+	IfcFlatMesh second = geometryLoader.GetFlatMesh (36);
+	ASSERT_EQ (first.geometries.size (), 1);
+	ASSERT_EQ (second.geometries.size (), 1);
+	uint32_t geometryID = first.geometries[0].geometryExpressID;
+	ASSERT_EQ (second.geometries[0].geometryExpressID, geometryID);
+	ASSERT (first.geometries[0].transformation != second.geometries[0].transformation);
+	ASSERT (geometryLoader.GetInstancedGeometryIDs () == std::vector<uint32_t> { geometryID });
+	ASSERT_EQ (geometryLoader.GetStatistics ().instanceCacheMisses, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().instanceCacheHits, 1);
+
+	// streaming clears the geometry of each element, the shared one stays
+	geometryLoader.ClearCachedGeometry ();
+	ASSERT (geometryLoader.HasCachedGeometry (geometryID));
+	ASSERT (geometryLoader.GetInstancedGeometryIDs () == std::vector<uint32_t> { geometryID });
+	ASSERT_EQ (geometryLoader.GetFlatMesh (26).geometries[0].geometryExpressID, geometryID);
+	ASSERT_EQ (geometryLoader.GetStatistics ().instanceCacheHits, 2);
+
+	// after an edit the map is generated again on its next use
+	geometryLoader.ClearInstancedGeometry ();
+	ASSERT (geometryLoader.GetInstancedGeometryIDs ().empty ());
+	geometryLoader.ClearCachedGeometry ();
+	ASSERT (!geometryLoader.HasCachedGeometry (geometryID));
+
+	ASSERT_EQ (geometryLoader.GetFlatMesh (36).geometries[0].geometryExpressID, geometryID);
+	ASSERT_EQ (geometryLoader.GetStatistics ().instanceCacheMisses, 2);
+	ASSERT (geometryLoader.HasCachedGeometry (geometryID));
+	ASSERT (geometryLoader.GetInstancedGeometryIDs () == std::vector<uint32_t> { geometryID });
+	ASSERT_EQ_EPS (GetVolume (geometryLoader.GetCachedGeometry (geometryID)), 1.0, EPS_SMALL);
+}
+
+// a unit cube placed relative to a parent placement at the given point
+std::string GetPlacedCubeIfc (glm::dvec3 parentPos)
+{
+	std::stringstream lines;
+	lines << "#10=IFCCARTESIANPOINT((" << parentPos.x << "," << parentPos.y << "," << parentPos.z << "));\n"
+		"#11=IFCAXIS2PLACEMENT3D(#10,$,$);\n"
+		"#12=IFCLOCALPLACEMENT($,#11);\n"
+		"#13=IFCCARTESIANPOINT((10.,0.,0.));\n"
+		"#14=IFCAXIS2PLACEMENT3D(#13,$,$);\n"
+		"#15=IFCLOCALPLACEMENT(#12,#14);\n"
+		"#20=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#21=IFCAXIS2PLACEMENT3D(#20,$,$);\n"
+		"#22=IFCDIRECTION((0.,0.,1.));\n"
+		"#23=IFCCARTESIANPOINT((0.,0.));\n"
+		"#24=IFCAXIS2PLACEMENT2D(#23,$);\n"
+		"#25=IFCRECTANGLEPROFILEDEF(.AREA.,$,#24,1.,1.);\n"
+		"#26=IFCEXTRUDEDAREASOLID(#25,#21,#22,1.);\n"
+		"#27=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#26));\n"
+		"#28=IFCPRODUCTDEFINITIONSHAPE($,$,(#27));\n"
+		"#29=IFCBUILDINGELEMENTPROXY('a',$,$,$,$,#15,#28,$,$);\n";
+
+	return MakeIfc (lines.str ());
+}
+
+// replaces a 3D point the way WriteLine does
+void RewritePoint (IfcLoader& loader, uint32_t expressID, glm::dvec3 pt)
+{
+	auto& tape = loader.GetTape ();
+	tape.SetWriteAtEnd ();
+	uint32_t start = tape.GetTotalSize ();
+
+	tape.push (IfcTokenType::REF);
+	tape.push (&expressID, sizeof (uint32_t));
+	const char* name = GetReadableNameFromTypeCode (ifc2x4::IFCCARTESIANPOINT);
+	uint8_t length = strlen (name);
+	tape.push (IfcTokenType::LABEL);
+	tape.push (length);
+	tape.push ((void*)name, length);
+
+	tape.push (IfcTokenType::SET_BEGIN);
+	tape.push (IfcTokenType::SET_BEGIN);
+	for (int i = 0; i < 3; i++)
+	{
+		double value = pt[i];
+		tape.push (IfcTokenType::REAL);
+		tape.push (&value, sizeof (double));
+	}
+	tape.push (IfcTokenType::SET_END);
+	tape.push (IfcTokenType::SET_END);
+	tape.push (IfcTokenType::LINE_END);
+
+	loader.UpdateLineTape (expressID, ifc2x4::IFCCARTESIANPOINT, start, tape.GetTotalSize ());
+}
+
+TEST (PlacementCacheTest)
+{
+	IfcLoader loader;
+	loader.LoadFile (GetPlacedCubeIfc (glm::dvec3 (1, 2, 3)));
+	IfcGeometryLoader geometryLoader (loader);
+
+	glm::dmat4 placed = geometryLoader.GetFlatMesh (29).geometries[0].transformation;
+	uint32_t misses = geometryLoader.GetStatistics ().placementCacheMisses;
+	uint32_t hits = geometryLoader.GetStatistics ().placementCacheHits;
+	ASSERT (misses > 0);
+
+	// the second time every placement comes from the cache
+	ASSERT (geometryLoader.GetFlatMesh (29).geometries[0].transformation == placed);
+	ASSERT_EQ (geometryLoader.GetStatistics ().placementCacheMisses, misses);
+	ASSERT (geometryLoader.GetStatistics ().placementCacheHits > hits);
+
+	// until the edited point is invalidated the cached placement is still used, other types keep the cache
+	RewritePoint (loader, 10, glm::dvec3 (4, 5, 6));
+	ASSERT (geometryLoader.GetFlatMesh (29).geometries[0].transformation == placed);
+	geometryLoader.InvalidateCachedPlacements (ifc2x4::IFCWALL);
+	ASSERT (geometryLoader.GetFlatMesh (29).geometries[0].transformation == placed);
+	ASSERT_EQ (geometryLoader.GetStatistics ().placementCacheMisses, misses);
+
+	// afterwards every placement is resolved again, and the parent moves the element
+	geometryLoader.InvalidateCachedPlacements (ifc2x4::IFCCARTESIANPOINT);
+	glm::dmat4 moved = geometryLoader.GetFlatMesh (29).geometries[0].transformation;
+	ASSERT_EQ (geometryLoader.GetStatistics ().placementCacheMisses, (2 * misses));
+
+	IfcLoader reference;
+	reference.LoadFile (GetPlacedCubeIfc (glm::dvec3 (4, 5, 6)));
+	IfcGeometryLoader referenceGeometry (reference);
+	ASSERT (moved == referenceGeometry.GetFlatMesh (29).geometries[0].transformation);
+	ASSERT (moved != placed);
+}
+
+// every edge is shared by two triangles, vertices at the same position count as one
+bool IsClosedMesh (const IfcGeometry& geom)
+{
+	std::map<std::array<double, 3>, uint32_t> ids;
+	auto getID = [&](uint32_t index) {
+		glm::dvec3 pt = geom.GetPoint (index);
+		return ids.emplace (std::array<double, 3> { pt.x, pt.y, pt.z }, static_cast<uint32_t> (ids.size ())).first->second;
+	};
+
+	std::map<std::pair<uint32_t, uint32_t>, int> edges;
+	for (uint32_t i = 0; i < geom.numFaces; i++)
+	{
+		Face f = geom.GetFace (i);
+		uint32_t corners[3] = { getID (f.i0), getID (f.i1), getID (f.i2) };
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t a = corners[k];
+			uint32_t b = corners[(k + 1) % 3];
+			edges[{ std::min (a, b), std::max (a, b) }]++;
+		}
+	}
+
+	for (auto& edge : edges)
+	{
+		if (edge.second != 2)
+		{
+			return false;
+		}
+	}
+
+	return !edges.empty ();
+}
+
+TEST (BoxGeometryTest)
+{
+	glm::dvec3 min (1, 2, 3);
+	glm::dvec3 max (2, 4, 6);
+	IfcGeometry box = GetBoxGeometry (min, max);
+	ASSERT_EQ (box.numFaces, 12);
+	ASSERT (IsClosedMesh (box));
+	ASSERT_EQ_EPS (GetVolume (box), 6.0, EPS_SMALL);
+
+	// the stored normals face away from the center
+	glm::dvec3 center = (min + max) / 2.0;
+	for (uint32_t i = 0; i < box.numFaces; i++)
+	{
+		Face f = box.GetFace (i);
+		glm::dvec3 a = box.GetPoint (f.i0);
+		glm::dvec3 normal = computeNormal (a, box.GetPoint (f.i1), box.GetPoint (f.i2));
+		ASSERT (glm::dot (normal, a - center) > 0);
+		ASSERT (equals (box.GetNormal (f.i0), normal, EPS_SMALL));
+	}
+
+	// the sides of a flat box have no area, only top and bottom are left
+	IfcGeometry flat = GetBoxGeometry (min, glm::dvec3 (max.x, max.y, min.z));
+	ASSERT_EQ (flat.numFaces, 4);
+	ASSERT_EQ_EPS (GetVolume (flat), 0.0, EPS_SMALL);
+}
+
+double GetArea (const IfcCurve<2>& curve)
+{
+	double area = 0;
+	for (size_t i = 0; i < curve.points.size (); i++)
+	{
+		glm::dvec2 a = curve.points[i];
+		glm::dvec2 b = curve.points[(i + 1) % curve.points.size ()];
+		area += (a.x * b.y - b.x * a.y) / 2;
+	}
+
+	return area;
+}
+
+// a disk of radius 0.5 swept along a polyline through the given points
+std::string GetSweptDiskIfc (const std::vector<glm::dvec3>& points)
+{
+	std::stringstream lines;
+	std::string refs;
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		lines << "#" << 20 + i << "=IFCCARTESIANPOINT((" << points[i].x << "," << points[i].y << "," << points[i].z << "));\n";
+		refs += (i ? ",#" : "#") + std::to_string (20 + i);
+	}
+	lines << "#10=IFCPOLYLINE((" << refs << "));\n"
+		<< "#11=IFCSWEPTDISKSOLID(#10,0.5,$,$,$);\n";
+
+	return MakeIfc (lines.str ());
+}
+
+TEST (SweepTest)
+{
+	// 24 points and the first again to close it, 15 degrees between the edges is below the crease angle so each point has one column of vertices
+	LoaderSettings settings;
+	settings.CIRCLE_SEGMENTS_MEDIUM = 25;
+	double diskArea = GetArea (GetCircleCurve (0.5, 25));
+
+	// straight, with a point along the way that gets a ring but no crease
+	IfcLoader straightLoader (settings);
+	straightLoader.LoadFile (GetSweptDiskIfc ({ glm::dvec3 (0, 0, 0), glm::dvec3 (0, 0, 4), glm::dvec3 (0, 0, 10) }));
+	IfcGeometryLoader straightGeometry (straightLoader);
+	IfcGeometry pipe = straightGeometry.GetFlattenedGeometry (11);
+	ASSERT (IsClosedMesh (pipe));
+	ASSERT_EQ_EPS (GetVolume (pipe), (diskArea * 10), EPS_SMALL);
+	// vertices are counted on the stored sweep, flattening gives every face its own
+	ASSERT_EQ (straightGeometry.GetCachedGeometry (11).numPoints, (3 * 24 + 2 * 24));
+
+	// the ring at the bend is doubled for the crease, a mitred bend keeps the volume of the centre line
+	IfcLoader bentLoader (settings);
+	bentLoader.LoadFile (GetSweptDiskIfc ({ glm::dvec3 (0, 0, 0), glm::dvec3 (0, 0, 10), glm::dvec3 (5, 0, 10) }));
+	IfcGeometryLoader bentGeometry (bentLoader);
+	IfcGeometry elbow = bentGeometry.GetFlattenedGeometry (11);
+	ASSERT (IsClosedMesh (elbow));
+	ASSERT_EQ_EPS (GetVolume (elbow), (diskArea * 15), EPS_SMALL);
+	ASSERT_EQ (bentGeometry.GetCachedGeometry (11).numPoints, (4 * 24 + 2 * 24));
+
+	// a quarter turn of a hollow square in 24 steps of 3.75 degrees, so only the corners of both loops are creases
+	// with two columns each, the caps only need one vertex per point
+	IfcLoader hollowLoader (settings);
+	hollowLoader.LoadFile (MakeIfc (
+		"#10=IFCCARTESIANPOINT((0.,0.));\n"
+		"#11=IFCAXIS2PLACEMENT2D(#10,$);\n"
+		"#12=IFCRECTANGLEHOLLOWPROFILEDEF(.AREA.,$,#11,4.,4.,2.,$,$);\n"
+		"#13=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#14=IFCAXIS2PLACEMENT3D(#13,$,$);\n"
+		"#15=IFCCARTESIANPOINT((10.,0.,0.));\n"
+		"#16=IFCDIRECTION((0.,1.,0.));\n"
+		"#17=IFCAXIS1PLACEMENT(#15,#16);\n"
+		"#18=IFCREVOLVEDAREASOLID(#12,#14,#17,1.5707963267948966);\n"));
+	IfcGeometryLoader hollowGeometry (hollowLoader);
+	IfcGeometry tube = hollowGeometry.GetFlattenedGeometry (18);
+	ASSERT (IsClosedMesh (tube));
+	ASSERT_EQ_EPS (GetVolume (tube), (12.0 * 10 * 24 * 2 * std::sin (CONST_PI / 96)), EPS_SMALL);
+	ASSERT_EQ (hollowGeometry.GetCachedGeometry (18).numPoints, (25 * 16 + 2 * 8));
+}
+
+// walls of 10 x 0.2 x 3 with square openings through them, each wall and opening at its own placement
+class WallIfc
+{
+public:
+	WallIfc ()
+	{
+		_lines << "#10=IFCCARTESIANPOINT((0.,0.,0.));\n"
+			"#11=IFCAXIS2PLACEMENT3D(#10,$,$);\n"
+			"#12=IFCDIRECTION((0.,0.,1.));\n"
+			"#13=IFCDIRECTION((0.,1.,0.));\n"
+			"#14=IFCDIRECTION((1.,0.,0.));\n"
+			"#15=IFCCARTESIANPOINT((5.,0.1));\n"
+			"#16=IFCAXIS2PLACEMENT2D(#15,$);\n"
+			"#17=IFCRECTANGLEPROFILEDEF(.AREA.,$,#16,10.,0.2);\n"
+			"#18=IFCEXTRUDEDAREASOLID(#17,#11,#12,3.);\n"
+			"#19=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#18));\n"
+			"#20=IFCPRODUCTDEFINITIONSHAPE($,$,(#19));\n"
+			"#21=IFCCARTESIANPOINT((0.,0.));\n"
+			"#22=IFCAXIS2PLACEMENT2D(#21,$);\n";
+	}
+
+	//! Returns the express ID of the wall
+	uint32_t AddWall (glm::dvec3 pos)
+	{
+		uint32_t id = NextID ();
+		_lines << "#" << id << "=IFCCARTESIANPOINT((" << pos.x << "," << pos.y << "," << pos.z << "));\n"
+			<< "#" << id + 1 << "=IFCAXIS2PLACEMENT3D(#" << id << ",$,$);\n"
+			<< "#" << id + 2 << "=IFCLOCALPLACEMENT($,#" << id + 1 << ");\n"
+			<< "#" << id + 3 << "=IFCWALL('w',$,$,$,$,#" << id + 2 << ",#20,$,$);\n";
+		return id + 3;
+	}
+
+	//! An opening across the wall, extruded along y and centered on it, at x and z from the placement of the wall
+	void AddOpening (uint32_t wallID, glm::dvec3 wallPos, double x, double z, double size, double depth = 1.2)
+	{
+		uint32_t id = NextID ();
+		_lines << "#" << id << "=IFCRECTANGLEPROFILEDEF(.AREA.,$,#22," << size << "," << size << ");\n"
+			<< "#" << id + 1 << "=IFCEXTRUDEDAREASOLID(#" << id << ",#11,#12," << depth << ");\n"
+			<< "#" << id + 2 << "=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#" << id + 1 << "));\n"
+			<< "#" << id + 3 << "=IFCPRODUCTDEFINITIONSHAPE($,$,(#" << id + 2 << "));\n"
+			<< "#" << id + 4 << "=IFCCARTESIANPOINT((" << wallPos.x + x << "," << wallPos.y + 0.1 - depth / 2 << "," << wallPos.z + z << "));\n"
+			<< "#" << id + 5 << "=IFCAXIS2PLACEMENT3D(#" << id + 4 << ",#13,#14);\n"
+			<< "#" << id + 6 << "=IFCLOCALPLACEMENT($,#" << id + 5 << ");\n"
+			<< "#" << id + 7 << "=IFCOPENINGELEMENT('o',$,$,$,$,#" << id + 6 << ",#" << id + 3 << ",$,$);\n"
+			<< "#" << id + 8 << "=IFCRELVOIDSELEMENT('r',$,$,$,#" << wallID << ",#" << id + 7 << ");\n";
+	}
+
+	std::string GetIfc ()
+	{
+		return MakeIfc (_lines.str ());
+	}
+
+private:
+	uint32_t NextID ()
+	{
+		_nextID += 10;
+		return _nextID;
+	}
+
+	std::stringstream _lines;
+	uint32_t _nextID = 90;
+};
+
+double GetVolume (IfcGeometryLoader& geometryLoader, uint32_t expressID)
+{
+	return GetVolume (geometryLoader.GetFlattenedGeometry (expressID));
+}
+
+TEST (BoolResultCacheModelTest)
+{
+	// the second wall has the same openings at another placement, so it reuses the result of the first
+	WallIfc model;
+	glm::dvec3 secondPos (20, 30, 0);
+	uint32_t first = model.AddWall (glm::dvec3 (0));
+	model.AddOpening (first, glm::dvec3 (0), 2, 1, 1);
+	model.AddOpening (first, glm::dvec3 (0), 6, 1.5, 1);
+	uint32_t second = model.AddWall (secondPos);
+	model.AddOpening (second, secondPos, 2, 1, 1);
+	model.AddOpening (second, secondPos, 6, 1.5, 1);
+
+	LoaderSettings settings;
+	settings.USE_NATIVE_BOOLS = true;
+	settings.BOOL_RESULT_CACHE = true;
+	IfcLoader loader (settings);
+	loader.LoadFile (model.GetIfc ());
+	IfcGeometryLoader geometryLoader (loader);
+
+	ASSERT_EQ_EPS (GetVolume (geometryLoader, first), (6 - 2 * 0.2), EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (geometryLoader, second), (6 - 2 * 0.2), EPS_SMALL);
+	ASSERT_EQ (geometryLoader.GetStatistics ().boolCacheMisses, 1);
+	ASSERT_EQ (geometryLoader.GetStatistics ().boolCacheHits, 1);
+
+	// another engine shares the cache of the model but not its results
+	LoaderSettings fastSettings = settings;
+	fastSettings.USE_NATIVE_BOOLS = false;
+	fastSettings.USE_FAST_BOOLS = true;
+	IfcGeometryLoader fastLoader (loader, fastSettings);
+	fastLoader.ShareBoolResultCache (geometryLoader);
+	GetVolume (fastLoader, first);
+	ASSERT_EQ (fastLoader.GetStatistics ().boolCacheHits, 0);
+
+	IfcGeometryLoader sameLoader (loader, settings);
+	sameLoader.ShareBoolResultCache (geometryLoader);
+	ASSERT_EQ_EPS (GetVolume (sameLoader, first), (6 - 2 * 0.2), EPS_SMALL);
+	ASSERT_EQ (sameLoader.GetStatistics ().boolCacheHits, 1);
+}
+
+TEST (BoolResultCacheRevisionTest)
+{
+	WallIfc model;
+	uint32_t wall = model.AddWall (glm::dvec3 (0));
+	model.AddOpening (wall, glm::dvec3 (0), 2, 1, 1);
+	model.AddOpening (wall, glm::dvec3 (0), 6, 1.5, 1);
+	std::string ifc = model.GetIfc ();
+
+	LoaderSettings settings;
+	settings.USE_NATIVE_BOOLS = true;
+	settings.BOOL_RESULT_CACHE = true;
+
+	// a second revision joins the cache of the first, which is closed before the revision generates anything
+	auto firstLoader = std::make_unique<IfcLoader> (settings);
+	firstLoader->LoadFile (ifc);
+	auto firstGeometry = std::make_unique<IfcGeometryLoader> (*firstLoader);
+	ASSERT_EQ_EPS (GetVolume (*firstGeometry, wall), (6 - 2 * 0.2), EPS_SMALL);
+	ASSERT_EQ (firstGeometry->GetStatistics ().boolCacheMisses, 1);
+
+	IfcLoader revisionLoader (settings);
+	revisionLoader.LoadFile (ifc);
+	IfcGeometryLoader revisionGeometry (revisionLoader);
+	revisionGeometry.ShareBoolResultCache (*firstGeometry);
+	firstGeometry.reset ();
+	firstLoader.reset ();
+
+	ASSERT_EQ_EPS (GetVolume (revisionGeometry, wall), (6 - 2 * 0.2), EPS_SMALL);
+	ASSERT_EQ (revisionGeometry.GetStatistics ().boolCacheHits, 1);
+	ASSERT_EQ (revisionGeometry.GetStatistics ().boolCacheMisses, 0);
+
+	// without sharing the revision starts from an empty cache of its own
+	IfcLoader otherLoader (settings);
+	otherLoader.LoadFile (ifc);
+	IfcGeometryLoader otherGeometry (otherLoader);
+	GetVolume (otherGeometry, wall);
+	ASSERT_EQ (otherGeometry.GetStatistics ().boolCacheHits, 0);
+}
+
+// a 4 x 4 x 0.2 slab with openings through it, and a cylinder of radius 1 and height 1
+const std::string SLAB_IFC = MakeIfc (
+	"#10=IFCCARTESIANPOINT((0.,0.,0.));\n"
+	"#11=IFCAXIS2PLACEMENT3D(#10,$,$);\n"
+	"#12=IFCDIRECTION((0.,0.,1.));\n"
+	"#13=IFCCARTESIANPOINT((0.,0.));\n"
+	"#14=IFCAXIS2PLACEMENT2D(#13,$);\n"
+	"#15=IFCRECTANGLEPROFILEDEF(.AREA.,$,#14,4.,4.);\n"
+	"#16=IFCEXTRUDEDAREASOLID(#15,#11,#12,0.2);\n"
+	"#17=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#16));\n"
+	"#18=IFCPRODUCTDEFINITIONSHAPE($,$,(#17));\n"
+	"#19=IFCLOCALPLACEMENT($,#11);\n"
+	"#20=IFCSLAB('s',$,$,$,$,#19,#18,$,$);\n"
+	"#30=IFCRECTANGLEPROFILEDEF(.AREA.,$,#14,0.1,0.1);\n"
+	"#31=IFCCARTESIANPOINT((1.,1.,-0.1));\n"
+	"#32=IFCAXIS2PLACEMENT3D(#31,$,$);\n"
+	"#33=IFCEXTRUDEDAREASOLID(#30,#32,#12,0.4);\n"
+	"#34=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#33));\n"
+	"#35=IFCPRODUCTDEFINITIONSHAPE($,$,(#34));\n"
+	"#36=IFCOPENINGELEMENT('o',$,$,$,$,#19,#35,$,$);\n"
+	"#37=IFCRELVOIDSELEMENT('r',$,$,$,#20,#36);\n"
+	"#40=IFCRECTANGLEPROFILEDEF(.AREA.,$,#14,1.,1.);\n"
+	"#41=IFCCARTESIANPOINT((-1.,-1.,-0.1));\n"
+	"#42=IFCAXIS2PLACEMENT3D(#41,$,$);\n"
+	"#43=IFCEXTRUDEDAREASOLID(#40,#42,#12,0.4);\n"
+	"#44=IFCSHAPEREPRESENTATION($,'Body','SweptSolid',(#43));\n"
+	"#45=IFCPRODUCTDEFINITIONSHAPE($,$,(#44));\n"
+	"#46=IFCOPENINGELEMENT('o',$,$,$,$,#19,#45,$,$);\n"
+	"#47=IFCRELVOIDSELEMENT('r',$,$,$,#20,#46);\n"
+	"#50=IFCCIRCLEPROFILEDEF(.AREA.,$,#14,1.);\n"
+	"#51=IFCEXTRUDEDAREASOLID(#50,#11,#12,1.);\n");
+
+// area of a circle of radius 1 tessellated with the given number of segments
+double GetPolygonArea (int segments)
+{
+	return segments / 2.0 * std::sin (CONST_PI * 2 / segments);
+}
+
+TEST (LevelOfDetailTest)
+{
+	// a coarse level next to the model, set up like AddLevelOfDetail does
+	LoaderSettings settings;
+	settings.USE_NATIVE_BOOLS = true;
+	settings.BOOL_RESULT_CACHE = true;
+	settings.ADAPTIVE_TESSELLATION = true;
+	LoaderSettings coarse = settings;
+	coarse.MIN_VOID_SIZE_M = 0.5;
+	coarse.CHORD_TOLERANCE_M = 0.05;
+
+	// openings extruded across the wall go through the boolean, the small one only on the model
+	WallIfc walls;
+	uint32_t wall = walls.AddWall (glm::dvec3 (0));
+	walls.AddOpening (wall, glm::dvec3 (0), 2, 1, 1);
+	walls.AddOpening (wall, glm::dvec3 (0), 6, 1.5, 0.1, 0.4);
+
+	IfcLoader wallLoader (settings);
+	wallLoader.LoadFile (walls.GetIfc ());
+	IfcGeometryLoader wallGeometry (wallLoader);
+	IfcGeometryLoader wallLevel (wallLoader, coarse);
+	wallLevel.ShareBoolResultCache (wallGeometry);
+
+	ASSERT_EQ_EPS (GetVolume (wallGeometry, wall), (6 - 0.2 - 0.002), EPS_SMALL);
+	ASSERT_EQ (wallGeometry.GetStatistics ().skippedVoids, 0);
+	// the shared cache has no result without the small opening
+	ASSERT_EQ_EPS (GetVolume (wallLevel, wall), (6 - 0.2), EPS_SMALL);
+	ASSERT_EQ (wallLevel.GetStatistics ().skippedVoids, 1);
+	ASSERT_EQ (wallLevel.GetStatistics ().boolCacheHits, 0);
+
+	// openings along the extrusion of the slab become holes in its profile, or are left out
+	IfcLoader slabLoader (settings);
+	slabLoader.LoadFile (SLAB_IFC);
+	IfcGeometryLoader slabGeometry (slabLoader);
+	IfcGeometryLoader slabLevel (slabLoader, coarse);
+
+	ASSERT_EQ_EPS (GetVolume (slabGeometry, 20), (3.2 - 0.2 - 0.002), EPS_SMALL);
+	ASSERT_EQ (slabGeometry.GetStatistics ().coaxialOpenings, 2);
+	ASSERT_EQ_EPS (GetVolume (slabLevel, 20), (3.2 - 0.2), EPS_SMALL);
+	ASSERT_EQ (slabLevel.GetStatistics ().coaxialOpenings, 1);
+	ASSERT_EQ (slabLevel.GetStatistics ().skippedVoids, 1);
+
+	// 32 segments keep a circle of 1 m within 5 mm, 10 within 5 cm
+	ASSERT_EQ_EPS (GetVolume (slabGeometry, 51), GetPolygonArea (32), EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (slabLevel, 51), GetPolygonArea (10), EPS_SMALL);
+}
+
+TEST (FloatStorageTest)
+{
+	// far from the origin floats only resolve about 6 cm, relative to the center of the bounds they keep well below a millimetre
+	IfcGeometry box = GetBoxGeometry (glm::dvec3 (1e6, 2e6, 10), glm::dvec3 (1e6 + 10.123, 2e6 + 0.2, 13.001));
+	IfcGeometry floats = box;
+	floats.ConvertToFloatStorage ();
+	ASSERT (floats.isFloatStorage);
+	ASSERT (floats.vertexData.empty ());
+	ASSERT (equals (floats.origin, glm::dvec3 (1e6 + 5.0615, 2e6 + 0.1, 11.5005), EPS_SMALL));
+	for (uint32_t i = 0; i < box.numPoints; i++)
+	{
+		ASSERT (equals (floats.GetPoint (i), box.GetPoint (i), 1e-5));
+		ASSERT (equals (floats.GetNormal (i), box.GetNormal (i), EPS_SMALL));
+	}
+
+	// later points go to the float buffer as well
+	glm::dvec3 a (1e6 + 1, 2e6 + 1, 10);
+	glm::dvec3 b (1e6 + 2, 2e6 + 1, 10);
+	glm::dvec3 c (1e6 + 1, 2e6 + 2, 10);
+	floats.AddFace (a, b, c);
+	ASSERT (floats.vertexData.empty ());
+	ASSERT_EQ (floats.fvertexData.size (), floats.numPoints * VERTEX_FORMAT_SIZE_FLOATS);
+	ASSERT (equals (floats.GetPoint (floats.numPoints - 1), c, 1e-5));
+
+	// placed with the origin in the transformation, the float vertices land where the doubles do
+	IfcLoader reference;
+	reference.LoadFile (EXTRUSION_IFC);
+	IfcGeometryLoader referenceGeometry (reference);
+	IfcPlacedGeometry referencePlaced = referenceGeometry.GetFlatMesh (16).geometries[0];
+	IfcGeometry& referenceGeom = referenceGeometry.GetCachedGeometry (16);
+
+	LoaderSettings settings;
+	settings.FLOAT_VERTEX_STORAGE = true;
+	IfcLoader loader (settings);
+	loader.LoadFile (EXTRUSION_IFC);
+	IfcGeometryLoader geometryLoader (loader);
+	IfcPlacedGeometry placed = geometryLoader.GetFlatMesh (16).geometries[0];
+	IfcGeometry& geom = geometryLoader.GetCachedGeometry (16);
+	ASSERT (geom.isFloatStorage);
+	ASSERT_EQ (geom.numPoints, referenceGeom.numPoints);
+	ASSERT (placed.transformation == referencePlaced.transformation * glm::translate (geom.origin));
+
+	for (uint32_t i = 0; i < geom.numPoints; i++)
+	{
+		const float* v = &geom.fvertexData[i * VERTEX_FORMAT_SIZE_FLOATS];
+		glm::dvec3 pt = placed.transformation * glm::dvec4 (v[0], v[1], v[2], 1);
+		glm::dvec3 expected = referencePlaced.transformation * glm::dvec4 (referenceGeom.GetPoint (i), 1);
+		ASSERT (equals (pt, expected, 1e-5));
+	}
+}
+
+TEST (WeldVerticesTest)
+{
+	// every corner of a box is a crease, so only the vertices of each side are merged
+	IfcGeometry box = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+	ASSERT_EQ (box.numPoints, 36);
+	IfcGeometry sides = WeldVertices (box, 1e-6, glm::radians (20.0));
+	ASSERT_EQ (sides.numPoints, 24);
+	ASSERT_EQ (sides.numFaces, 12);
+	ASSERT_EQ_EPS (GetVolume (sides), 1.0, EPS_SMALL);
+	for (uint32_t i = 0; i < sides.numPoints; i++)
+	{
+		glm::dvec3 n = sides.GetNormal (i);
+		ASSERT_EQ_EPS (std::fabs (n.x) + std::fabs (n.y) + std::fabs (n.z), 1.0, EPS_SMALL);
+	}
+
+	// without a crease angle the corners are shared and their normals averaged
+	IfcGeometry smooth = WeldVertices (box, 1e-6, glm::radians (180.0));
+	ASSERT_EQ (smooth.numPoints, 8);
+	ASSERT_EQ (smooth.numFaces, 12);
+	ASSERT_EQ_EPS (GetVolume (smooth), 1.0, EPS_SMALL);
+
+	// a triangle with two corners closer than the tolerance collapses and is dropped
+	IfcGeometry sliver;
+	sliver.AddFace (glm::dvec3 (0, 0, 0), glm::dvec3 (1, 0, 0), glm::dvec3 (0, 1, 0));
+	sliver.AddFace (glm::dvec3 (1, 0, 0), glm::dvec3 (0, 1, 0), glm::dvec3 (1, 5e-4, 0));
+	IfcGeometry welded = WeldVertices (sliver, 1e-3, glm::radians (180.0));
+	ASSERT_EQ (welded.numFaces, 1);
+	ASSERT_EQ (welded.numPoints, 3);
+
+	// points far apart stay apart, even where cell coordinates agree in their low bits
+	ASSERT_NEQ (WeldCellKey (0, 0, 0), WeldCellKey (1LL << 21, 0, 0));
+	ASSERT_NEQ (WeldCellKey (0, 0, 0), WeldCellKey (0, 0, 1LL << 42));
+	IfcGeometry distant;
+	distant.AddFace (glm::dvec3 (0, 0, 0), glm::dvec3 (1, 0, 0), glm::dvec3 (0, 1, 0));
+	distant.AddFace (glm::dvec3 (2.097152, 0, 0), glm::dvec3 (3.097152, 0, 0), glm::dvec3 (2.097152, 1, 0));
+	ASSERT_EQ (WeldVertices (distant, 1e-6, glm::radians (20.0)).numPoints, 6);
+}
+
+// a unit cube as IFCTRIANGULATEDFACESET #30, corner i takes max in x, y and z for bits 0, 1 and 2
+const std::string CUBE_TRIANGLES = "((1,3,4),(1,4,2),(5,6,8),(5,8,7),(1,2,6),(1,6,5),(3,7,8),(3,8,4),(1,5,7),(1,7,3),(2,4,8),(2,8,6))";
+const std::string CUBE_POINTS = "((0.,0.,0.),(1.,0.,0.),(0.,1.,0.),(1.,1.,0.),(0.,0.,1.),(1.,0.,1.),(0.,1.,1.),(1.,1.,1.))";
+
+IfcGeometry GetFaceSetGeometry (const std::string& points, const std::string& normals, const std::string& lastArgument)
+{
+	IfcLoader loader;
+	loader.LoadFile (MakeIfc (
+		"#10=IFCCARTESIANPOINTLIST3D(" + points + ");\n"
+		"#30=IFCTRIANGULATEDFACESET(#10," + normals + ",.T.," + CUBE_TRIANGLES + "," + lastArgument + ");\n"));
+	IfcGeometryLoader geometryLoader (loader);
+	return geometryLoader.GetCachedGeometry (geometryLoader.GetMesh (30)->expressID);
+}
+
+// corners of each face of the geometry are at the same points as the triangles of the flat reference
+bool HasTrianglesOf (const IfcGeometry& geom, const IfcGeometry& flat, bool compareNormals)
+{
+	if (geom.numFaces != flat.numFaces)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < geom.numFaces; i++)
+	{
+		Face f = geom.GetFace (i);
+		int corners[3] = { f.i0, f.i1, f.i2 };
+		for (int k = 0; k < 3; k++)
+		{
+			if (!equals (geom.GetPoint (corners[k]), flat.GetPoint (i * 3 + k), EPS_SMALL) ||
+				(compareNormals && !equals (geom.GetNormal (corners[k]), flat.GetNormal (i * 3 + k), EPS_SMALL)))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+TEST (TriangulatedFaceSetTest)
+{
+	// a face per triangle with its own vertices, the way face sets were read before they kept their indices
+	IfcGeometry flat;
+	std::vector<glm::dvec3> corners;
+	for (int i = 0; i < 8; i++)
+	{
+		corners.push_back (glm::dvec3 (i & 1, (i >> 1) & 1, (i >> 2) & 1));
+	}
+	const uint32_t triangles[12][3] = { { 1, 3, 4 }, { 1, 4, 2 }, { 5, 6, 8 }, { 5, 8, 7 }, { 1, 2, 6 }, { 1, 6, 5 }, { 3, 7, 8 }, { 3, 8, 4 }, { 1, 5, 7 }, { 1, 7, 3 }, { 2, 4, 8 }, { 2, 8, 6 } };
+	for (auto& t : triangles)
+	{
+		flat.AddFace (corners[t[0] - 1], corners[t[1] - 1], corners[t[2] - 1]);
+	}
+	ASSERT_EQ_EPS (GetVolume (flat), 1.0, EPS_SMALL);
+
+	// computed normals don't cross the edges of the cube
+	IfcGeometry computed = GetFaceSetGeometry (CUBE_POINTS, "$", "$");
+	ASSERT_EQ (computed.numPoints, 24);
+	ASSERT (HasTrianglesOf (computed, flat, true));
+
+	// CoordIndex refers to PnIndex, which picks the points from a longer, shuffled list
+	IfcGeometry pn = GetFaceSetGeometry ("((9.,9.,9.),(1.,1.,1.),(0.,1.,1.),(1.,0.,1.),(0.,0.,1.),(1.,1.,0.),(0.,1.,0.),(1.,0.,0.),(0.,0.,0.))", "$", "(9,8,7,6,5,4,3,2)");
+	ASSERT_EQ (pn.numPoints, 24);
+	ASSERT (HasTrianglesOf (pn, flat, true));
+
+	// a normal per point, passed through with CoordIndex as the index buffer
+	IfcGeometry shared = GetFaceSetGeometry (CUBE_POINTS, CUBE_POINTS, "$");
+	ASSERT_EQ (shared.numPoints, 8);
+	ASSERT (HasTrianglesOf (shared, flat, false));
+	for (uint32_t i = 0; i < 12 * 3; i++)
+	{
+		ASSERT_EQ (shared.indexData[i], triangles[i / 3][i % 3] - 1);
+	}
+	ASSERT (equals (shared.GetNormal (7), glm::normalize (glm::dvec3 (1)), EPS_SMALL));
+	ASSERT (shared.GetNormal (0) == glm::dvec3 (0));
+
+	// a normal per corner, one vertex for each pair of point and normal
+	IfcGeometry perCorner = GetFaceSetGeometry (CUBE_POINTS, "((0.,0.,-1.),(0.,0.,1.),(0.,-1.,0.),(0.,1.,0.),(-1.,0.,0.),(1.,0.,0.))",
+		"((1,1,1),(1,1,1),(2,2,2),(2,2,2),(3,3,3),(3,3,3),(4,4,4),(4,4,4),(5,5,5),(5,5,5),(6,6,6),(6,6,6))");
+	ASSERT_EQ (perCorner.numPoints, 24);
+	ASSERT (HasTrianglesOf (perCorner, flat, true));
+}
+
+// the exact test on every pair of triangles, as intersectMeshMesh did before its broad phase
+void FindAllPairsIntersections (const IfcGeometry& mesh1, const IfcGeometry& mesh2, MeshIntersections& meshIntersections1, MeshIntersections& meshIntersections2)
+{
+	for (uint32_t i = 0; i < mesh1.numFaces; i++)
+	{
+		Face t1 = mesh1.GetFace (i);
+		for (uint32_t j = 0; j < mesh2.numFaces; j++)
+		{
+			Face t2 = mesh2.GetFace (j);
+			TriTriResult line = intersect_triangle_triangle (mesh1.GetPoint (t1.i0), mesh1.GetPoint (t1.i1), mesh1.GetPoint (t1.i2),
+				mesh2.GetPoint (t2.i0), mesh2.GetPoint (t2.i1), mesh2.GetPoint (t2.i2));
+			if (line.hasIntersection)
+			{
+				meshIntersections1[i].push_back ({ line, j });
+				meshIntersections2[j].push_back ({ line, i });
+			}
+		}
+	}
+}
+
+bool IsEqualIntersections (const MeshIntersections& a, const MeshIntersections& b)
+{
+	if (a.size () != b.size ())
+	{
+		return false;
+	}
+
+	for (auto& triangle : a)
+	{
+		auto it = b.find (triangle.first);
+		if (it == b.end () || it->second.size () != triangle.second.size ())
+		{
+			return false;
+		}
+
+		for (size_t k = 0; k < triangle.second.size (); k++)
+		{
+			auto& x = triangle.second[k];
+			auto& y = it->second[k];
+			if (x.otherTriangleIndex != y.otherTriangleIndex || x.result.start != y.result.start || x.result.end != y.result.end)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+TEST (IntersectMeshMeshTest)
+{
+	IfcGeometry cube = GetBoxGeometry (glm::dvec3 (0), glm::dvec3 (1));
+	IfcGeometry turned = TransformGeometry (GetBoxGeometry (glm::dvec3 (0.5), glm::dvec3 (1.5)), glm::rotate (0.5, glm::dvec3 (0.2, 0.3, 1)));
+	IfcGeometry separate = GetBoxGeometry (glm::dvec3 (3), glm::dvec3 (4));
+
+	// the broad phase finds the same pairs as testing all of them, in the same order
+	for (auto* other : { &turned, &separate })
+	{
+		MeshIntersections found1;
+		MeshIntersections found2;
+		findMeshIntersections (cube, *other, found1, found2);
+
+		MeshIntersections expected1;
+		MeshIntersections expected2;
+		FindAllPairsIntersections (cube, *other, expected1, expected2);
+
+		ASSERT (IsEqualIntersections (found1, expected1));
+		ASSERT (IsEqualIntersections (found2, expected2));
+		ASSERT_EQ (found1.empty (), (other == &separate));
+	}
+
+	// meshes that don't touch come out as they went in
+	IfcGeometry result1;
+	IfcGeometry result2;
+	intersectMeshMesh (cube, separate, result1, result2);
+	ASSERT_EQ (result1.numFaces, cube.numFaces);
+	ASSERT_EQ (result2.numFaces, separate.numFaces);
+}
+
+TEST (MakeCuttersTest)
+{
+	IfcGeometry wall = GetBoxGeometry (glm::dvec3 (0, 0, 0), glm::dvec3 (10, 1, 3));
+
+	// five openings through the wall, the last one overlapping the first, and two that miss it
+	std::vector<IfcGeometry> voids;
+	for (int i = 0; i < 4; i++)
+	{
+		voids.push_back (GetBoxGeometry (glm::dvec3 (1 + i * 2, -0.5, 1), glm::dvec3 (2 + i * 2, 1.5, 2)));
+	}
+	voids.push_back (GetBoxGeometry (glm::dvec3 (1.5, -0.5, 1.5), glm::dvec3 (2.5, 1.5, 2.5)));
+	voids.push_back (GetBoxGeometry (glm::dvec3 (20, 0, 0), glm::dvec3 (21, 1, 1)));
+	voids.push_back (IfcGeometry ());
+
+	uint32_t culled = 0;
+	std::vector<IfcGeometry> cutters = makeCutters (wall, voids, 2, culled);
+	ASSERT_EQ (culled, 2);
+
+	// no group goes over the limit, and the void that touches the first one starts a group of its own
+	ASSERT_EQ (cutters.size (), 3);
+	ASSERT_EQ (cutters[0].numFaces, 24);
+	ASSERT_EQ (cutters[1].numFaces, 24);
+	ASSERT_EQ (cutters[2].numFaces, 12);
+	AABB lastBox = GetAABB (cutters[2]);
+	ASSERT (lastBox.min == glm::dvec3 (1.5, -0.5, 1.5) && lastBox.max == glm::dvec3 (2.5, 1.5, 2.5));
+
+	// subtracting the groups gives the same solid as subtracting one void after the other
+	IfcGeometry sequential = wall;
+	for (auto& v : voids)
+	{
+		if (v.numFaces > 0)
+		{
+			sequential = meshBoolean (sequential, v, BoolOperation::DIFFERENCE);
+		}
+	}
+
+	IfcGeometry grouped = wall;
+	for (auto& cutter : cutters)
+	{
+		grouped = meshBoolean (grouped, cutter, BoolOperation::DIFFERENCE);
+	}
+
+	// 30 minus four openings of 1 and the part of the fifth outside the first
+	ASSERT_EQ_EPS (GetVolume (sequential), (30 - 4 - 0.75), EPS_SMALL);
+	ASSERT_EQ_EPS (GetVolume (grouped), GetVolume (sequential), EPS_SMALL);
+}
@@ -18,6 +18,10 @@
 
 std::map<uint32_t, std::unique_ptr<webifc::IfcLoader>> loaders;
 std::map<uint32_t, std::unique_ptr<webifc::IfcGeometryLoader>> geomLoaders;
+// extra levels of detail of a model, level 0 is the geometry loader of the model itself
+std::map<uint32_t, std::vector<std::unique_ptr<webifc::IfcGeometryLoader>>> lodLoaders;
+// box proxies of a model, only alive while StreamAllMeshesProgressive runs
+std::map<uint32_t, std::unique_ptr<webifc::IfcGeometryLoader>> proxyLoaders;
 
 uint32_t GLOBAL_MODEL_ID_COUNTER = 0;
 
@@ -76,6 +80,8 @@ int CreateModel(webifc::LoaderSettings settings)
 
 void CloseModel(uint32_t modelID)
 {
+    proxyLoaders.erase(modelID);
+    lodLoaders.erase(modelID);
     geomLoaders.erase(modelID);
     loaders.erase(modelID);
 }
@@ -93,6 +99,11 @@ webifc::IfcFlatMesh GetFlatMesh(uint32_t modelID, uint32_t expressID)
     
     for (auto& geom : mesh.geometries)
     {
+        if (geom.isParametric)
+        {
+            continue;
+        }
+
         auto& flatGeom = geomLoader->GetCachedGeometry(geom.geometryExpressID);
         flatGeom.GetVertexData();
     }
@@ -117,6 +128,11 @@ void StreamMeshes(uint32_t modelID, std::vector<uint32_t> expressIds, emscripten
         // prepare the geometry data
         for (auto& geom : mesh.geometries)
         {
+            if (geom.isParametric)
+            {
+                continue;
+            }
+
             auto& flatGeom = geomLoader->GetCachedGeometry(geom.geometryExpressID);
             flatGeom.GetVertexData();
         }   
@@ -125,6 +141,7 @@ void StreamMeshes(uint32_t modelID, std::vector<uint32_t> expressIds, emscripten
         callback(mesh);
 
         // clear geometry, freeing memory, client is expected to have consumed the data
+        // instanced geometry is kept, and can be retrieved later with GetGeometry
         geomLoader->ClearCachedGeometry();
     }
 }
@@ -151,6 +168,190 @@ void StreamAllMeshes(uint32_t modelID, emscripten::val callback) {
     }
 }
 
+webifc::IfcGeometryLoader* GetLevelLoader(uint32_t modelID, uint32_t level)
+{
+    if (level == 0)
+    {
+        return geomLoaders[modelID].get();
+    }
+
+    auto& levels = lodLoaders[modelID];
+    if (level > levels.size())
+    {
+        return nullptr;
+    }
+
+    return levels[level - 1].get();
+}
+
+// the settings only change how geometry is generated, the model keeps the settings it was opened with
+uint32_t AddLevelOfDetail(uint32_t modelID, webifc::LoaderSettings settings)
+{
+    auto& loader = loaders[modelID];
+    auto& geomLoader = geomLoaders[modelID];
+    if (!loader || !geomLoader)
+    {
+        return 0;
+    }
+
+    auto levelLoader = std::make_unique<webifc::IfcGeometryLoader>(*loader, settings);
+    levelLoader->SetTransformation(geomLoader->GetTransformation());
+    levelLoader->ShareBoolResultCache(*geomLoader);
+
+    auto& levels = lodLoaders[modelID];
+    levels.push_back(std::move(levelLoader));
+    return levels.size();
+}
+
+// a revision of a model reuses the boolean results of the other, which stay alive after the other is closed
+void ShareBoolResultCache(uint32_t modelID, uint32_t sourceModelID)
+{
+    auto& geomLoader = geomLoaders[modelID];
+    auto& sourceLoader = geomLoaders[sourceModelID];
+    if (!geomLoader || !sourceLoader)
+    {
+        return;
+    }
+
+    geomLoader->ShareBoolResultCache(*sourceLoader);
+    for (auto& levelLoader : lodLoaders[modelID])
+    {
+        levelLoader->ShareBoolResultCache(*geomLoader);
+    }
+}
+
+webifc::IfcFlatMesh GetFlatMeshLevel(uint32_t modelID, uint32_t level, uint32_t expressID)
+{
+    auto geomLoader = GetLevelLoader(modelID, level);
+    if (!geomLoader)
+    {
+        return {};
+    }
+
+    // all levels are moved by the same offset with COORDINATE_TO_ORIGIN
+    auto& modelLoader = geomLoaders[modelID];
+    geomLoader->SyncCoordination(*modelLoader);
+    webifc::IfcFlatMesh mesh = geomLoader->GetFlatMesh(expressID);
+    geomLoader->SyncCoordination(*modelLoader);
+
+    for (auto& geom : mesh.geometries)
+    {
+        if (geom.isParametric)
+        {
+            continue;
+        }
+
+        auto& flatGeom = geomLoader->GetCachedGeometry(geom.geometryExpressID);
+        flatGeom.GetVertexData();
+    }
+
+    return mesh;
+}
+
+// every level of an element is generated before moving on to the next element
+void StreamMeshLevels(uint32_t modelID, std::vector<uint32_t> expressIds, emscripten::val callback)
+{
+    auto& loader = loaders[modelID];
+    if (!loader || !geomLoaders[modelID])
+    {
+        return;
+    }
+
+    uint32_t numLevels = lodLoaders[modelID].size() + 1;
+
+    for (const auto& id : expressIds)
+    {
+        for (uint32_t level = 0; level < numLevels; level++)
+        {
+            webifc::IfcFlatMesh mesh = GetFlatMeshLevel(modelID, level, id);
+
+            // geometry of this level is alive for the time of the callback, fetch it with GetLevelGeometry
+            callback(mesh, level);
+
+            GetLevelLoader(modelID, level)->ClearCachedGeometry();
+        }
+    }
+}
+
+void StreamAllMeshLevels(uint32_t modelID, emscripten::val callback)
+{
+    auto& loader = loaders[modelID];
+    if (!loader || !geomLoaders[modelID])
+    {
+        return;
+    }
+
+    for (auto type : ifc2x4::IfcElements)
+    {
+        if (type == ifc2x4::IFCOPENINGELEMENT || type == ifc2x4::IFCSPACE || type == ifc2x4::IFCOPENINGSTANDARDCASE)
+        {
+            continue;
+        }
+
+        StreamMeshLevels(modelID, loader->GetExpressIDsWithType(type), callback);
+    }
+}
+
+// first every element as boxes around its parts, without any booleans, then every element with its final mesh
+// both passes report the element's expressID so the client can swap the proxy for the final mesh
+void StreamAllMeshesProgressive(uint32_t modelID, emscripten::val callback)
+{
+    auto& loader = loaders[modelID];
+    auto& geomLoader = geomLoaders[modelID];
+
+    if (!loader || !geomLoader)
+    {
+        return;
+    }
+
+    webifc::LoaderSettings proxySettings = loader->GetSettings();
+    proxySettings.GEOMETRY_PROXIES = true;
+
+    auto& proxyLoader = proxyLoaders[modelID];
+    proxyLoader = std::make_unique<webifc::IfcGeometryLoader>(*loader, proxySettings);
+    proxyLoader->SetTransformation(geomLoader->GetTransformation());
+    proxyLoader->SyncCoordination(*geomLoader);
+
+    for (bool proxies : { true, false })
+    {
+        auto& passLoader = proxies ? proxyLoader : geomLoader;
+
+        for (auto type : ifc2x4::IfcElements)
+        {
+            if (type == ifc2x4::IFCOPENINGELEMENT || type == ifc2x4::IFCSPACE || type == ifc2x4::IFCOPENINGSTANDARDCASE)
+            {
+                continue;
+            }
+
+            for (auto id : loader->GetExpressIDsWithType(type))
+            {
+                // proxies and final meshes are moved by the same offset with COORDINATE_TO_ORIGIN
+                passLoader->SyncCoordination(*proxyLoader);
+                webifc::IfcFlatMesh mesh = passLoader->GetFlatMesh(id);
+                passLoader->SyncCoordination(*proxyLoader);
+
+                for (auto& geom : mesh.geometries)
+                {
+                    if (geom.isParametric)
+                    {
+                        continue;
+                    }
+
+                    auto& flatGeom = passLoader->GetCachedGeometry(geom.geometryExpressID);
+                    flatGeom.GetVertexData();
+                }
+
+                // proxy geometry is fetched with GetProxyGeometry, final geometry with GetGeometry
+                callback(mesh, proxies);
+
+                passLoader->ClearCachedGeometry();
+            }
+        }
+    }
+
+    proxyLoaders.erase(modelID);
+}
+
 std::vector<webifc::IfcFlatMesh> LoadAllGeometry(uint32_t modelID)
 {
     auto& loader = loaders[modelID];
@@ -177,6 +378,11 @@ std::vector<webifc::IfcFlatMesh> LoadAllGeometry(uint32_t modelID)
             webifc::IfcFlatMesh mesh = geomLoader->GetFlatMesh(elements[i]);
             for (auto& geom : mesh.geometries)
             {
+                if (geom.isParametric)
+                {
+                    continue;
+                }
+
                 auto& flatGeom = geomLoader->GetCachedGeometry(geom.geometryExpressID);
                 flatGeom.GetVertexData();
             }   
@@ -198,6 +404,51 @@ webifc::IfcGeometry GetGeometry(uint32_t modelID, uint32_t expressID)
     return geomLoader->GetCachedGeometry(expressID);
 }
 
+webifc::IfcGeometry GetProxyGeometry(uint32_t modelID, uint32_t expressID)
+{
+    auto& proxyLoader = proxyLoaders[modelID];
+    if (!proxyLoader)
+    {
+        return {};
+    }
+
+    return proxyLoader->GetCachedGeometry(expressID);
+}
+
+webifc::IfcGeometry GetLevelGeometry(uint32_t modelID, uint32_t level, uint32_t expressID)
+{
+    auto geomLoader = GetLevelLoader(modelID, level);
+    if (!geomLoader)
+    {
+        return {};
+    }
+
+    return geomLoader->GetCachedGeometry(expressID);
+}
+
+// extrusion record of a placed geometry with isParametric set, alive as long as its geometry would be
+std::vector<double> GetParametricGeometry(uint32_t modelID, uint32_t expressID)
+{
+    auto& geomLoader = geomLoaders[modelID];
+    if (!geomLoader)
+    {
+        return {};
+    }
+
+    return geomLoader->GetParametricGeometry(expressID);
+}
+
+std::vector<uint32_t> GetInstancedGeometryIDs(uint32_t modelID)
+{
+    auto& geomLoader = geomLoaders[modelID];
+    if (!geomLoader)
+    {
+        return {};
+    }
+
+    return geomLoader->GetInstancedGeometryIDs();
+}
+
 void SetGeometryTransformation(uint32_t modelID, std::array<double, 16> m)
 {
     auto& geomLoader = geomLoaders[modelID];
@@ -218,6 +469,10 @@ void SetGeometryTransformation(uint32_t modelID, std::array<double, 16> m)
     transformation[3] = v4;
 
     geomLoaders[modelID]->SetTransformation(transformation);
+    for (auto& levelLoader : lodLoaders[modelID])
+    {
+        levelLoader->SetTransformation(transformation);
+    }
 }
 
 std::vector<uint32_t> GetLineIDsWithType(uint32_t modelID, uint32_t type)
@@ -228,7 +483,7 @@ std::vector<uint32_t> GetLineIDsWithType(uint32_t modelID, uint32_t type)
         return {};
     }
 
-    auto lineIDs = loader->GetLineIDsWithType(type);
+    auto& lineIDs = loader->GetLineIDsWithType(type);
     std::vector<uint32_t> expressIDs;
     for (auto lineID : lineIDs)
     {
@@ -422,6 +677,23 @@ void WriteLine(uint32_t modelID, uint32_t expressID, uint32_t type, emscripten::
     uint32_t end = _tape.GetTotalSize();
 
     loader->UpdateLineTape(expressID, type, start, end);
+
+    auto& geomLoader = geomLoaders[modelID];
+    if (geomLoader)
+    {
+        geomLoader->InvalidateCachedPlacements(type);
+        geomLoader->ClearCachedProfiles();
+        geomLoader->ClearDeduplicatedGeometry();
+        geomLoader->ClearInstancedGeometry();
+    }
+
+    for (auto& levelLoader : lodLoaders[modelID])
+    {
+        levelLoader->InvalidateCachedPlacements(type);
+        levelLoader->ClearCachedProfiles();
+        levelLoader->ClearDeduplicatedGeometry();
+        levelLoader->ClearInstancedGeometry();
+    }
 }
 
 template<uint32_t N>
@@ -622,6 +894,21 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .field("CIRCLE_SEGMENTS_LOW", &webifc::LoaderSettings::CIRCLE_SEGMENTS_LOW)
         .field("CIRCLE_SEGMENTS_MEDIUM", &webifc::LoaderSettings::CIRCLE_SEGMENTS_MEDIUM)
         .field("CIRCLE_SEGMENTS_HIGH", &webifc::LoaderSettings::CIRCLE_SEGMENTS_HIGH)
+        .field("GEOMETRY_INSTANCING", &webifc::LoaderSettings::GEOMETRY_INSTANCING)
+        .field("GEOMETRY_DEDUPLICATION", &webifc::LoaderSettings::GEOMETRY_DEDUPLICATION)
+        .field("WELD_VERTICES", &webifc::LoaderSettings::WELD_VERTICES)
+        .field("WELD_TOLERANCE_M", &webifc::LoaderSettings::WELD_TOLERANCE_M)
+        .field("WELD_CREASE_ANGLE_DEG", &webifc::LoaderSettings::WELD_CREASE_ANGLE_DEG)
+        .field("FLOAT_VERTEX_STORAGE", &webifc::LoaderSettings::FLOAT_VERTEX_STORAGE)
+        .field("USE_NATIVE_BOOLS", &webifc::LoaderSettings::USE_NATIVE_BOOLS)
+        .field("BOOL_RESULT_CACHE", &webifc::LoaderSettings::BOOL_RESULT_CACHE)
+        .field("BOOL_RESULT_CACHE_MB", &webifc::LoaderSettings::BOOL_RESULT_CACHE_MB)
+        .field("ADAPTIVE_TESSELLATION", &webifc::LoaderSettings::ADAPTIVE_TESSELLATION)
+        .field("CHORD_TOLERANCE_M", &webifc::LoaderSettings::CHORD_TOLERANCE_M)
+        .field("ANGLE_TOLERANCE_DEG", &webifc::LoaderSettings::ANGLE_TOLERANCE_DEG)
+        .field("MIN_VOID_SIZE_M", &webifc::LoaderSettings::MIN_VOID_SIZE_M)
+        .field("GEOMETRY_PROXIES", &webifc::LoaderSettings::GEOMETRY_PROXIES)
+        .field("PARAMETRIC_EXTRUSIONS", &webifc::LoaderSettings::PARAMETRIC_EXTRUSIONS)
         ;
 
     emscripten::value_array<std::array<double, 16>>("array_double_16")
@@ -647,6 +934,7 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .field("color", &webifc::IfcPlacedGeometry::color)
         .field("flatTransformation", &webifc::IfcPlacedGeometry::flatTransformation)
         .field("geometryExpressID", &webifc::IfcPlacedGeometry::geometryExpressID)
+        .field("isParametric", &webifc::IfcPlacedGeometry::isParametric)
         ;
 
     emscripten::register_vector<webifc::IfcPlacedGeometry>("IfcPlacedGeometryVector");
@@ -658,6 +946,7 @@ EMSCRIPTEN_BINDINGS(my_module) {
 
     emscripten::register_vector<webifc::IfcFlatMesh>("IfcFlatMeshVector");
     emscripten::register_vector<uint32_t>("UintVector");
+    emscripten::register_vector<double>("DoubleVector");
 
     emscripten::function("LoadAllGeometry", &LoadAllGeometry);
     emscripten::function("OpenModel", &OpenModel);
@@ -665,9 +954,19 @@ EMSCRIPTEN_BINDINGS(my_module) {
     emscripten::function("CloseModel", &CloseModel);
     emscripten::function("IsModelOpen", &IsModelOpen);
     emscripten::function("GetGeometry", &GetGeometry);
+    emscripten::function("GetInstancedGeometryIDs", &GetInstancedGeometryIDs);
+    emscripten::function("GetParametricGeometry", &GetParametricGeometry);
     emscripten::function("GetFlatMesh", &GetFlatMesh);
     emscripten::function("StreamMeshes", &StreamMeshes);
     emscripten::function("StreamAllMeshes", &StreamAllMeshes);
+    emscripten::function("StreamAllMeshesProgressive", &StreamAllMeshesProgressive);
+    emscripten::function("GetProxyGeometry", &GetProxyGeometry);
+    emscripten::function("AddLevelOfDetail", &AddLevelOfDetail);
+    emscripten::function("ShareBoolResultCache", &ShareBoolResultCache);
+    emscripten::function("GetFlatMeshLevel", &GetFlatMeshLevel);
+    emscripten::function("GetLevelGeometry", &GetLevelGeometry);
+    emscripten::function("StreamMeshLevels", &StreamMeshLevels);
+    emscripten::function("StreamAllMeshLevels", &StreamAllMeshLevels);
     emscripten::function("GetLine", &GetLine);
     emscripten::function("WriteLine", &WriteLine);
     emscripten::function("ExportFileAsIFC", &ExportFileAsIFC);
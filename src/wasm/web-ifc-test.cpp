@@ -29,7 +29,7 @@ void SpecificLoadTest(webifc::IfcLoader& loader, webifc::IfcGeometryLoader& geom
 
     if (writeFiles)
     {
-        geometryLoader.DumpMesh(mesh, L"TEST.obj");
+        geometryLoader.DumpMesh(*mesh, L"TEST.obj");
     }
 }
 
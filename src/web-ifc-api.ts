@@ -25,8 +25,47 @@ export interface LoaderSettings
     CIRCLE_SEGMENTS_LOW?: number
     CIRCLE_SEGMENTS_MEDIUM?: number
     CIRCLE_SEGMENTS_HIGH?: number
+    GEOMETRY_INSTANCING?: boolean
+    GEOMETRY_DEDUPLICATION?: boolean
+    WELD_VERTICES?: boolean
+    WELD_TOLERANCE_M?: number
+    WELD_CREASE_ANGLE_DEG?: number
+    FLOAT_VERTEX_STORAGE?: boolean
+    USE_NATIVE_BOOLS?: boolean
+    BOOL_RESULT_CACHE?: boolean
+    BOOL_RESULT_CACHE_MB?: number
+    ADAPTIVE_TESSELLATION?: boolean
+    CHORD_TOLERANCE_M?: number
+    ANGLE_TOLERANCE_DEG?: number
+    MIN_VOID_SIZE_M?: number
+    GEOMETRY_PROXIES?: boolean
+    PARAMETRIC_EXTRUSIONS?: boolean
 }
 
+// used by OpenModel, CreateModel and AddLevelOfDetail for any setting the caller leaves out
+export const DEFAULT_LOADER_SETTINGS: LoaderSettings = {
+    COORDINATE_TO_ORIGIN: false,
+    USE_FAST_BOOLS: false,
+    CIRCLE_SEGMENTS_LOW: 5,
+    CIRCLE_SEGMENTS_MEDIUM: 8,
+    CIRCLE_SEGMENTS_HIGH: 12,
+    GEOMETRY_INSTANCING: false,
+    GEOMETRY_DEDUPLICATION: false,
+    WELD_VERTICES: false,
+    WELD_TOLERANCE_M: 1e-6,
+    WELD_CREASE_ANGLE_DEG: 20,
+    FLOAT_VERTEX_STORAGE: false,
+    USE_NATIVE_BOOLS: false,
+    BOOL_RESULT_CACHE: false,
+    BOOL_RESULT_CACHE_MB: 128,
+    ADAPTIVE_TESSELLATION: false,
+    CHORD_TOLERANCE_M: 0.005,
+    ANGLE_TOLERANCE_DEG: 90,
+    MIN_VOID_SIZE_M: 0,
+    GEOMETRY_PROXIES: false,
+    PARAMETRIC_EXTRUSIONS: false
+};
+
 export interface Vector<T> {
     get(index: number): T;
     size(): number;
@@ -43,6 +82,7 @@ export interface PlacedGeometry {
     color: Color;
     geometryExpressID: number;
     flatTransformation: Array<number>;
+    isParametric: boolean;
 }
 
 export interface FlatMesh {
@@ -99,11 +139,7 @@ export class IfcAPI
     {
         this.wasmModule['FS_createDataFile']('/', "filename", data, true, true, true);
         let s: LoaderSettings = {
-            COORDINATE_TO_ORIGIN: false,
-            USE_FAST_BOOLS: false,
-            CIRCLE_SEGMENTS_LOW: 5,
-            CIRCLE_SEGMENTS_MEDIUM: 8,
-            CIRCLE_SEGMENTS_HIGH: 12,
+            ...DEFAULT_LOADER_SETTINGS,
             ...settings
         };
         let result = this.wasmModule.OpenModel(s);
@@ -118,11 +154,7 @@ export class IfcAPI
     CreateModel(settings?: LoaderSettings): number
     {
         let s: LoaderSettings = {
-            COORDINATE_TO_ORIGIN: false,
-            USE_FAST_BOOLS: false,
-            CIRCLE_SEGMENTS_LOW: 5,
-            CIRCLE_SEGMENTS_MEDIUM: 8,
-            CIRCLE_SEGMENTS_HIGH: 12,
+            ...DEFAULT_LOADER_SETTINGS,
             ...settings
         };
         let result = this.wasmModule.CreateModel(s);
@@ -140,15 +172,39 @@ export class IfcAPI
 
 
     /**  
-     * Opens a model and returns a modelID number
+     * Returns a copy of the geometry of a placed geometry
+     * While streaming it is only available until the streaming call that produced it returns
      * @modelID Model handle retrieved by OpenModel, model must not be closed
-     * @data Buffer containing IFC data (bytes)
     */
     GetGeometry(modelID: number, geometryExpressID: number): IfcGeometry
     {
         return this.wasmModule.GetGeometry(modelID, geometryExpressID);
     }
 
+    /**  
+     * Returns the extrusion record of a placed geometry with isParametric set, only used with PARAMETRIC_EXTRUSIONS
+     * The record is the direction (3 numbers), the depth, 1 if the caps are convex without holes and can be fanned, the number of curves,
+     * then for the outer curve and each hole its point count followed by its 2D points
+     * The solid spans from the profile at z = 0 to the profile moved by direction * depth, in the frame of flatTransformation
+     * GetGeometry still returns the tessellated mesh of the record
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+    */
+    GetParametricGeometry(modelID: number, geometryExpressID: number): Vector<number>
+    {
+        return this.wasmModule.GetParametricGeometry(modelID, geometryExpressID);
+    }
+
+    /**  
+     * Returns the geometry IDs shared between mapped items, only filled when GEOMETRY_INSTANCING is set
+     * These geometries are not freed while streaming meshes, so they only have to be fetched once
+     * WriteLine drops them, so the next stream generates them again from the edited model
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+    */
+    GetInstancedGeometryIDs(modelID: number): Vector<number>
+    {
+        return this.wasmModule.GetInstancedGeometryIDs(modelID);
+    }
+
     GetLine(modelID: number, expressID: number, flatten: boolean = false)
     {
         let rawLineData = this.GetRawLineData(modelID, expressID);
@@ -285,6 +341,78 @@ export class IfcAPI
         this.wasmModule.StreamAllMeshes(modelID, meshCallback);
     }
 
+    /**  
+     * Adds a level of detail to a model and returns its level number, level 0 is the model itself
+     * Only settings that affect geometry generation apply, such as circle segments, tessellation tolerances or MIN_VOID_SIZE_M
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+     * @settings Settings for generating the geometry of this level
+    */
+    AddLevelOfDetail(modelID: number, settings?: LoaderSettings): number
+    {
+        let s: LoaderSettings = {
+            ...DEFAULT_LOADER_SETTINGS,
+            ...settings
+        };
+        return this.wasmModule.AddLevelOfDetail(modelID, s);
+    }
+
+    /**  
+     * Lets a model reuse the boolean results of another one, such as an earlier revision of it
+     * Both need BOOL_RESULT_CACHE, the results stay available after the source model is closed
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+     * @sourceModelID Model whose cache is shared, model must not be closed
+    */
+    ShareBoolResultCache(modelID: number, sourceModelID: number)
+    {
+        this.wasmModule.ShareBoolResultCache(modelID, sourceModelID);
+    }
+
+    /**  
+     * Streams every element once per level of detail, all levels of an element are generated before the next element
+     * The geometry of a level is only alive during the callback, fetch it with GetLevelGeometry
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+    */
+    StreamAllMeshLevels(modelID: number, meshCallback: (mesh: FlatMesh, level: number)=>void)
+    {
+        this.wasmModule.StreamAllMeshLevels(modelID, meshCallback);
+    }
+
+    /**  
+     * Load geometry for a single element at a level of detail added with AddLevelOfDetail
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+    */
+    GetFlatMeshLevel(modelID: number, level: number, expressID: number): FlatMesh
+    {
+        return this.wasmModule.GetFlatMeshLevel(modelID, level, expressID);
+    }
+
+    /**  
+     * Like GetGeometry, for a level added with AddLevelOfDetail; the same lifetime rules apply
+    */
+    GetLevelGeometry(modelID: number, level: number, geometryExpressID: number): IfcGeometry
+    {
+        return this.wasmModule.GetLevelGeometry(modelID, level, geometryExpressID);
+    }
+
+    /**  
+     * Streams every element twice: first as boxes around its parts without any booleans, then with its final mesh
+     * Both passes use the element's expressID, so the proxy can be swapped for the final mesh
+     * Proxy geometry is fetched with GetProxyGeometry, final geometry with GetGeometry, each only during its callback
+     * @modelID Model handle retrieved by OpenModel, model must not be closed
+    */
+    StreamAllMeshesProgressive(modelID: number, meshCallback: (mesh: FlatMesh, isProxy: boolean)=>void)
+    {
+        this.wasmModule.StreamAllMeshesProgressive(modelID, meshCallback);
+    }
+
+    /**  
+     * Like GetGeometry, for the proxy pass of StreamAllMeshesProgressive; only available during the callback
+    */
+    GetProxyGeometry(modelID: number, geometryExpressID: number): IfcGeometry
+    {
+        return this.wasmModule.GetProxyGeometry(modelID, geometryExpressID);
+    }
+
     /**  
      * Checks if a specific model ID is open or closed
      * @modelID Model handle retrieved by OpenModel